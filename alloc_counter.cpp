@@ -0,0 +1,81 @@
+/*
+ * Filename: alloc_counter.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <new>
+#include <stdlib.h> // malloc, free
+
+// Per thread, so counting never contends between reactors
+static __thread long long allocations = 0;
+
+/* Function: allocation_count
+ * Params: none
+ * Return: allocations made by the calling thread since it started
+ */
+long long allocation_count()
+{
+  return allocations;
+}
+
+/* Function: counted_new
+ * Params: bytes needed
+ * Return: a block from malloc, counted against the calling thread
+ */
+static void * counted_new(size_t size)
+{
+  allocations++;
+  void * block = malloc(size == 0 ? 1 : size);
+  if (block == NULL)
+    throw std::bad_alloc();
+  return block;
+}
+
+void * operator new(size_t size)
+{
+  return counted_new(size);
+}
+
+void * operator new[](size_t size)
+{
+  return counted_new(size);
+}
+
+void operator delete(void * block) throw()
+{
+  free(block);
+}
+
+void operator delete[](void * block) throw()
+{
+  free(block);
+}
+
+void operator delete(void * block, size_t) throw()
+{
+  free(block);
+}
+
+void operator delete[](void * block, size_t) throw()
+{
+  free(block);
+}
+
+#else
+
+/* Function: allocation_count
+ * Params: none
+ * Return: -1; allocations are only counted when built with COUNT_ALLOCATIONS
+ */
+long long allocation_count()
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * Filename: alloc_counter.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+/* Allocation counting, for checking which paths allocate. Built with
+ * COUNT_ALLOCATIONS defined (make ALLOC_COUNT=-DCOUNT_ALLOCATIONS), alloc_counter.o
+ * replaces the global operator new and delete with versions that count every
+ * allocation made by each thread; otherwise it replaces nothing and costs nothing.
+ * Memory a sheet_arena takes from malloc shows up in its arena_stats instead.
+ *
+ * Functions:
+ *   allocation_count:  returns the allocations made so far by the calling thread, or -1 if not counting
+ */
+long long allocation_count();
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Filename: broadcast_bench.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Counts the allocations and time it takes to fan one cell change out to
+ *   N clients, as broadcast_batch() does: the change is built once into a shared_message
+ *   and handed to reactor::send() for every client. Starts one reactor on a local port
+ *   and, for N = 1, 10, 100, ... up to the given number of clients, connects N clients
+ *   and times broadcasts in two cases:
+ *
+ *     reading: the clients read everything, so each send writes straight to its socket;
+ *     stalled: the clients read nothing and their sockets are full, so every send
+ *              queues the message in the client's outbound_ring.
+ *
+ *   Each case is run with the shared message and with a copy of it per client (the
+ *   std::string send(), as broadcasts were made before messages were shared), after
+ *   warm-up broadcasts that grow the queues to size. Allocations are only counted when built
+ *   with make ALLOC_COUNT=-DCOUNT_ALLOCATIONS broadcast_bench; a shared broadcast
+ *   should make the same few allocations whatever N is, a copied one N more.
+ *
+ *   Usage: broadcast_bench [most clients] [broadcasts per case]
+ */
+
+#include <algorithm> // min()
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h> // perror error message printing
+#include <stdlib.h> // atoi
+#include <string.h> // memset
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "alloc_counter.h"
+#include "logger.h"
+#include "reactor.h"
+
+#define STALL_BYTES (16 << 20) // Size of the message that fills a stalled client's socket and starts its queue
+
+static std::vector<int> server_sockets; //Server side of every client that said hello
+static std::mutex server_sockets_lock;
+static std::atomic<bool> draining(false);
+
+/* Class: case_result
+ *
+ * Description: Aggregate holding what one case measured, per broadcast
+ */
+class case_result
+{
+ public:
+  double us;           //Microseconds to hand the message to every client
+  double allocations;  //Allocations made by the broadcasting thread (-1 if not counted)
+};
+
+/* Function: now_us
+ * Params: none
+ * Return: microseconds on a monotonic clock, with fractions
+ */
+static double now_us()
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: lines_received
+ * Params: socket, lines framed from it, how many
+ * Return: void
+ *
+ * Description: Notes the server side socket of a client the first time it speaks
+ */
+static void lines_received(int socket_id, const text_view *, size_t)
+{
+  std::lock_guard<std::mutex> guard(server_sockets_lock);
+  server_sockets.push_back(socket_id);
+}
+
+/* Function: client_disconnected
+ * Params: socket that closed
+ * Return: void
+ */
+static void client_disconnected(int)
+{
+}
+
+/* Function: drain
+ * Params: client sockets to read
+ * Return: void
+ *
+ * Description: Reads and discards everything sent to the clients while draining is set
+ */
+static void drain(std::vector<int> * clients)
+{
+  std::vector<struct pollfd> polled(clients->size());
+  for (size_t i = 0; i < clients->size(); i++)
+  {
+    polled[i].fd = (*clients)[i];
+    polled[i].events = POLLIN;
+  }
+
+  char ignored[65536];
+  while (draining)
+  {
+    if (poll(&polled[0], polled.size(), 10) <= 0)
+      continue;
+    for (size_t i = 0; i < polled.size(); i++)
+    {
+      if (polled[i].revents & POLLIN)
+        while (recv(polled[i].fd, ignored, sizeof ignored, MSG_DONTWAIT) > 0)
+          ;
+    }
+  }
+}
+
+/* Function: connect_clients
+ * Params: port to connect to, how many clients, vector to store their sockets in
+ * Return: true if every client connected and the server saw each of them
+ */
+static bool connect_clients(int port, int count, std::vector<int> & clients)
+{
+  {
+    std::lock_guard<std::mutex> guard(server_sockets_lock);
+    server_sockets.clear();
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < count; i++)
+  {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1 || connect(sock, (struct sockaddr *)&address, sizeof address) == -1 ||
+        ::send(sock, "hello\n", 6, MSG_NOSIGNAL) != 6)
+    {
+      perror("broadcast_bench connect");
+      if (sock != -1)
+        close(sock);
+      return false;
+    }
+    clients.push_back(sock);
+  }
+
+  for (int wait = 0; wait < 5000; wait++)
+  {
+    {
+      std::lock_guard<std::mutex> guard(server_sockets_lock);
+      if (server_sockets.size() == (size_t)count)
+        return true;
+    }
+    usleep(1000);
+  }
+  fprintf(stderr, "broadcast_bench: the server only saw %zu of %d clients\n", server_sockets.size(), count);
+  return false;
+}
+
+/* Function: warm_up_count
+ * Params: broadcasts to measure
+ * Return: broadcasts to make first
+ *
+ * Description: An outbound_ring doubles from a power of two, so once a stalled client's
+ *              queue holds the filler and this many messages its ring has grown to exactly
+ *              the slots the measured broadcasts then fill, and measuring grows nothing.
+ */
+static int warm_up_count(int broadcasts)
+{
+  int slots = 16;
+  while (slots < 2 * broadcasts + 1)
+    slots *= 2;
+  return slots - 1 - broadcasts;
+}
+
+/* Function: run_case
+ * Params: broadcasts to make, whether to share one message or copy it per client
+ * Return: time and allocations per broadcast
+ *
+ * Description: Makes warm-up broadcasts, then measures the given number. Each one builds
+ *              its message as add_change() does and sends it to every server side socket.
+ */
+static case_result run_case(int broadcasts, bool shared)
+{
+  case_result result;
+  int counts[2] = { warm_up_count(broadcasts), broadcasts };
+  for (int pass = 0; pass < 2; pass++)
+  {
+    long long allocations = allocation_count();
+    double start = now_us();
+    for (int i = 0; i < counts[pass]; i++)
+    {
+      std::shared_ptr<std::string> message = std::make_shared<std::string>();
+      message->reserve(32);
+      *message += "cell A1 ";
+      *message += (char)('0' + i % 10);
+      *message += '\n';
+
+      shared_message sent = message;
+      for (size_t client = 0; client < server_sockets.size(); client++)
+      {
+        if (shared)
+          reactor::send(server_sockets[client], sent);
+        else
+          reactor::send(server_sockets[client], *message);
+      }
+    }
+    result.us = (now_us() - start) / broadcasts;
+    result.allocations = allocation_count() == -1 ? -1 : (double)(allocation_count() - allocations) / broadcasts;
+  }
+  return result;
+}
+
+/* Function: print_case
+ * Params: clients, case name, how it was sent, what it measured
+ * Return: void
+ */
+static void print_case(int clients, const char * name, const char * how, const case_result & result)
+{
+  if (result.allocations < 0)
+    printf("%8d %-8s %-7s %12.2f %12s\n", clients, name, how, result.us, "n/a");
+  else
+    printf("%8d %-8s %-7s %12.2f %12.2f\n", clients, name, how, result.us, result.allocations);
+}
+
+/* Function: main
+ * Params: number of arguments, string arguments
+ * Return: 0 if every case ran, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  int most_clients = argc > 1 ? atoi(argv[1]) : 1000;
+  int broadcasts = argc > 2 ? atoi(argv[2]) : 200;
+  if (most_clients < 1 || broadcasts < 1)
+  {
+    fprintf(stderr, "Usage: broadcast_bench [most clients] [broadcasts per case]\n");
+    return 1;
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_length = sizeof address;
+  if (bind(listener, (struct sockaddr *)&address, sizeof address) == -1 || listen(listener, 1024) == -1 ||
+      getsockname(listener, (struct sockaddr *)&address, &address_length) == -1 ||
+      fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK) == -1)
+  {
+    perror("broadcast_bench listen");
+    return 1;
+  }
+  int port = ntohs(address.sin_port);
+
+  // A thousand accepted connections would otherwise be logged one by one
+  logger::set_level(LOG_WARN);
+  reactor * loop = new reactor(listener, lines_received, client_disconnected);
+  loop->start();
+
+  printf("%8s %-8s %-7s %12s %12s\n", "clients", "case", "message", "us/bcast", "allocs/bcast");
+  int failed = 0;
+  int clients = 1;
+  while (!failed)
+  {
+    std::vector<int> client_sockets;
+    if (!connect_clients(port, clients, client_sockets))
+      failed = 1;
+    else
+    {
+      draining = true;
+      std::thread drainer(drain, &client_sockets);
+      print_case(clients, "reading", "shared", run_case(broadcasts, true));
+      print_case(clients, "reading", "copied", run_case(broadcasts, false));
+      draining = false;
+      drainer.join();
+
+      // Nobody reads from here on: fill every socket so the rest of the message is queued
+      shared_message filler = std::make_shared<const std::string>(STALL_BYTES, 'x');
+      for (size_t i = 0; i < server_sockets.size(); i++)
+        reactor::send(server_sockets[i], filler);
+      print_case(clients, "stalled", "shared", run_case(broadcasts, true));
+      print_case(clients, "stalled", "copied", run_case(broadcasts, false));
+    }
+
+    for (size_t i = 0; i < client_sockets.size(); i++)
+      close(client_sockets[i]);
+    if (clients == most_clients)
+      break;
+    clients = std::min(clients * 10, most_clients);
+  }
+
+  loop->stop();
+  loop->join();
+  delete loop;
+  close(listener);
+  return failed;
+}
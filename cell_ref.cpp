@@ -0,0 +1,241 @@
+/*
+ * Filename: cell_ref.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "cell_ref.h"
+
+/* Function: is_letter
+ * Params: character
+ * Return: true for A-Z and a-z (independent of locale)
+ */
+static inline bool is_letter(char c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+/* Function: is_digit
+ * Params: character
+ * Return: true for 0-9
+ */
+static inline bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/* Function: is_word
+ * Params: character
+ * Return: true for characters that continue an identifier
+ */
+static inline bool is_word(char c)
+{
+  return is_letter(c) || is_digit(c) || c == '_';
+}
+
+/* Function: scan_cell
+ * Params: text, where to store the coordinates
+ * Return: where the cell name ends, or begin if there isn't one
+ *
+ * Description: Reads letters then digits as a column and row. Doesn't look at
+ *              what follows; callers decide whether the name stands alone.
+ */
+static const char * scan_cell(const char * begin, const char * end, cell_coord * coord)
+{
+  const char * p = begin;
+  unsigned int column = 0;
+  int letters = 0;
+  while (p < end && is_letter(*p))
+  {
+    if (++letters > CELL_MAX_COLUMN_LETTERS)
+      return begin;
+    column = column * 26 + ((*p | 0x20) - 'a' + 1);
+    p++;
+  }
+  if (letters == 0)
+    return begin;
+
+  unsigned long long row = 0;
+  const char * digits = p;
+  while (p < end && is_digit(*p))
+  {
+    row = row * 10 + (*p - '0');
+    if (row > CELL_MAX_ROW)
+      return begin;
+    p++;
+  }
+  if (p == digits || row == 0)
+    return begin;
+
+  *coord = make_coord(column, (unsigned int)row);
+  return p;
+}
+
+/* Function: parse_cell_name
+ * Params: text of the name
+ * Return: true if the whole text is one cell name, with its coordinates stored
+ */
+bool parse_cell_name(const char * begin, const char * end, cell_coord * coord)
+{
+  return begin != end && scan_cell(begin, end, coord) == end;
+}
+
+/* Function: scan_reference
+ * Params: text, where to store the range
+ * Return: where the reference or range ends, or begin if there isn't one
+ *
+ * Description: A1 is a range of one cell; A1:C500 and C500:A1 are the same range.
+ */
+const char * scan_reference(const char * begin, const char * end, cell_range * range)
+{
+  cell_coord first;
+  const char * p = scan_cell(begin, end, &first);
+  if (p == begin || (p < end && is_word(*p)))
+    return begin;
+
+  range->first = first;
+  range->last = first;
+
+  cell_coord last;
+  const char * q;
+  if (p + 1 < end && *p == ':' && (q = scan_cell(p + 1, end, &last)) != p + 1 && !(q < end && is_word(*q)))
+  {
+    unsigned int left = coord_column(first), right = coord_column(last);
+    unsigned int top = coord_row(first), bottom = coord_row(last);
+    range->first = make_coord(left < right ? left : right, top < bottom ? top : bottom);
+    range->last = make_coord(left < right ? right : left, top < bottom ? bottom : top);
+    return q;
+  }
+
+  return p;
+}
+
+/* Function: scan_number
+ * Params: text
+ * Return: where the number ends, or begin if there isn't one
+ *
+ * Description: Digits with an optional fraction, then an exponent only if it has digits,
+ *              so 2e5 is one number but the E in 2E stays for the next token.
+ */
+const char * scan_number(const char * begin, const char * end)
+{
+  const char * p = begin;
+  int digits = 0;
+  while (p < end && is_digit(*p)) { p++; digits++; }
+  if (p < end && *p == '.')
+  {
+    p++;
+    while (p < end && is_digit(*p)) { p++; digits++; }
+  }
+  if (digits == 0)
+    return begin;
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char * exponent = p + 1;
+    if (exponent < end && (*exponent == '+' || *exponent == '-'))
+      exponent++;
+    if (exponent < end && is_digit(*exponent))
+    {
+      p = exponent;
+      while (p < end && is_digit(*p))
+        p++;
+    }
+  }
+  return p;
+}
+
+/* Function: reference_scanner constructor
+ * Params: characters to scan
+ * Return: void
+ */
+reference_scanner::reference_scanner(const char * begin, const char * end)
+{
+  this->position = begin;
+  this->end = end;
+}
+
+/* Function: next
+ * Params: where to store the range found
+ * Return: true if a reference or range was found, false at the end of the text
+ */
+bool reference_scanner::next(cell_range * range)
+{
+  while (position < end)
+  {
+    char c = *position;
+    if (is_letter(c))
+    {
+      const char * after = scan_reference(position, end, range);
+      if (after != position)
+      {
+        position = after;
+        return true;
+      }
+
+      // Not a cell; skip the whole identifier
+      while (position < end && is_word(*position))
+        position++;
+    }
+    else if (is_digit(c) || c == '.')
+    {
+      const char * after = scan_number(position, end);
+      position = (after != position) ? after : position + 1;
+
+      // Digits glued to letters (like 2E) belong to the same bad token
+      while (position < end && is_word(*position))
+        position++;
+    }
+    else
+    {
+      position++;
+    }
+  }
+  return false;
+}
+
+/* Function: format_cell_name
+ * Params: coordinates, buffer of at least CELL_NAME_MAX characters
+ * Return: length of the name written (followed by '\0')
+ */
+size_t format_cell_name(cell_coord coord, char * buffer)
+{
+  char letters[CELL_MAX_COLUMN_LETTERS];
+  int count = 0;
+  unsigned int column = coord_column(coord);
+  while (column > 0 && count < CELL_MAX_COLUMN_LETTERS)
+  {
+    column--;
+    letters[count++] = 'A' + column % 26;
+    column /= 26;
+  }
+
+  char digits[10];
+  int digit_count = 0;
+  unsigned int row = coord_row(coord);
+  do
+  {
+    digits[digit_count++] = '0' + row % 10;
+    row /= 10;
+  } while (row > 0);
+
+  size_t length = 0;
+  while (count > 0)
+    buffer[length++] = letters[--count];
+  while (digit_count > 0)
+    buffer[length++] = digits[--digit_count];
+  buffer[length] = '\0';
+  return length;
+}
+
+/* Function: cell_name
+ * Params: coordinates
+ * Return: the canonical name of the cell
+ */
+std::string cell_name(cell_coord coord)
+{
+  char buffer[CELL_NAME_MAX];
+  size_t length = format_cell_name(coord, buffer);
+  return std::string(buffer, length);
+}
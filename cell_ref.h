@@ -0,0 +1,104 @@
+/*
+ * Filename: cell_ref.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef CELL_REF_H
+#define CELL_REF_H
+
+#include <stddef.h>
+#include <string>
+
+// Packed cell coordinates: column in the high 32 bits, row in the low 32.
+// Columns count from 1 (A=1, Z=26, AA=27) and rows from 1, so 0 is never a cell.
+typedef unsigned long long cell_coord;
+
+#define CELL_MAX_COLUMN_LETTERS 6          // ZZZZZZ, the last column that fits below 2^31
+#define CELL_MAX_ROW 0x7fffffffu           // Rows past this aren't cells
+#define CELL_NAME_MAX (CELL_MAX_COLUMN_LETTERS + 11) // Longest cell name plus its '\0'
+
+/* Function: make_coord
+ * Params: column (from 1), row (from 1)
+ * Return: the packed coordinates
+ */
+inline cell_coord make_coord(unsigned int column, unsigned int row)
+{
+  return ((cell_coord)column << 32) | row;
+}
+
+/* Function: coord_column
+ * Params: packed coordinates
+ * Return: the column, counting from 1
+ */
+inline unsigned int coord_column(cell_coord coord)
+{
+  return (unsigned int)(coord >> 32);
+}
+
+/* Function: coord_row
+ * Params: packed coordinates
+ * Return: the row, counting from 1
+ */
+inline unsigned int coord_row(cell_coord coord)
+{
+  return (unsigned int)(coord & 0xffffffffu);
+}
+
+/* Class: cell_range
+ *
+ * Description: Rectangle of cells, corners ordered so first is the top left.
+ *              A single reference is a range whose corners are the same cell.
+ */
+class cell_range
+{
+ public:
+  cell_coord first;
+  cell_coord last;
+};
+
+/* Class: reference_scanner
+ *
+ * Description: Single pass over the text of a formula that yields each cell
+ *              reference (A1, z100, AA10) or range (A1:C500) as packed
+ *              coordinates. Works on the caller's characters and never
+ *              allocates. Numbers, including exponents like 2e5, and
+ *              identifiers that aren't cells (SUM, A1B, A_1) are skipped
+ *              whole, so the digits and letters inside them are never
+ *              mistaken for references.
+ *
+ * Public Functions:
+ *   constructor:   sets the characters to scan
+ *   next:          finds the next reference or range
+ */
+class reference_scanner
+{
+ public:
+  reference_scanner(const char * begin, const char * end);
+  bool next(cell_range * range);
+
+ private:
+  const char * position;
+  const char * end;
+};
+
+// Parses a whole cell name (case-insensitive, no surrounding text) into coordinates.
+bool parse_cell_name(const char * begin, const char * end, cell_coord * coord);
+
+// Reads a reference or range at the start of the text. Returns where it ends, or
+// begin if the text there isn't one; a reference glued to more letters or digits isn't.
+const char * scan_reference(const char * begin, const char * end, cell_range * range);
+
+// Reads a number (digits, an optional fraction and an optional exponent) at the start
+// of the text. Returns where it ends, or begin if the text there isn't one.
+const char * scan_number(const char * begin, const char * end);
+
+// Writes the canonical name of a cell (uppercase, no leading zeros) into a buffer of
+// CELL_NAME_MAX characters. Returns its length.
+size_t format_cell_name(cell_coord coord, char * buffer);
+
+// Returns the canonical name of a cell.
+std::string cell_name(cell_coord coord);
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * Filename: cell_store.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "cell_store.h"
+#include <string.h> // memcpy, memset
+
+#define LARGE_TEXT 0x80  // Marker in the last byte of a cell_text whose characters are in an arena block
+#define MAPPED_TEXT 0x81 // Marker in the last byte of a cell_text whose characters it doesn't own
+
+/* Function: assign
+ * Params: characters and their count, arena for long contents
+ * Return: void
+ *
+ * Description: Replaces the contents, giving back any previous arena block
+ */
+void cell_text::assign(const char * text, size_t length, sheet_arena * arena)
+{
+  if (length < sizeof(inline_text))
+  {
+    release(arena);
+    memcpy(inline_text, text, length);
+    inline_text[length] = '\0';
+    inline_text[sizeof(inline_text) - 1] = (char)(sizeof(inline_text) - 1 - length);
+    return;
+  }
+
+  // Copy before giving the old block back, whose first bytes the arena reuses
+  char * block = (char *)arena->allocate(length + 1);
+  memcpy(block, text, length);
+  block[length] = '\0';
+  release(arena);
+  heap.text = block;
+  heap.length = length;
+  inline_text[sizeof(inline_text) - 1] = (char)LARGE_TEXT;
+}
+
+/* Function: refer
+ * Params: characters followed by '\0' and their count, arena the contents were assigned with
+ * Return: void
+ *
+ * Description: Replaces the contents like assign(), except that long characters are
+ *              used where they are instead of copied, so they must outlive the cell_text
+ *              or its next assign()
+ */
+void cell_text::refer(const char * text, size_t length, sheet_arena * arena)
+{
+  if (length < sizeof(inline_text))
+  {
+    assign(text, length, arena);
+    return;
+  }
+
+  release(arena);
+  heap.text = text;
+  heap.length = length;
+  inline_text[sizeof(inline_text) - 1] = (char)MAPPED_TEXT;
+}
+
+/* Function: release
+ * Params: arena the contents were assigned with
+ * Return: void
+ *
+ * Description: Gives back the arena block, if any, leaving empty contents
+ */
+void cell_text::release(sheet_arena * arena)
+{
+  if (inline_text[sizeof(inline_text) - 1] == (char)LARGE_TEXT)
+    arena->release((void *)heap.text, heap.length + 1);
+  inline_text[0] = '\0';
+  inline_text[sizeof(inline_text) - 1] = (char)(sizeof(inline_text) - 1);
+}
+
+/* Function: data
+ * Params: none
+ * Return: the characters, followed by '\0'
+ */
+const char * cell_text::data() const
+{
+  if (inline_text[sizeof(inline_text) - 1] == (char)LARGE_TEXT || inline_text[sizeof(inline_text) - 1] == (char)MAPPED_TEXT)
+    return heap.text;
+  return inline_text;
+}
+
+/* Function: size
+ * Params: none
+ * Return: number of characters
+ */
+size_t cell_text::size() const
+{
+  if (inline_text[sizeof(inline_text) - 1] == (char)LARGE_TEXT || inline_text[sizeof(inline_text) - 1] == (char)MAPPED_TEXT)
+    return heap.length;
+  return sizeof(inline_text) - 1 - inline_text[sizeof(inline_text) - 1];
+}
+
+/* Function: tile constructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Creates a tile with no cells. Zeroed slots hold no arena block,
+ *              so they can be released safely.
+ */
+cell_store::tile::tile()
+{
+  memset(used, 0, sizeof(used));
+  memset(cells, 0, sizeof(cells));
+  count = 0;
+}
+
+/* Function: has
+ * Params: slot in the tile
+ * Return: true if the slot holds contents
+ */
+bool cell_store::tile::has(int slot) const
+{
+  return (used[slot >> 6] >> (slot & 63)) & 1;
+}
+
+/* Function: cell_store constructor
+ * Params: arena to keep long contents in; must outlive the store
+ * Return: void
+ */
+cell_store::cell_store(sheet_arena * arena)
+{
+  cell_count = 0;
+  this->arena = arena;
+}
+
+/* Function: cell_store destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Gives back every arena block and frees every tile
+ */
+cell_store::~cell_store()
+{
+  std::map<cell_coord, cell_text>::iterator itSparse;
+  for (itSparse = sparse.begin(); itSparse != sparse.end(); itSparse++)
+    itSparse->second.release(arena);
+
+  std::map<cell_coord, tile*>::iterator itTiles;
+  for (itTiles = tiles.begin(); itTiles != tiles.end(); itTiles++)
+  {
+    tile * t = itTiles->second;
+    for (int slot = 0; slot < TILE_CELLS; slot++)
+    {
+      if (t->has(slot))
+        t->cells[slot].release(arena);
+    }
+    delete t;
+  }
+}
+
+/* Function: tile_key
+ * Params: coordinates of a cell
+ * Return: coordinates of the tile holding it (column and row divided by TILE_SIZE)
+ */
+cell_coord cell_store::tile_key(cell_coord coord)
+{
+  return make_coord(coord_column(coord) >> TILE_BITS, coord_row(coord) >> TILE_BITS);
+}
+
+/* Function: tile_slot
+ * Params: coordinates of a cell
+ * Return: its slot in its tile
+ */
+int cell_store::tile_slot(cell_coord coord)
+{
+  return ((coord_column(coord) & (TILE_SIZE - 1)) << TILE_BITS) | (coord_row(coord) & (TILE_SIZE - 1));
+}
+
+/* Function: get
+ * Params: coordinates, where to store the contents and their length
+ * Return: true if the cell has contents. They stay valid until the cell is next set.
+ */
+bool cell_store::get(cell_coord coord, const char ** contents, size_t * length) const
+{
+  std::map<cell_coord, tile*>::const_iterator itTile = tiles.find(tile_key(coord));
+  if (itTile != tiles.end())
+  {
+    int slot = tile_slot(coord);
+    if (!itTile->second->has(slot))
+      return false;
+    *contents = itTile->second->cells[slot].data();
+    *length = itTile->second->cells[slot].size();
+    return true;
+  }
+
+  std::map<cell_coord, cell_text>::const_iterator itCell = sparse.find(coord);
+  if (itCell == sparse.end())
+    return false;
+  *contents = itCell->second.data();
+  *length = itCell->second.size();
+  return true;
+}
+
+/* Function: set
+ * Params: coordinates, contents and their length
+ * Return: void
+ *
+ * Description: Stores a copy of the contents, or removes the cell if they are empty
+ */
+void cell_store::set(cell_coord coord, const char * contents, size_t length)
+{
+  store(coord, contents, length, false);
+}
+
+/* Function: refer
+ * Params: coordinates, contents followed by '\0' and their length
+ * Return: void
+ *
+ * Description: Like set(), but long contents are used where they are until the cell
+ *              is next set; they must outlive the store (e.g. a mapped snapshot's)
+ */
+void cell_store::refer(cell_coord coord, const char * contents, size_t length)
+{
+  store(coord, contents, length, true);
+}
+
+/* Function: store
+ * Params: coordinates, contents and their length, whether to refer to them rather than copy them
+ * Return: void
+ *
+ * Description: Stores the contents, or removes the cell if they are empty.
+ *              Allocates or frees the cell's tile as the area fills up or empties.
+ */
+void cell_store::store(cell_coord coord, const char * contents, size_t length, bool mapped)
+{
+  cell_coord key = tile_key(coord);
+  std::map<cell_coord, tile*>::iterator itTile = tiles.find(key);
+
+  if (itTile != tiles.end())
+  {
+    tile * t = itTile->second;
+    int slot = tile_slot(coord);
+    bool had = t->has(slot);
+
+    if (length > 0)
+    {
+      if (!had)
+      {
+        t->used[slot >> 6] |= 1ULL << (slot & 63);
+        t->count++;
+        cell_count++;
+      }
+      if (mapped)
+        t->cells[slot].refer(contents, length, arena);
+      else
+        t->cells[slot].assign(contents, length, arena);
+    }
+    else if (had)
+    {
+      t->cells[slot].release(arena);
+      t->used[slot >> 6] &= ~(1ULL << (slot & 63));
+      t->count--;
+      cell_count--;
+      if (t->count < TILE_DEMOTE)
+        demote(itTile);
+    }
+    return;
+  }
+
+  std::map<cell_coord, cell_text>::iterator itCell = sparse.find(coord);
+  if (length > 0)
+  {
+    if (itCell == sparse.end())
+    {
+      itCell = sparse.insert(std::make_pair(coord, cell_text())).first;
+      itCell->second.release(arena);
+      cell_count++;
+      if (++sparse_per_tile[key] >= TILE_PROMOTE)
+      {
+        if (mapped)
+          itCell->second.refer(contents, length, arena);
+        else
+          itCell->second.assign(contents, length, arena);
+        promote(key);
+        return;
+      }
+    }
+    if (mapped)
+      itCell->second.refer(contents, length, arena);
+    else
+      itCell->second.assign(contents, length, arena);
+  }
+  else if (itCell != sparse.end())
+  {
+    itCell->second.release(arena);
+    sparse.erase(itCell);
+    cell_count--;
+    if (--sparse_per_tile[key] == 0)
+      sparse_per_tile.erase(key);
+  }
+}
+
+/* Function: promote
+ * Params: key of the tile to allocate
+ * Return: void
+ *
+ * Description: Moves every sparse cell in the tile's area into a new tile. The
+ *              cell_text is moved bitwise, so arena blocks change owner without copying.
+ */
+void cell_store::promote(cell_coord key)
+{
+  tile * t = new tile();
+  unsigned int first_column = coord_column(key) << TILE_BITS;
+  unsigned int first_row = coord_row(key) << TILE_BITS;
+
+  for (unsigned int column = first_column; column < first_column + TILE_SIZE; column++)
+  {
+    std::map<cell_coord, cell_text>::iterator it = sparse.lower_bound(make_coord(column, first_row));
+    std::map<cell_coord, cell_text>::iterator last = sparse.lower_bound(make_coord(column, first_row + TILE_SIZE));
+    while (it != last)
+    {
+      int slot = tile_slot(it->first);
+      memcpy(&t->cells[slot], &it->second, sizeof(cell_text));
+      t->used[slot >> 6] |= 1ULL << (slot & 63);
+      t->count++;
+      sparse.erase(it++);
+    }
+  }
+
+  sparse_per_tile.erase(key);
+  tiles[key] = t;
+}
+
+/* Function: demote
+ * Params: tile to free
+ * Return: void
+ *
+ * Description: Moves the tile's remaining cells back to sparse cells and frees it
+ */
+void cell_store::demote(std::map<cell_coord, tile*>::iterator it)
+{
+  cell_coord key = it->first;
+  tile * t = it->second;
+  unsigned int first_column = coord_column(key) << TILE_BITS;
+  unsigned int first_row = coord_row(key) << TILE_BITS;
+
+  for (int slot = 0; slot < TILE_CELLS; slot++)
+  {
+    if (!t->has(slot))
+      continue;
+    cell_coord coord = make_coord(first_column + (slot >> TILE_BITS), first_row + (slot & (TILE_SIZE - 1)));
+    cell_text & text = sparse[coord];
+    memcpy(&text, &t->cells[slot], sizeof(cell_text));
+  }
+  if (t->count > 0)
+    sparse_per_tile[key] = t->count;
+
+  tiles.erase(it);
+  delete t;
+}
+
+/* Function: size
+ * Params: none
+ * Return: number of cells with contents
+ */
+size_t cell_store::size() const
+{
+  return cell_count;
+}
+
+/* Function: for_each
+ * Params: function to call, context passed to it
+ * Return: void
+ *
+ * Description: Calls the function with the coordinates and contents of every cell
+ *              that has contents: sparse cells first, then each tile. The store must
+ *              not be changed until it returns.
+ */
+void cell_store::for_each(cell_visitor visit, void * context) const
+{
+  std::map<cell_coord, cell_text>::const_iterator itSparse;
+  for (itSparse = sparse.begin(); itSparse != sparse.end(); itSparse++)
+    visit(itSparse->first, itSparse->second.data(), itSparse->second.size(), context);
+
+  std::map<cell_coord, tile*>::const_iterator itTiles;
+  for (itTiles = tiles.begin(); itTiles != tiles.end(); itTiles++)
+  {
+    const tile * t = itTiles->second;
+    unsigned int first_column = coord_column(itTiles->first) << TILE_BITS;
+    unsigned int first_row = coord_row(itTiles->first) << TILE_BITS;
+    for (int word = 0; word < TILE_CELLS / 64; word++)
+    {
+      unsigned long long bits = t->used[word];
+      while (bits != 0)
+      {
+        int slot = word * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        visit(make_coord(first_column + (slot >> TILE_BITS), first_row + (slot & (TILE_SIZE - 1))),
+              t->cells[slot].data(), t->cells[slot].size(), context);
+      }
+    }
+  }
+}
+
+/* Function: memory_used
+ * Params: none
+ * Return: estimated bytes held by the store itself: its tiles and map nodes. Long
+ *         contents are in the arena and counted there.
+ */
+size_t cell_store::memory_used() const
+{
+  const size_t node = 4 * sizeof(void*); // Overhead of one std::map node
+  return tiles.size() * (sizeof(tile) + node + sizeof(cell_coord) + sizeof(tile*)) +
+         sparse.size() * (node + sizeof(cell_coord) + sizeof(cell_text)) +
+         sparse_per_tile.size() * (node + sizeof(cell_coord) + sizeof(int));
+}
@@ -0,0 +1,138 @@
+/*
+ * Filename: cell_store.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef CELL_STORE_H
+#define CELL_STORE_H
+
+#include <map>
+#include <string>
+#include "cell_ref.h"
+#include "sheet_arena.h"
+
+#define TILE_BITS 6                        // Tiles are 64x64 cells
+#define TILE_SIZE (1 << TILE_BITS)
+#define TILE_CELLS (TILE_SIZE * TILE_SIZE)
+#ifndef TILE_PROMOTE
+#define TILE_PROMOTE 64                    // Sparse cells in a tile's area before the tile is allocated
+#endif
+#ifndef TILE_DEMOTE
+#define TILE_DEMOTE 16                     // Cells left in a tile when it is freed back to sparse cells
+#endif
+
+/* Class: cell_text
+ *
+ * Description: Contents of one cell in 16 bytes. Up to 15 characters are kept
+ *              inline; longer contents live in one block of the owning
+ *              spreadsheet's arena, or are left where a mapped snapshot
+ *              holds them until the cell is next set. The last byte tells
+ *              which: 15 minus the inline length (so a full inline string
+ *              ends in its own '\0'), LARGE_TEXT or MAPPED_TEXT. Only their
+ *              owners create and destroy these, so they are never copied.
+ *
+ * Public Functions:
+ *   assign:  replaces the contents
+ *   refer:   replaces the contents with characters kept elsewhere, without copying long ones
+ *   release: gives back an arena block, if any
+ *   data:    returns the characters
+ *   size:    returns the number of characters
+ */
+class cell_text
+{
+ public:
+  void assign(const char * text, size_t length, sheet_arena * arena);
+  void refer(const char * text, size_t length, sheet_arena * arena);
+  void release(sheet_arena * arena);
+  const char * data() const;
+  size_t size() const;
+
+ private:
+  union
+  {
+    char inline_text[16];
+    struct
+    {
+      const char * text;
+      unsigned int length;
+    } heap;
+  };
+};
+
+/* Class: cell_store
+ *
+ * Description: Contents of a spreadsheet keyed by packed coordinates. Areas of
+ *              the sheet with many cells are stored as dense 64x64 tiles, one
+ *              16-byte cell_text per cell plus an occupancy bitmap, so a cell
+ *              there costs no node, no key and no allocation of its own. Cells
+ *              elsewhere are kept in a sparse map. A tile is allocated once
+ *              TILE_PROMOTE sparse cells fall in its area, and freed back to
+ *              sparse cells when fewer than TILE_DEMOTE remain. Empty contents
+ *              are never stored: setting a cell to "" removes it. Long contents
+ *              are kept in the arena passed to the constructor, unless they
+ *              are referred to where they already are.
+ *
+ * Public Functions:
+ *   constructor:  creates an empty store using an arena
+ *   destructor:   frees every tile and gives back every arena block
+ *   get:          finds the contents of a cell
+ *   set:          sets or removes the contents of a cell
+ *   refer:        sets the contents of a cell to characters that outlive the store, without copying long ones
+ *   size:         returns the number of cells with contents
+ *   for_each:     calls a function for every cell with contents
+ *   memory_used:  estimates the bytes held by the tiles and the sparse map
+ *
+ * Private Functions:
+ *   tile_key:     returns the key of the tile holding a cell
+ *   tile_slot:    returns where in its tile a cell is kept
+ *   promote:      moves the sparse cells of an area into a new tile
+ *   demote:       moves the cells of a tile back to sparse cells and frees it
+ *   store:        sets, refers to or removes the contents of a cell
+ */
+class cell_store
+{
+  /* Class: tile
+   *
+   * Description: Dense block of TILE_CELLS cells, column-major
+   */
+  class tile
+  {
+  public:
+    tile();
+    bool has(int slot) const;
+    unsigned long long used[TILE_CELLS / 64]; //Bit per slot that holds contents
+    int count;
+    cell_text cells[TILE_CELLS];
+  };
+
+ public:
+  typedef void (*cell_visitor)(cell_coord coord, const char * contents, size_t length, void * context);
+
+  cell_store(sheet_arena * arena);
+  ~cell_store();
+  bool get(cell_coord coord, const char ** contents, size_t * length) const;
+  void set(cell_coord coord, const char * contents, size_t length);
+  void refer(cell_coord coord, const char * contents, size_t length);
+  size_t size() const;
+  void for_each(cell_visitor visit, void * context) const;
+  size_t memory_used() const;
+
+ private:
+  cell_store(const cell_store &);            //Not copyable
+  cell_store & operator=(const cell_store &);
+  static cell_coord tile_key(cell_coord coord);
+  static int tile_slot(cell_coord coord);
+  void promote(cell_coord key);
+  void demote(std::map<cell_coord, tile*>::iterator it);
+  void store(cell_coord coord, const char * contents, size_t length, bool mapped);
+
+  std::map<cell_coord, tile*> tiles;          //Tile key to tile
+  std::map<cell_coord, cell_text> sparse;     //Cells outside any tile
+  std::map<cell_coord, int> sparse_per_tile;  //Tile key to sparse cells in its area
+  size_t cell_count;
+  sheet_arena * arena;                        //Holds long contents; owned by the spreadsheet
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Filename: client_command.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "client_command.h"
+#include <string.h> // memchr, memcmp
+
+/* Function: is_word
+ * Params: text, a word to compare it with
+ * Return: true if the text is exactly the word
+ */
+static bool is_word(const text_view & text, const char * word, size_t length)
+{
+  return text.length == length && memcmp(text.data, word, length) == 0;
+}
+
+/* Function: parse_command
+ * Params: line received (without its '\n'), scratch string kept by the caller,
+ *         command to fill in
+ * Return: void
+ *
+ * Description: Finds at most the first two spaces of the line; nothing is copied
+ *              unless the line holds a '\r' before its end.
+ */
+void parse_command(const text_view & line, std::string & scratch, client_command * command)
+{
+  text_view text = line;
+  const char * cr = (const char *)memchr(text.data, '\r', text.length);
+  if (cr != NULL)
+  {
+    if (cr == text.data + text.length - 1)
+      text.length--;
+    else
+    {
+      scratch.clear();
+      for (size_t i = 0; i < text.length; i++)
+      {
+        if (text.data[i] != '\r')
+          scratch += text.data[i];
+      }
+      text = text_view(scratch);
+    }
+  }
+
+  const char * end = text.data + text.length;
+  const char * first_space = (const char *)memchr(text.data, ' ', text.length);
+  const char * second_space = NULL;
+  if (first_space != NULL)
+    second_space = (const char *)memchr(first_space + 1, ' ', end - first_space - 1);
+
+  text_view word(text.data, (first_space != NULL ? first_space : end) - text.data);
+  command->kind = COMMAND_INVALID;
+  command->name = text_view();
+  command->argument = text_view();
+
+  if (is_word(word, "connect", 7) || is_word(word, "cell", 4))
+  {
+    // Needs a name and an argument, which may be empty
+    if (second_space == NULL)
+      return;
+    command->kind = word.length == 7 ? COMMAND_CONNECT : COMMAND_CELL;
+    command->name = text_view(first_space + 1, second_space - first_space - 1);
+    command->argument = text_view(second_space + 1, end - second_space - 1);
+  }
+  else if (is_word(word, "register", 8))
+  {
+    // Needs exactly one argument
+    if (first_space == NULL || second_space != NULL)
+      return;
+    command->kind = COMMAND_REGISTER;
+    command->name = text_view(first_space + 1, end - first_space - 1);
+  }
+  else if (is_word(word, "undo", 4))
+    command->kind = COMMAND_UNDO;
+  else if (is_word(word, "redo", 4))
+    command->kind = COMMAND_REDO;
+  else if (is_word(word, "values", 6))
+    command->kind = COMMAND_VALUES;
+  else if (is_word(word, "cells", 5))
+  {
+    // Needs a payload, which is checked when it is applied
+    if (first_space == NULL)
+      return;
+    command->kind = COMMAND_CELLS;
+    command->argument = text_view(first_space + 1, end - first_space - 1);
+  }
+}
+
+/* Function: command_name
+ * Params: one of the COMMAND_* kinds
+ * Return: the command's word, as logged
+ */
+const char * command_name(int kind)
+{
+  static const char * names[] = { "invalid", "connect", "register", "cell", "undo", "redo", "values", "cells" };
+  if (kind < COMMAND_INVALID || kind >= COMMAND_COUNT)
+    return names[COMMAND_INVALID];
+  return names[kind];
+}
@@ -0,0 +1,52 @@
+/*
+ * Filename: client_command.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef CLIENT_COMMAND_H
+#define CLIENT_COMMAND_H
+
+#include <string>
+#include "text_view.h"
+
+// Commands a client can send, told apart by their first word
+#define COMMAND_INVALID  0 // Unknown word, or the wrong number of arguments
+#define COMMAND_CONNECT  1 // connect <user> <spreadsheet name, may hold spaces>
+#define COMMAND_REGISTER 2 // register <user>
+#define COMMAND_CELL     3 // cell <cell name> <contents, may hold spaces>
+#define COMMAND_UNDO     4 // undo (anything after it is ignored)
+#define COMMAND_REDO     5 // redo
+#define COMMAND_VALUES   6 // values
+#define COMMAND_CELLS    7 // cells <cell name> <contents>[\t<cell name> <contents>...], or
+                           // cells <first cell>:<last cell> <contents>[\t<contents>...] row by row:
+                           // many cells set as one edit, so contents can't hold tabs
+#define COMMAND_COUNT    8
+
+/* Class: client_command
+ *
+ * Description: Aggregate holding one parsed command line. The arguments are views
+ *              into the line, or into the scratch string it was parsed with, so
+ *              they are only valid as long as both are.
+ */
+class client_command
+{
+ public:
+  int kind;             //One of the COMMAND_* kinds
+  text_view name;       //User of connect and register, cell of cell; empty otherwise
+  text_view argument;   //The rest of the line after name: spreadsheet of connect, contents of cell,
+                        //everything after the command word of cells
+};
+
+// Splits a command line (without its '\n') into its kind and arguments. Arguments are
+// separated by single spaces, and the last one runs to the end of the line, spaces
+// and all. Every '\r' in the line is ignored. A line whose only '\r' ends it is parsed
+// in place; otherwise the line is copied to scratch without them, so keeping scratch
+// between calls means no command allocates once it is warm.
+void parse_command(const text_view & line, std::string & scratch, client_command * command);
+
+// Returns the word of a COMMAND_* kind ("invalid" for COMMAND_INVALID).
+const char * command_name(int kind);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Filename: command_bench.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Checks and times parse_command() against the tokenizer it replaced,
+ *   which split a command into a vector of strings and joined the trailing ones back
+ *   together. First it feeds both random lines (built mostly from command words,
+ *   spaces, '\r' and cell names, so every branch is hit) and reports any line they
+ *   read differently. Then it times typical commands parsed each way, and cell commands
+ *   parsed and applied to a spreadsheet, reporting nanoseconds and allocations per
+ *   command. Allocations are only counted when built with
+ *   make ALLOC_COUNT=-DCOUNT_ALLOCATIONS command_bench.
+ *
+ *   Usage: command_bench [fuzz lines] [timed rounds]
+ */
+
+#include <algorithm> // remove(), min()
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h> // atoll
+#include <string>
+#include <vector>
+#include "alloc_counter.h"
+#include "client_command.h"
+#include "spreadsheet.h"
+
+/* Function: now_ns
+ * Params: none
+ * Return: nanoseconds on a monotonic clock
+ */
+static double now_ns()
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: split_message
+ * Params: message to split, vector to store results
+ * Return: void
+ *
+ * Description: The server's old tokenizer, kept as it was to compare with
+ */
+static void split_message(std::string message, std::vector<std::string> & ret)
+{
+  message.erase(remove(message.begin(), message.end(), '\r'), message.end());
+  message.erase(remove(message.begin(), message.end(), '\n'), message.end());
+
+  ret.clear();
+  size_t pos = message.find(' ');
+  size_t pos_init = 0;
+
+  while (pos != std::string::npos)
+  {
+    ret.push_back(message.substr(pos_init, pos - pos_init));
+    pos_init = pos + 1;
+    pos = message.find(' ', pos_init);
+  }
+
+  ret.push_back(message.substr(pos_init, message.size() - pos_init));
+}
+
+/* Function: join_from
+ * Params: tokens, first one to join
+ * Return: the tokens from there on, separated by single spaces, as the old
+ *         message_received() put the last argument back together
+ */
+static std::string join_from(const std::vector<std::string> & command, size_t first)
+{
+  std::string joined = "";
+  for (size_t i = first; i < command.size(); i++)
+    joined += command[i] + " ";
+  if (joined[joined.size() - 1] == ' ')
+    joined = joined.substr(0, joined.size() - 1);
+  return joined;
+}
+
+/* Function: old_parse
+ * Params: line received, vector the tokens are split into, strings for the results
+ * Return: the COMMAND_* kind the old message_received() would have acted on
+ *         (cells, which came later, split the same way)
+ */
+static int old_parse(const std::string & line, std::vector<std::string> & command, std::string & name,
+                     std::string & argument)
+{
+  name = "";
+  argument = "";
+  split_message(line, command);
+
+  if (command.at(0) == "connect" || command.at(0) == "cell")
+  {
+    if (command.size() <= 2)
+      return COMMAND_INVALID;
+    name = command.at(1);
+    argument = join_from(command, 2);
+    return command.at(0) == "connect" ? COMMAND_CONNECT : COMMAND_CELL;
+  }
+  if (command.at(0) == "register")
+  {
+    if (command.size() != 2)
+      return COMMAND_INVALID;
+    name = command.at(1);
+    return COMMAND_REGISTER;
+  }
+  if (command.at(0) == "undo")
+    return COMMAND_UNDO;
+  if (command.at(0) == "redo")
+    return COMMAND_REDO;
+  if (command.at(0) == "values")
+    return COMMAND_VALUES;
+  if (command.at(0) == "cells")
+  {
+    if (command.size() < 2)
+      return COMMAND_INVALID;
+    argument = join_from(command, 1);
+    return COMMAND_CELLS;
+  }
+  return COMMAND_INVALID;
+}
+
+/* Function: random_line
+ * Params: string to build the line in
+ * Return: void
+ *
+ * Description: Strings together a few random pieces: command words (sometimes
+ *              misspelt or cut short), spaces, '\r', cell names, formulas and bytes
+ */
+static void random_line(std::string & line)
+{
+  static const char * pieces[] = { "connect", "register", "cell", "undo", "redo", "values", "conn", "cells", "Cell",
+                                   " ", " ", " ", "  ", "\r", "\r", "A1", "b20", "=A1+B2", "sysadmin", "my sheet", "", "x" };
+  const int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+  line.clear();
+  int count = rand() % 8;
+  for (int i = 0; i < count; i++)
+  {
+    if (rand() % 10 == 0)
+      line += (char)(rand() % 256);
+    else
+      line += pieces[rand() % piece_count];
+  }
+  // Many lines start with a real command
+  if (rand() % 2 == 0)
+    line = std::string(pieces[rand() % 6]) + (rand() % 4 ? " " : "") + line;
+  // '\n' never reaches the parser; the reactor frames lines on it
+  std::replace(line.begin(), line.end(), '\n', ' ');
+}
+
+/* Function: fuzz
+ * Params: number of random lines to compare
+ * Return: number of lines parsed differently
+ */
+static long long fuzz(long long lines)
+{
+  std::vector<std::string> tokens;
+  std::string line, scratch, name, argument;
+  long long different = 0;
+  for (long long i = 0; i < lines; i++)
+  {
+    random_line(line);
+    int kind = old_parse(line, tokens, name, argument);
+
+    client_command command;
+    parse_command(text_view(line), scratch, &command);
+    if (command.kind != kind || command.name.str() != name || command.argument.str() != argument)
+    {
+      if (different++ < 10)
+        printf("differs: \"%s\" (old kind %d, new kind %d)\n", line.c_str(), kind, command.kind);
+    }
+  }
+  return different;
+}
+
+/* Class: timing
+ *
+ * Description: Aggregate holding the best time and allocations of one way of handling commands
+ */
+class timing
+{
+ public:
+  double ns_per_command;
+  double allocations_per_command;
+};
+
+/* Function: time_old
+ * Params: lines to parse, spreadsheet to apply cell commands to (NULL to only parse), rounds
+ * Return: the best time and the allocations of the old way
+ */
+static timing time_old(const std::vector<std::string> & lines, spreadsheet * s, int rounds)
+{
+  timing best = { 1e300, 0 };
+  std::vector<std::string> tokens;
+  std::string name, argument;
+  for (int round = 0; round < rounds; round++)
+  {
+    long long allocations = allocation_count();
+    double start = now_ns();
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+      if (old_parse(lines[i], tokens, name, argument) == COMMAND_CELL && s != NULL)
+        s->set_cell(name, argument);
+    }
+    best.ns_per_command = std::min(best.ns_per_command, (now_ns() - start) / lines.size());
+    best.allocations_per_command = (double)(allocation_count() - allocations) / lines.size();
+  }
+  return best;
+}
+
+/* Function: time_new
+ * Params: lines to parse, spreadsheet to apply cell commands to (NULL to only parse), rounds
+ * Return: the best time and the allocations of parse_command()
+ */
+static timing time_new(const std::vector<std::string> & lines, spreadsheet * s, int rounds)
+{
+  timing best = { 1e300, 0 };
+  std::string scratch;
+  client_command command;
+  for (int round = 0; round < rounds; round++)
+  {
+    long long allocations = allocation_count();
+    double start = now_ns();
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+      parse_command(text_view(lines[i]), scratch, &command);
+      if (command.kind == COMMAND_CELL && s != NULL)
+        s->set_cell(command.name, command.argument);
+    }
+    best.ns_per_command = std::min(best.ns_per_command, (now_ns() - start) / lines.size());
+    best.allocations_per_command = (double)(allocation_count() - allocations) / lines.size();
+  }
+  return best;
+}
+
+/* Function: print_row
+ * Params: label, timing
+ * Return: void
+ */
+static void print_row(const char * label, const timing & t)
+{
+  if (allocation_count() == -1)
+    printf("%-28s %10.1f %14s\n", label, t.ns_per_command, "n/a");
+  else
+    printf("%-28s %10.1f %14.2f\n", label, t.ns_per_command, t.allocations_per_command);
+}
+
+/* Function: main
+ * Params: number of arguments, string arguments
+ * Return: 0 if the parsers agreed on every line, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  long long fuzz_lines = argc > 1 ? atoll(argv[1]) : 1000000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  if (fuzz_lines < 0 || rounds < 1)
+  {
+    fprintf(stderr, "Usage: command_bench [fuzz lines] [timed rounds]\n");
+    return 1;
+  }
+
+  srand(1);
+  long long different = fuzz(fuzz_lines);
+  printf("fuzz: %lld random lines, %lld parsed differently\n", fuzz_lines, different);
+
+  // A typical mix: mostly cell edits, short and long, some with CRLF endings
+  std::vector<std::string> mix, cells;
+  for (int i = 0; i < 10000; i++)
+  {
+    char line[128];
+    int row = i % 100 + 1;
+    if (i % 10 == 9)
+      snprintf(line, sizeof line, i % 20 == 9 ? "undo" : "values\r");
+    else if (i % 3 == 0)
+      snprintf(line, sizeof line, "cell B%d =A%d * 2 + C%d\r", row, row, row);
+    else if (i % 3 == 1)
+      snprintf(line, sizeof line, "cell C%d some text that is long enough to leave short strings behind", row);
+    else
+      snprintf(line, sizeof line, "cell A%d %d", row, i);
+    mix.push_back(line);
+    if (mix.back().compare(0, 5, "cell ") == 0)
+      cells.push_back(mix.back());
+  }
+
+  spreadsheet old_sheet("old");
+  spreadsheet new_sheet("new");
+  // Warm both sheets up so every cell and formula already exists
+  time_old(cells, &old_sheet, 1);
+  time_new(cells, &new_sheet, 1);
+
+  printf("%-28s %10s %14s\n", "", "ns/command", "allocs/command");
+  print_row("parse, old", time_old(mix, NULL, rounds));
+  print_row("parse, parse_command", time_new(mix, NULL, rounds));
+  print_row("parse + set_cell, old", time_old(cells, &old_sheet, rounds));
+  print_row("parse + set_cell, new", time_new(cells, &new_sheet, rounds));
+  return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,898 @@
+/*
+ * Filename: engine_bench.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Microbenchmarks of the spreadsheet engine on its own, with no sockets,
+ *   locks or logs involved, in the manner of Google Benchmark: each benchmark is a
+ *   function that sets up what it needs, then loops while state.keep_running(), and is
+ *   run with more and more iterations until a run lasts --benchmark_min_time seconds.
+ *   The workloads are synthetic sheets built once and shared by the benchmarks using
+ *   them: a million constants, a chain of formulas, stacked diamonds (each cell feeds
+ *   two that meet again, so a recalculation that doesn't visit each cell once blows
+ *   up), one SUM over ten thousand cells (fan-in), ten thousand formulas on one
+ *   cell (fan-out), and a 1000 by 50 block pasted cell by cell or as one batch.
+ *
+ *   Prints a table, or with --benchmark_format=json the same JSON as Google Benchmark
+ *   (so its compare.py can diff two runs): time per iteration, iterations, items per
+ *   second where an iteration covers many cells, and allocations per iteration when
+ *   built with make ALLOC_COUNT=-DCOUNT_ALLOCATIONS engine_bench.
+ *
+ *   Usage: engine_bench [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>]
+ *                       [--benchmark_format=console|json] [--benchmark_out=<file>]
+ *                       [--benchmark_list_tests]
+ */
+
+#include <algorithm> // max, min
+#include <stdio.h>
+#include <stdlib.h> // atof, exit
+#include <string.h> // strstr
+#include <string>
+#include <thread>
+#include <time.h> // clock_gettime, strftime
+#include <unistd.h> // gethostname
+#include <vector>
+#include "alloc_counter.h"
+#include "cell_ref.h"
+#include "spreadsheet.h"
+
+#define MILLION_CELLS 1000000
+#define CHAIN_LENGTH 1000
+#define DIAMONDS 100
+#define FAN_WIDTH 10000
+#define SMALL_SHEET_CELLS 1000
+#define PASTE_ROWS 1000
+#define PASTE_COLUMNS 50
+#define MAX_ITERATIONS 1000000000LL
+
+/* Class: bench_state
+ *
+ * Description: What a benchmark function is given: how many iterations to run, and
+ *              where the timing of its loop is kept. Timing (wall clock, thread CPU
+ *              time and allocations) starts at the first keep_running() and stops at
+ *              the last, so setup before the loop isn't measured.
+ *
+ * Public Functions:
+ *   constructor:         sets the iterations to run
+ *   keep_running:        returns true once per iteration
+ *   set_items_processed: sets the cells (or other items) all iterations covered
+ *   fail:                marks the run as invalid, with why
+ */
+class bench_state
+{
+ public:
+  bench_state(long long iterations);
+  bool keep_running();
+  void set_items_processed(long long items);
+  void fail(const std::string & why);
+
+  long long iterations;
+  long long items;        //Items processed by every iteration together, or 0
+  double real_ns;
+  double cpu_ns;
+  long long allocations;  //During the loop, or -1 if not counted
+  std::string error;      //Empty unless the benchmark failed
+
+ private:
+  long long remaining;
+  bool started;
+  double real_start, cpu_start;
+  long long allocations_start;
+};
+
+typedef void (*bench_function)(bench_state & state);
+
+/* Class: bench_case
+ *
+ * Description: A named benchmark
+ */
+class bench_case
+{
+ public:
+  const char * name;
+  bench_function run;
+};
+
+/* Class: bench_result
+ *
+ * Description: The run of a benchmark that is reported
+ */
+class bench_result
+{
+ public:
+  std::string name;
+  long long iterations;
+  double real_ns;         //Per iteration
+  double cpu_ns;          //Per iteration
+  double items_per_second;
+  double allocations;     //Per iteration, or -1
+  std::string error;
+};
+
+/* Function: wall_ns
+ * Params: none
+ * Return: nanoseconds on a monotonic clock
+ */
+static double wall_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Function: thread_cpu_ns
+ * Params: none
+ * Return: CPU time of the calling thread in nanoseconds
+ */
+static double thread_cpu_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Function: bench_state constructor
+ * Params: iterations to run
+ * Return: void
+ */
+bench_state::bench_state(long long iterations)
+{
+  this->iterations = iterations;
+  this->remaining = iterations;
+  this->items = 0;
+  this->real_ns = 0;
+  this->cpu_ns = 0;
+  this->allocations = -1;
+  this->started = false;
+  this->real_start = 0;
+  this->cpu_start = 0;
+  this->allocations_start = 0;
+}
+
+/* Function: keep_running
+ * Params: none
+ * Return: true while there are iterations left to run
+ */
+bool bench_state::keep_running()
+{
+  if (!started)
+  {
+    started = true;
+    allocations_start = allocation_count();
+    cpu_start = thread_cpu_ns();
+    real_start = wall_ns();
+  }
+  if (remaining-- > 0)
+    return true;
+
+  real_ns = wall_ns() - real_start;
+  cpu_ns = thread_cpu_ns() - cpu_start;
+  long long now = allocation_count();
+  allocations = now < 0 ? -1 : now - allocations_start;
+  return false;
+}
+
+/* Function: set_items_processed
+ * Params: items covered by every iteration together
+ * Return: void
+ */
+void bench_state::set_items_processed(long long items)
+{
+  this->items = items;
+}
+
+/* Function: fail
+ * Params: what went wrong
+ * Return: void
+ *
+ * Description: Reported instead of the timing, which would measure the wrong thing
+ */
+void bench_state::fail(const std::string & why)
+{
+  error = why;
+}
+
+/* Function: name_of
+ * Params: number of a cell
+ * Return: its name; cells are numbered across columns A to Z, then down the rows
+ */
+static std::string name_of(int n)
+{
+  char name[16];
+  snprintf(name, sizeof name, "%c%d", 'A' + n % 26, n / 26 + 1);
+  return name;
+}
+
+/* Function: column_cell
+ * Params: column letter, row
+ * Return: the cell's name
+ */
+static std::string column_cell(char column, int row)
+{
+  char name[16];
+  snprintf(name, sizeof name, "%c%d", column, row);
+  return name;
+}
+
+/* Function: set
+ * Params: spreadsheet, cell name, contents
+ * Return: void
+ *
+ * Description: Sets a cell while building a workload, which must not fail
+ */
+static void set(spreadsheet * s, const std::string & name, const std::string & contents)
+{
+  if (s->set_cell(name, contents) != 1)
+  {
+    fprintf(stderr, "engine_bench: building a workload failed at %s = %s\n", name.c_str(), contents.c_str());
+    exit(1);
+  }
+}
+
+/* Function: million_sheet
+ * Params: none
+ * Return: a spreadsheet of MILLION_CELLS numbers, built on first use
+ */
+static spreadsheet * million_sheet()
+{
+  static spreadsheet * s = NULL;
+  if (s == NULL)
+  {
+    s = new spreadsheet("million");
+    char contents[32];
+    for (int i = 0; i < MILLION_CELLS; i++)
+    {
+      snprintf(contents, sizeof contents, "%d", i);
+      set(s, name_of(i), contents);
+    }
+  }
+  return s;
+}
+
+/* Function: chain_sheet
+ * Params: none
+ * Return: A1 = 1 and A(n) = A(n-1) + 1 down to A(CHAIN_LENGTH), built on first use
+ */
+static spreadsheet * chain_sheet()
+{
+  static spreadsheet * s = NULL;
+  if (s == NULL)
+  {
+    s = new spreadsheet("chain");
+    set(s, "A1", "1");
+    for (int row = 2; row <= CHAIN_LENGTH; row++)
+      set(s, column_cell('A', row), "=" + column_cell('A', row - 1) + "+1");
+  }
+  return s;
+}
+
+/* Function: diamond_sheet
+ * Params: none
+ * Return: D1 = 1, then DIAMONDS diamonds down columns A to C, built on first use:
+ *         A(n) and B(n) both use the cell above, C(n) = A(n) + B(n)
+ */
+static spreadsheet * diamond_sheet()
+{
+  static spreadsheet * s = NULL;
+  if (s == NULL)
+  {
+    s = new spreadsheet("diamond");
+    set(s, "D1", "1");
+    for (int row = 1; row <= DIAMONDS; row++)
+    {
+      std::string above = row == 1 ? "D1" : column_cell('C', row - 1);
+      set(s, column_cell('A', row), "=" + above + "+1");
+      set(s, column_cell('B', row), "=" + above + "*2");
+      set(s, column_cell('C', row), "=" + column_cell('A', row) + "+" + column_cell('B', row) + "-" + above + "*3");
+    }
+  }
+  return s;
+}
+
+/* Function: fan_in_sheet
+ * Params: none
+ * Return: B1 to B(FAN_WIDTH) numbers and A1 = their SUM, built on first use
+ */
+static spreadsheet * fan_in_sheet()
+{
+  static spreadsheet * s = NULL;
+  if (s == NULL)
+  {
+    s = new spreadsheet("fan_in");
+    for (int row = 1; row <= FAN_WIDTH; row++)
+      set(s, column_cell('B', row), "1");
+    char sum[64];
+    snprintf(sum, sizeof sum, "=SUM(B1:B%d)", FAN_WIDTH);
+    set(s, "A1", sum);
+  }
+  return s;
+}
+
+/* Function: fan_out_sheet
+ * Params: none
+ * Return: A1 = 1 and B(n) = A1 + n for FAN_WIDTH rows, built on first use
+ */
+static spreadsheet * fan_out_sheet()
+{
+  static spreadsheet * s = NULL;
+  if (s == NULL)
+  {
+    s = new spreadsheet("fan_out");
+    set(s, "A1", "1");
+    char contents[32];
+    for (int row = 1; row <= FAN_WIDTH; row++)
+    {
+      snprintf(contents, sizeof contents, "=A1+%d", row);
+      set(s, column_cell('B', row), contents);
+    }
+  }
+  return s;
+}
+
+/* Function: numbers
+ * Params: how many
+ * Return: "0", "1", ... as strings, so loops don't format them
+ */
+static std::vector<std::string> numbers(int count)
+{
+  std::vector<std::string> result;
+  char text[16];
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(text, sizeof text, "%d", i);
+    result.push_back(text);
+  }
+  return result;
+}
+
+/* Function: names
+ * Params: how many
+ * Return: the names of the first cells, in name_of() order
+ */
+static std::vector<std::string> names(int count)
+{
+  std::vector<std::string> result;
+  for (int i = 0; i < count; i++)
+    result.push_back(name_of(i));
+  return result;
+}
+
+// Benchmarks. Each loop's body is what one iteration measures.
+
+static void set_cell_number(bench_state & state)
+{
+  spreadsheet s("bench");
+  std::vector<std::string> cells = names(SMALL_SHEET_CELLS), values = numbers(SMALL_SHEET_CELLS + 7);
+  long long i = 0;
+  while (state.keep_running())
+  {
+    s.set_cell(cells[i % SMALL_SHEET_CELLS], values[i % (SMALL_SHEET_CELLS + 7)]);
+    i++;
+  }
+}
+
+static void set_cell_text(bench_state & state)
+{
+  spreadsheet s("bench");
+  std::vector<std::string> cells = names(SMALL_SHEET_CELLS);
+  std::string texts[2] = { "some text in a cell", "other text in a cell" };
+  long long i = 0;
+  while (state.keep_running())
+  {
+    s.set_cell(cells[i % SMALL_SHEET_CELLS], texts[(i / SMALL_SHEET_CELLS) % 2]);
+    i++;
+  }
+}
+
+static void set_cell_formula(bench_state & state)
+{
+  spreadsheet s("bench");
+  std::vector<std::string> formulas;
+  for (int row = 1; row <= SMALL_SHEET_CELLS; row++)
+  {
+    set(&s, column_cell('A', row), "2");
+    formulas.push_back("=" + column_cell('A', row) + "*3+1");
+  }
+  std::vector<std::string> cells;
+  for (int row = 1; row <= SMALL_SHEET_CELLS; row++)
+    cells.push_back(column_cell('B', row));
+
+  long long i = 0;
+  while (state.keep_running())
+  {
+    s.set_cell(cells[i % SMALL_SHEET_CELLS], formulas[(i + i / SMALL_SHEET_CELLS) % SMALL_SHEET_CELLS]);
+    i++;
+  }
+}
+
+static void million_fill(bench_state & state)
+{
+  std::vector<std::string> cells = names(MILLION_CELLS), values = numbers(MILLION_CELLS);
+  while (state.keep_running())
+  {
+    spreadsheet s("fill");
+    for (int i = 0; i < MILLION_CELLS; i++)
+      s.set_cell(cells[i], values[i]);
+  }
+  state.set_items_processed(state.iterations * MILLION_CELLS);
+}
+
+static void million_get_cell(bench_state & state)
+{
+  spreadsheet * s = million_sheet();
+  std::vector<std::string> cells = names(4096);
+  for (int i = 0; i < 4096; i++)
+    cells[i] = name_of((int)((i * 2654435761u) % MILLION_CELLS));
+  long long i = 0;
+  size_t total = 0;
+  while (state.keep_running())
+    total += s->get_cell(cells[i++ & 4095]).size();
+  if (total == 0)
+    state.fail("no cell had contents");
+}
+
+/* Function: count_cell
+ * Params: a cell, the count to add it to
+ * Return: void
+ */
+static void count_cell(cell_coord, const char *, size_t length, void * context)
+{
+  (*(long long *)context) += length;
+}
+
+static void million_for_each_cell(bench_state & state)
+{
+  spreadsheet * s = million_sheet();
+  long long bytes = 0;
+  while (state.keep_running())
+    s->for_each_cell(count_cell, &bytes);
+  state.set_items_processed(state.iterations * MILLION_CELLS);
+}
+
+static void million_get_cells(bench_state & state)
+{
+  spreadsheet * s = million_sheet();
+  while (state.keep_running())
+  {
+    std::vector<std::pair<std::string, std::string> > cells;
+    s->get_cells(cells);
+  }
+  state.set_items_processed(state.iterations * MILLION_CELLS);
+}
+
+static void million_copy_cells(bench_state & state)
+{
+  spreadsheet * s = million_sheet();
+  while (state.keep_running())
+  {
+    std::string bytes;
+    std::vector<snapshot_cell> cells;
+    s->copy_cells(bytes, cells);
+  }
+  state.set_items_processed(state.iterations * MILLION_CELLS);
+}
+
+static void chain_set_head(bench_state & state)
+{
+  spreadsheet * s = chain_sheet();
+  std::vector<std::string> values = numbers(10);
+  long long i = 0;
+  while (state.keep_running())
+    s->set_cell(std::string("A1"), values[i++ % 10]);
+  state.set_items_processed(state.iterations * CHAIN_LENGTH);
+  if (s->get_value(column_cell('A', CHAIN_LENGTH)) == "")
+    state.fail("the end of the chain has no value");
+}
+
+static void chain_cycle_check(bench_state & state)
+{
+  spreadsheet * s = chain_sheet();
+  std::string cycle = "=" + column_cell('A', CHAIN_LENGTH) + "+1";
+  int result = 1;
+  while (state.keep_running())
+    result = s->set_cell(std::string("A1"), cycle);
+  state.set_items_processed(state.iterations * CHAIN_LENGTH);
+  if (result != 0)
+    state.fail("the cycle was accepted");
+}
+
+static void chain_get_value(bench_state & state)
+{
+  spreadsheet * s = chain_sheet();
+  std::string tail = column_cell('A', CHAIN_LENGTH);
+  size_t total = 0;
+  while (state.keep_running())
+    total += s->get_value(tail).size();
+  if (total == 0)
+    state.fail("the end of the chain has no value");
+}
+
+static void diamond_set_root(bench_state & state)
+{
+  spreadsheet * s = diamond_sheet();
+  std::vector<std::string> values = numbers(10);
+  long long i = 0;
+  while (state.keep_running())
+    s->set_cell(std::string("D1"), values[i++ % 10]);
+  state.set_items_processed(state.iterations * DIAMONDS * 3);
+}
+
+static void diamond_cycle_check(bench_state & state)
+{
+  spreadsheet * s = diamond_sheet();
+  std::string cycle = "=" + column_cell('C', DIAMONDS);
+  int result = 1;
+  while (state.keep_running())
+    result = s->set_cell(std::string("D1"), cycle);
+  state.set_items_processed(state.iterations * DIAMONDS * 3);
+  if (result != 0)
+    state.fail("the cycle was accepted");
+}
+
+static void fan_in_set_input(bench_state & state)
+{
+  spreadsheet * s = fan_in_sheet();
+  std::vector<std::string> values = numbers(10);
+  std::string input = column_cell('B', FAN_WIDTH / 2);
+  long long i = 0;
+  while (state.keep_running())
+    s->set_cell(input, values[i++ % 10]);
+  state.set_items_processed(state.iterations * FAN_WIDTH);
+}
+
+static void fan_in_set_sum(bench_state & state)
+{
+  spreadsheet * s = fan_in_sheet();
+  char sums[2][64];
+  snprintf(sums[0], sizeof sums[0], "=SUM(B1:B%d)", FAN_WIDTH);
+  snprintf(sums[1], sizeof sums[1], "=SUM(B1:B%d)+0", FAN_WIDTH);
+  std::string formulas[2] = { sums[0], sums[1] };
+  long long i = 0;
+  while (state.keep_running())
+    s->set_cell(std::string("A1"), formulas[i++ % 2]);
+  state.set_items_processed(state.iterations * FAN_WIDTH);
+}
+
+static void fan_out_set_root(bench_state & state)
+{
+  spreadsheet * s = fan_out_sheet();
+  std::vector<std::string> values = numbers(10);
+  long long i = 0;
+  while (state.keep_running())
+    s->set_cell(std::string("A1"), values[i++ % 10]);
+  state.set_items_processed(state.iterations * FAN_WIDTH);
+}
+
+static void undo_redo(bench_state & state)
+{
+  spreadsheet s("bench");
+  std::vector<std::string> cells = names(SMALL_SHEET_CELLS), values = numbers(SMALL_SHEET_CELLS);
+  for (int i = 0; i < SMALL_SHEET_CELLS; i++)
+    set(&s, cells[i], values[i]);
+  std::vector<std::pair<std::string, std::string> > changed;
+  int done = 1;
+  while (state.keep_running())
+  {
+    done &= s.undo(changed);
+    done &= s.redo(changed);
+  }
+  if (!done)
+    state.fail("nothing to undo or redo");
+}
+
+/* Function: paste_block
+ * Params: where to store a PASTE_ROWS by PASTE_COLUMNS block of names, and two sets of contents for it
+ * Return: void
+ */
+static void paste_block(std::vector<std::string> & cells, std::vector<std::string> & first, std::vector<std::string> & second)
+{
+  char text[32];
+  for (int row = 1; row <= PASTE_ROWS; row++)
+  {
+    for (int column = 1; column <= PASTE_COLUMNS; column++)
+    {
+      cells.push_back(cell_name(make_coord(column, row)));
+      snprintf(text, sizeof text, "%d", row * column);
+      first.push_back(text);
+      snprintf(text, sizeof text, "%d.5", row + column);
+      second.push_back(text);
+    }
+  }
+}
+
+static void paste_set_cell(bench_state & state)
+{
+  spreadsheet s("paste");
+  std::vector<std::string> cells, first, second;
+  paste_block(cells, first, second);
+  long long i = 0;
+  while (state.keep_running())
+  {
+    std::vector<std::string> & contents = i++ % 2 == 0 ? first : second;
+    for (size_t cell = 0; cell < cells.size(); cell++)
+      s.set_cell(cells[cell], contents[cell]);
+  }
+  state.set_items_processed(state.iterations * PASTE_ROWS * PASTE_COLUMNS);
+}
+
+static void paste_set_cells(bench_state & state)
+{
+  spreadsheet s("paste");
+  std::vector<std::string> cells, first, second;
+  paste_block(cells, first, second);
+  std::vector<std::pair<text_view, text_view> > batches[2];
+  for (size_t cell = 0; cell < cells.size(); cell++)
+  {
+    batches[0].push_back(std::make_pair(text_view(cells[cell]), text_view(first[cell])));
+    batches[1].push_back(std::make_pair(text_view(cells[cell]), text_view(second[cell])));
+  }
+  long long i = 0;
+  int result = 1;
+  size_t bad;
+  while (state.keep_running())
+    result &= s.set_cells(batches[i++ % 2], &bad);
+  state.set_items_processed(state.iterations * PASTE_ROWS * PASTE_COLUMNS);
+  if (result != 1)
+    state.fail("the paste was refused");
+}
+
+static void paste_undo_redo(bench_state & state)
+{
+  spreadsheet s("paste");
+  std::vector<std::string> cells, first, second;
+  paste_block(cells, first, second);
+  std::vector<std::pair<text_view, text_view> > batch;
+  for (size_t cell = 0; cell < cells.size(); cell++)
+    batch.push_back(std::make_pair(text_view(cells[cell]), text_view(first[cell])));
+  size_t bad;
+  s.set_cells(batch, &bad);
+
+  std::vector<std::pair<std::string, std::string> > changed;
+  int done = 1;
+  while (state.keep_running())
+  {
+    done &= s.undo(changed);
+    done &= s.redo(changed);
+  }
+  state.set_items_processed(state.iterations * 2 * changed.size());
+  if (!done)
+    state.fail("nothing to undo or redo");
+}
+
+static const bench_case benchmarks[] = {
+  { "set_cell/number", set_cell_number },
+  { "set_cell/text", set_cell_text },
+  { "set_cell/formula", set_cell_formula },
+  { "constants_1M/fill", million_fill },
+  { "constants_1M/get_cell", million_get_cell },
+  { "constants_1M/for_each_cell", million_for_each_cell },
+  { "constants_1M/get_cells", million_get_cells },
+  { "constants_1M/copy_cells", million_copy_cells },
+  { "chain_1000/set_head", chain_set_head },
+  { "chain_1000/cycle_check", chain_cycle_check },
+  { "chain_1000/get_value", chain_get_value },
+  { "diamond_100/set_root", diamond_set_root },
+  { "diamond_100/cycle_check", diamond_cycle_check },
+  { "fan_in_10k/set_input", fan_in_set_input },
+  { "fan_in_10k/set_sum", fan_in_set_sum },
+  { "fan_out_10k/set_root", fan_out_set_root },
+  { "undo/undo_redo", undo_redo },
+  { "paste_1000x50/set_cell", paste_set_cell },
+  { "paste_1000x50/set_cells", paste_set_cells },
+  { "paste_1000x50/undo_redo", paste_undo_redo },
+};
+
+/* Function: measure
+ * Params: benchmark, seconds a run must last
+ * Return: its result
+ *
+ * Description: Runs the benchmark with 1 iteration, then with enough more (at most ten
+ *              times as many each time) to last min_time, as Google Benchmark does
+ */
+static bench_result measure(const bench_case & bench, double min_time)
+{
+  long long iterations = 1;
+  while (true)
+  {
+    bench_state state(iterations);
+    bench.run(state);
+
+    double seconds = state.real_ns / 1e9;
+    if (!state.error.empty() || seconds >= min_time || iterations >= MAX_ITERATIONS)
+    {
+      bench_result result;
+      result.name = bench.name;
+      result.iterations = iterations;
+      result.real_ns = state.real_ns / iterations;
+      result.cpu_ns = state.cpu_ns / iterations;
+      result.items_per_second = state.items > 0 && state.real_ns > 0 ? state.items / seconds : 0;
+      result.allocations = state.allocations < 0 ? -1 : (double)state.allocations / iterations;
+      result.error = state.error;
+      return result;
+    }
+
+    double multiplier = seconds > 1e-9 ? min_time * 1.4 / seconds : 10;
+    multiplier = std::min(10.0, std::max(multiplier, 1.0));
+    iterations = std::min(MAX_ITERATIONS, std::max(iterations + 1, (long long)(iterations * multiplier)));
+  }
+}
+
+/* Function: json_string
+ * Params: text
+ * Return: it as a JSON string, quoted and escaped
+ */
+static std::string json_string(const std::string & text)
+{
+  std::string out = "\"";
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    char c = text[i];
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if ((unsigned char)c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof escaped, "\\u%04x", c);
+      out += escaped;
+    }
+    else
+      out += c;
+  }
+  return out + "\"";
+}
+
+/* Function: write_json
+ * Params: where to write, executable name, results
+ * Return: void
+ *
+ * Description: Writes the results in Google Benchmark's JSON layout
+ */
+static void write_json(FILE * out, const char * executable, const std::vector<bench_result> & results)
+{
+  char date[64], host[256];
+  time_t now = time(NULL);
+  struct tm local;
+  localtime_r(&now, &local);
+  strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%S%z", &local);
+  if (gethostname(host, sizeof host) != 0)
+    host[0] = '\0';
+  host[sizeof host - 1] = '\0';
+#ifdef __OPTIMIZE__
+  const char * build = "release";
+#else
+  const char * build = "debug";
+#endif
+
+  fprintf(out, "{\n  \"context\": {\n");
+  fprintf(out, "    \"date\": %s,\n", json_string(date).c_str());
+  fprintf(out, "    \"host_name\": %s,\n", json_string(host).c_str());
+  fprintf(out, "    \"executable\": %s,\n", json_string(executable).c_str());
+  fprintf(out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+  fprintf(out, "    \"library_build_type\": \"%s\",\n", build);
+  fprintf(out, "    \"allocations_counted\": %s\n", allocation_count() < 0 ? "false" : "true");
+  fprintf(out, "  },\n  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const bench_result & r = results[i];
+    fprintf(out, "%s\n    {\n", i == 0 ? "" : ",");
+    fprintf(out, "      \"name\": %s,\n      \"run_name\": %s,\n      \"run_type\": \"iteration\",\n",
+            json_string(r.name).c_str(), json_string(r.name).c_str());
+    fprintf(out, "      \"repetitions\": 1,\n      \"repetition_index\": 0,\n      \"threads\": 1,\n");
+    if (!r.error.empty())
+      fprintf(out, "      \"error_occurred\": true,\n      \"error_message\": %s,\n", json_string(r.error).c_str());
+    fprintf(out, "      \"iterations\": %lld,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\"",
+            r.iterations, r.real_ns, r.cpu_ns);
+    if (r.items_per_second > 0)
+      fprintf(out, ",\n      \"items_per_second\": %.4f", r.items_per_second);
+    if (r.allocations >= 0)
+      fprintf(out, ",\n      \"allocs_per_iter\": %.4f", r.allocations);
+    fprintf(out, "\n    }");
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+/* Function: write_header
+ * Params: where to write
+ * Return: void
+ */
+static void write_header(FILE * out)
+{
+  fprintf(out, "%-28s %15s %15s %12s %14s %12s\n", "Benchmark", "Time", "CPU", "Iterations", "items/s", "allocs/iter");
+  fprintf(out, "%s\n", std::string(101, '-').c_str());
+}
+
+/* Function: write_row
+ * Params: where to write, result
+ * Return: void
+ */
+static void write_row(FILE * out, const bench_result & r)
+{
+  if (!r.error.empty())
+    fprintf(out, "%-28s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+  else
+  {
+    char items[32] = "", allocations[32] = "";
+    if (r.items_per_second > 0)
+      snprintf(items, sizeof items, "%.4gM/s", r.items_per_second / 1e6);
+    if (r.allocations >= 0)
+      snprintf(allocations, sizeof allocations, "%.2f", r.allocations);
+    fprintf(out, "%-28s %12.0f ns %12.0f ns %12lld %14s %12s\n", r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations, items, allocations);
+  }
+  fflush(out);
+}
+
+/* Function: main
+ * Params: see Usage above
+ * Return: 0 if every benchmark ran, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  std::string filter, format = "console", out_path;
+  double min_time = 0.5;
+  bool list = false;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string argument = argv[i];
+    if (argument.compare(0, 19, "--benchmark_filter=") == 0)
+      filter = argument.substr(19);
+    else if (argument.compare(0, 21, "--benchmark_min_time=") == 0)
+      min_time = atof(argument.c_str() + 21);
+    else if (argument.compare(0, 19, "--benchmark_format=") == 0)
+      format = argument.substr(19);
+    else if (argument.compare(0, 16, "--benchmark_out=") == 0)
+      out_path = argument.substr(16);
+    else if (argument == "--benchmark_list_tests")
+      list = true;
+    else
+    {
+      fprintf(stderr, "Usage: engine_bench [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>]\n"
+                      "                    [--benchmark_format=console|json] [--benchmark_out=<file>]\n"
+                      "                    [--benchmark_list_tests]\n");
+      return 1;
+    }
+  }
+  if (format != "console" && format != "json")
+  {
+    fprintf(stderr, "engine_bench: unknown format %s\n", format.c_str());
+    return 1;
+  }
+
+  std::vector<bench_result> results;
+  bool failed = false;
+  for (size_t i = 0; i < sizeof benchmarks / sizeof benchmarks[0]; i++)
+  {
+    if (!filter.empty() && strstr(benchmarks[i].name, filter.c_str()) == NULL)
+      continue;
+    if (list)
+    {
+      printf("%s\n", benchmarks[i].name);
+      continue;
+    }
+    results.push_back(measure(benchmarks[i], min_time));
+    failed |= !results.back().error.empty();
+    if (format == "console")
+    {
+      if (results.size() == 1)
+        write_header(stdout);
+      write_row(stdout, results.back());
+    }
+  }
+
+  if (format == "json")
+    write_json(stdout, argv[0], results);
+  if (!out_path.empty())
+  {
+    FILE * out = fopen(out_path.c_str(), "w");
+    if (out == NULL)
+    {
+      perror("engine_bench out");
+      return 1;
+    }
+    write_json(out, argv[0], results);
+    fclose(out);
+  }
+  return failed ? 1 : 0;
+}
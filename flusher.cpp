@@ -0,0 +1,308 @@
+/*
+ * Filename: flusher.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "flusher.h"
+#include <chrono>
+#include "metrics.h"
+
+/* Function: now_us
+ * Params: none
+ * Return: microseconds on a monotonic clock
+ */
+static long long now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: flusher constructor
+ * Params: milliseconds between flushes
+ * Return: void
+ *
+ * Description: Sets the interval and zeroes the metrics. The thread starts with start().
+ */
+flusher::flusher(int interval_ms)
+{
+  this->interval_ms = interval_ms;
+  this->stopping = false;
+  this->pending_records = 0;
+  this->maintenance = NULL;
+  this->maintenance_ms = 0;
+
+  stats.flushes = 0;
+  stats.records_written = 0;
+  stats.compactions = 0;
+  stats.pending_records = 0;
+  stats.dirty_sheets = 0;
+  stats.oldest_pending_ms = 0;
+  stats.last_flush_us = 0;
+  stats.max_flush_us = 0;
+  stats.total_flush_us = 0;
+}
+
+/* Function: flusher destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Drains and stops the thread if it is still running
+ */
+flusher::~flusher()
+{
+  stop();
+}
+
+/* Function: start
+ * Params: none
+ * Return: void
+ *
+ * Description: Launches the flush thread
+ */
+void flusher::start()
+{
+  flush_thread = std::thread(&flusher::run, this);
+}
+
+/* Function: stop
+ * Params: none
+ * Return: void
+ *
+ * Description: Wakes the thread, which writes everything still pending, forces it
+ *              to disk and exits. Callers must stop producing edits first.
+ */
+void flusher::stop()
+{
+  {
+    std::lock_guard<std::mutex> guard(pending_lock);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  if (flush_thread.joinable())
+    flush_thread.join();
+}
+
+/* Function: mark_dirty
+ * Params: spreadsheet that changed and its log (its lock must be held), the changes (emptied)
+ * Return: void
+ *
+ * Description: Queues the changes, in order, for the next flush, taking the queue lock
+ *              once however many there are. Called with the spreadsheet's lock held, so
+ *              changes to one spreadsheet queue in the order they were made.
+ */
+void flusher::mark_dirty(spreadsheet * s, sheet_log * log, std::vector<std::pair<std::string, std::string> > & changes)
+{
+  if (changes.empty())
+    return;
+
+  std::lock_guard<std::mutex> guard(pending_lock);
+
+  std::map<spreadsheet*, dirty_sheet>::iterator it = dirty.find(s);
+  if (it == dirty.end())
+  {
+    dirty_sheet d;
+    d.sheet = s;
+    d.log = log;
+    d.dirty_since_ms = now_us() / 1000;
+    it = dirty.insert(std::make_pair(s, d)).first;
+  }
+
+  pending_records += changes.size();
+  std::vector<std::pair<std::string, std::string> > & queued = it->second.changes;
+  if (queued.empty())
+    queued.swap(changes); // The usual case: the first batch since the last flush moves in whole
+  else
+    queued.insert(queued.end(), changes.begin(), changes.end());
+  changes.clear();
+}
+
+/* Function: is_dirty
+ * Params: spreadsheet
+ * Return: true if changes of the spreadsheet are queued and not yet handed to its log
+ */
+bool flusher::is_dirty(spreadsheet * s)
+{
+  std::lock_guard<std::mutex> guard(pending_lock);
+  return dirty.count(s) != 0;
+}
+
+/* Function: forget
+ * Params: log of a spreadsheet being unloaded
+ * Return: void
+ *
+ * Description: Forces what was appended to the log to disk and drops it from the logs
+ *              waiting for a sync, so the log can be deleted. Flushes run long after
+ *              the append that queued a log, so deleting it without this leaves a
+ *              dangling pointer for the next one. Only call it on the flush thread
+ *              (from the maintenance task), which owns the set, and only for a
+ *              spreadsheet that isn't dirty.
+ */
+void flusher::forget(sheet_log * log)
+{
+  if (unsynced_logs.erase(log) != 0)
+    log->sync();
+}
+
+/* Function: set_maintenance
+ * Params: task to run, milliseconds between runs
+ * Return: void
+ *
+ * Description: Runs the task on the flush thread, right after a flush, once every
+ *              interval. Call before start(). The task may take spreadsheet locks
+ *              and the logs of spreadsheets that aren't dirty.
+ */
+void flusher::set_maintenance(void (*task)(), int every_ms)
+{
+  maintenance = task;
+  maintenance_ms = every_ms;
+}
+
+/* Function: get_stats
+ * Params: stats to fill in
+ * Return: void
+ *
+ * Description: Copies out the flush metrics along with the current backlog
+ */
+void flusher::get_stats(flusher_stats * out)
+{
+  long long backlog, sheets, oldest = 0;
+  {
+    std::lock_guard<std::mutex> guard(pending_lock);
+    backlog = pending_records;
+    sheets = dirty.size();
+
+    long long now_ms = now_us() / 1000;
+    std::map<spreadsheet*, dirty_sheet>::iterator it;
+    for (it = dirty.begin(); it != dirty.end(); it++)
+    {
+      if (now_ms - it->second.dirty_since_ms > oldest)
+        oldest = now_ms - it->second.dirty_since_ms;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(stats_lock);
+  (*out) = stats;
+  out->pending_records = backlog;
+  out->dirty_sheets = sheets;
+  out->oldest_pending_ms = oldest;
+}
+
+/* Function: run
+ * Params: none
+ * Return: void
+ *
+ * Description: Flushes once per interval until stopped, then drains what is left
+ */
+void flusher::run()
+{
+  long long last_maintenance_us = now_us();
+  while (1)
+  {
+    bool exiting;
+    {
+      std::unique_lock<std::mutex> guard(pending_lock);
+      wake.wait_for(guard, std::chrono::milliseconds(interval_ms));
+      exiting = stopping;
+    }
+
+    flush();
+
+    if (exiting)
+    {
+      // Nothing can be queued any more; make sure all of it reached the disk.
+      std::set<sheet_log*>::iterator it;
+      for (it = unsynced_logs.begin(); it != unsynced_logs.end(); it++)
+        (*it)->sync();
+      unsynced_logs.clear();
+      return;
+    }
+
+    if (maintenance != NULL && now_us() - last_maintenance_us >= maintenance_ms * 1000LL)
+    {
+      maintenance();
+      last_maintenance_us = now_us();
+    }
+  }
+}
+
+/* Function: flush
+ * Params: none
+ * Return: void
+ *
+ * Description: Takes every queued change (holding the queue lock only for a swap),
+ *              appends each spreadsheet's changes to its log in one write, and
+ *              compacts logs that have grown long. The snapshot for compaction is a
+ *              copy of the cells taken under the spreadsheet's lock and written
+ *              after the lock is released; the contents are copied into one
+ *              buffer, so editors wait for a memcpy rather than an allocation per
+ *              cell. Edits made after the changes were taken
+ *              end up both in the copy and in the next flush; replaying them again
+ *              is harmless. Under the same lock the sheet's undo history is spilled
+ *              to its journal (if it has one), so the history of the edits leaving
+ *              the log is on disk before the log is emptied.
+ */
+void flusher::flush()
+{
+  std::map<spreadsheet*, dirty_sheet> taken;
+  long long taken_records;
+  {
+    std::lock_guard<std::mutex> guard(pending_lock);
+    taken.swap(dirty);
+    taken_records = pending_records;
+    pending_records = 0;
+  }
+
+  long long start_ns = metrics::now_ns();
+  long long compactions = 0;
+
+  std::map<spreadsheet*, dirty_sheet>::iterator it;
+  for (it = taken.begin(); it != taken.end(); it++)
+  {
+    sheet_log * log = it->second.log;
+    log->append(it->second.changes);
+    unsynced_logs.insert(log);
+
+    if (log->needs_compaction())
+    {
+      long long compaction_start_ns = metrics::now_ns();
+      std::string snapshot_bytes;
+      std::vector<snapshot_cell> snapshot;
+      {
+        std::lock_guard<spreadsheet> guard(*it->second.sheet);
+        it->second.sheet->copy_cells(snapshot_bytes, snapshot);
+        it->second.sheet->spill_undo();
+      }
+      log->compact(snapshot);
+      compactions++;
+      metrics::record(HISTOGRAM_COMPACTION, metrics::now_ns() - compaction_start_ns);
+    }
+  }
+
+  // Groups that stopped growing still have to reach the disk on time.
+  std::set<sheet_log*>::iterator log_it = unsynced_logs.begin();
+  while (log_it != unsynced_logs.end())
+  {
+    if ((*log_it)->sync_if_due() == 0)
+      unsynced_logs.erase(log_it++);
+    else
+      log_it++;
+  }
+
+  if (taken.empty())
+    return;
+
+  long long elapsed_ns = metrics::now_ns() - start_ns;
+  long long elapsed = elapsed_ns / 1000;
+  metrics::record(HISTOGRAM_FLUSH, elapsed_ns);
+  metrics::count(COUNTER_RECORDS_FLUSHED, taken_records);
+  std::lock_guard<std::mutex> guard(stats_lock);
+  stats.flushes++;
+  stats.records_written += taken_records;
+  stats.compactions += compactions;
+  stats.last_flush_us = elapsed;
+  stats.total_flush_us += elapsed;
+  if (elapsed > stats.max_flush_us)
+    stats.max_flush_us = elapsed;
+}
@@ -0,0 +1,112 @@
+/*
+ * Filename: flusher.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef FLUSHER_H
+#define FLUSHER_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sheet_log.h"
+#include "spreadsheet.h"
+
+/* Class: flusher_stats
+ *
+ * Description: Aggregate holding a point-in-time view of the flusher
+ */
+class flusher_stats
+{
+ public:
+  long long flushes;           //Flush rounds that wrote something
+  long long records_written;   //Records appended to logs since startup
+  long long compactions;       //Snapshots rewritten since startup
+  long long pending_records;   //Backlog: edits waiting for the next flush
+  long long dirty_sheets;      //Backlog: spreadsheets with waiting edits
+  long long oldest_pending_ms; //Age of the oldest waiting edit
+  long long last_flush_us;     //Duration of the most recent flush round
+  long long max_flush_us;      //Longest flush round since startup
+  long long total_flush_us;    //Sum of all flush rounds (for an average)
+};
+
+/* Class: flusher
+ *
+ * Description: Background persistence thread. Edits only mark their spreadsheet
+ *              dirty and queue the change in memory; once per interval the
+ *              flusher appends every sheet's queued changes to its log with one
+ *              write, and compacts logs that have grown long from a copy of the
+ *              cells, so editors are never blocked on the filesystem. A
+ *              maintenance task (such as evicting idle spreadsheets) can run on
+ *              the same thread between flushes, where no flush is in progress.
+ *
+ * Public Functions:
+ *   constructor:   sets the flush interval
+ *   destructor:    stops the thread, draining anything pending
+ *   start:         launches the flush thread
+ *   stop:          flushes everything pending and stops the thread
+ *   mark_dirty:    queues a batch of cell changes of a spreadsheet for the next flush
+ *   is_dirty:      tells if a spreadsheet has changes waiting for a flush
+ *   forget:        syncs a log about to be deleted and stops tracking it
+ *   set_maintenance: sets a task to run on the flush thread every so often
+ *   get_stats:     fills in flush latency and backlog metrics
+ *
+ * Private Functions:
+ *   run:           waits out each interval and flushes
+ *   flush:         writes every queued change to the logs
+ */
+class flusher
+{
+  /* Class: dirty_sheet
+   *
+   * Description: Changes queued for one spreadsheet since the last flush
+   */
+  class dirty_sheet
+  {
+  public:
+    spreadsheet * sheet;
+    sheet_log * log;
+    long long dirty_since_ms;
+    std::vector<std::pair<std::string, std::string> > changes;
+  };
+
+ public:
+  flusher(int interval_ms);
+  ~flusher();
+  void start();
+  void stop();
+  void mark_dirty(spreadsheet * s, sheet_log * log, std::vector<std::pair<std::string, std::string> > & changes);
+  bool is_dirty(spreadsheet * s);
+  void forget(sheet_log * log);
+  void set_maintenance(void (*task)(), int every_ms);
+  void get_stats(flusher_stats * stats);
+
+ private:
+  void run();
+  void flush();
+
+  int interval_ms;
+  bool stopping;
+  std::thread flush_thread;
+
+  std::map<spreadsheet*, dirty_sheet> dirty; //Guarded by pending_lock
+  long long pending_records;                 //Guarded by pending_lock
+  std::mutex pending_lock;
+  std::condition_variable wake;
+
+  std::set<sheet_log*> unsynced_logs;        //Only touched by the flush thread
+
+  void (*maintenance)();                     //Set before start()
+  int maintenance_ms;
+
+  flusher_stats stats;                       //Guarded by stats_lock
+  std::mutex stats_lock;
+};
+
+#endif
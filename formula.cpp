@@ -0,0 +1,543 @@
+/*
+ * Filename: formula.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "formula.h"
+#include <ctype.h>
+#include <functional> // hash
+#include <math.h>    // isnan, isfinite
+#include <stdlib.h>  // strtod
+#include <string.h>  // strlen
+#include <strings.h> // strncasecmp
+
+#define MAX_NESTING 256 // Deepest parentheses accepted, so a hostile formula can't exhaust the stack
+#define SHARD_SIZE ((FORMULA_CACHE_SIZE + FORMULA_CACHE_SHARDS - 1) / FORMULA_CACHE_SHARDS) // Formulas one shard of the cache holds
+
+// Functions a formula may call
+#define FUNCTION_SUM     0
+#define FUNCTION_MIN     1
+#define FUNCTION_MAX     2
+#define FUNCTION_AVERAGE 3
+
+formula::cache_shard formula::cache[FORMULA_CACHE_SHARDS];
+
+/* Function: scan_token
+ * Params: text, where to store the token's kind and, for references, its range
+ * Return: where the token ends
+ *
+ * Description: Splits formulas into tokens the same way the reference_scanner does.
+ *              Kinds are 'n' for a number, 'r' for a cell reference, 'g' for a range,
+ *              'i' for a name made only of letters (a function), 'x' for anything that
+ *              can't be a token, or the character itself for operators and parentheses.
+ */
+static const char * scan_token(const char * begin, const char * end, char * kind, cell_range * range)
+{
+  char c = *begin;
+  const char * p;
+
+  if (isalpha((unsigned char)c))
+  {
+    p = scan_reference(begin, end, range);
+    if (p != begin)
+    {
+      *kind = 'r';
+      for (const char * q = begin; q < p; q++)
+      {
+        if (*q == ':')
+          *kind = 'g';
+      }
+      return p;
+    }
+
+    p = begin;
+    while (p < end && isalpha((unsigned char)*p))
+      p++;
+    *kind = 'i';
+    if (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+    {
+      // Something like A1B, A_1 or a column too long to be a cell
+      while (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+        p++;
+      *kind = 'x';
+    }
+    return p;
+  }
+
+  if (isdigit((unsigned char)c) || c == '.')
+  {
+    p = scan_number(begin, end);
+    *kind = 'n';
+    if (p == begin)
+    {
+      p++;
+      *kind = 'x';
+    }
+    if (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+    {
+      while (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+        p++;
+      *kind = 'x';
+    }
+    return p;
+  }
+
+  *kind = c;
+  return begin + 1;
+}
+
+/* Function: function_id
+ * Params: name of a function
+ * Return: its FUNCTION_* id, or -1 if there is no such function
+ */
+static int function_id(const char * name, size_t length)
+{
+  static const char * names[] = { "SUM", "MIN", "MAX", "AVERAGE" };
+  for (int i = 0; i < 4; i++)
+  {
+    if (length == strlen(names[i]) && strncasecmp(name, names[i], length) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* Function: formula constructor
+ * Params: text of the formula, without its leading '='
+ * Return: void
+ *
+ * Description: Collects the references, then compiles the text into a postfix
+ *              program. If it doesn't parse the program is dropped and valid()
+ *              is false, but the references are kept.
+ */
+formula::formula(const std::string & text)
+{
+  std::map<cell_coord, int> positions;
+  reference_positions = &positions;
+  parsed = true;
+
+  // References first, so they are known even if the formula doesn't parse
+  // Both limits are checked before a range is walked, so a formula that
+  // repeats a large range many times can't add unbounded ids and edges
+  reference_scanner scanner(text.data(), text.data() + text.size());
+  cell_range range;
+  unsigned long long covered = 0;
+  while (scanner.next(&range))
+  {
+    unsigned long long columns = coord_column(range.last) - coord_column(range.first) + 1;
+    unsigned long long rows = coord_row(range.last) - coord_row(range.first) + 1;
+    if (columns * rows > FORMULA_MAX_RANGE_CELLS || covered + columns * rows > FORMULA_MAX_CELLS)
+    {
+      parsed = false;
+      continue;
+    }
+    covered += columns * rows;
+
+    for (unsigned int column = coord_column(range.first); column <= coord_column(range.last); column++)
+    {
+      for (unsigned int row = coord_row(range.first); row <= coord_row(range.last); row++)
+        add_reference(make_coord(column, row));
+    }
+  }
+
+  position = text.data();
+  end = text.data() + text.size();
+  nesting = 0;
+  skip_spaces();
+  if (parsed)
+    parsed = parse_expression();
+  skip_spaces();
+  if (position != end)
+    parsed = false;
+
+  if (!parsed)
+  {
+    program.clear();
+    range_references.clear();
+  }
+  position = NULL;
+  end = NULL;
+  reference_positions = NULL;
+}
+
+/* Function: add_reference
+ * Params: coordinates of a cell
+ * Return: its position in the references, adding it at the end if it is new
+ */
+int formula::add_reference(cell_coord coord)
+{
+  std::map<cell_coord, int>::iterator it = reference_positions->find(coord);
+  if (it != reference_positions->end())
+    return it->second;
+
+  int index = references.size();
+  references.push_back(coord);
+  reference_positions->insert(std::make_pair(coord, index));
+  return index;
+}
+
+/* Function: normalize
+ * Params: text of a formula and its length, string to store the key in
+ * Return: void
+ *
+ * Description: The key is the text without whitespace and with letters uppercased.
+ *              Formulas that normalize the same compile to the same program and
+ *              references. The key string's storage is reused, so a caller that
+ *              keeps passing the same one stops allocating once it is long enough.
+ */
+void formula::normalize(const char * text, size_t length, std::string & key)
+{
+  key.clear();
+  for (size_t i = 0; i < length; i++)
+  {
+    if (!isspace((unsigned char)text[i]))
+      key += toupper((unsigned char)text[i]);
+  }
+}
+
+/* Function: compile
+ * Params: text of the formula, without its leading '=', and its length; scratch
+ *         string for the normalized text (reused between calls)
+ * Return: the compiled formula, shared with every other user of the same formula
+ *
+ * Description: Looks the normalized text up in its shard of the cache and compiles it
+ *              only on a miss, so a hit allocates nothing and only waits for edits
+ *              whose formulas hash to the same shard. A miss compiles outside the
+ *              shard's lock; if another thread cached the same formula meanwhile, its
+ *              compilation is the one shared. When a shard is full, formulas no cell
+ *              uses any more are dropped from it; if every one is still in use the
+ *              shard starts over, which only costs recompiling. Sweeping a shard holds
+ *              its lock for SHARD_SIZE entries at most.
+ *              Safe to call from any thread.
+ */
+std::shared_ptr<const formula> formula::compile(const char * text, size_t length, std::string & key)
+{
+  normalize(text, length, key);
+  cache_shard & shard = cache[std::hash<std::string>()(key) % FORMULA_CACHE_SHARDS];
+
+  {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    std::map<std::string, std::shared_ptr<const formula> >::iterator it = shard.formulas.find(key);
+    if (it != shard.formulas.end())
+      return it->second;
+  }
+
+  std::shared_ptr<const formula> compiled = std::make_shared<formula>(key);
+
+  std::lock_guard<std::mutex> guard(shard.lock);
+  if (shard.formulas.size() >= SHARD_SIZE)
+  {
+    std::map<std::string, std::shared_ptr<const formula> >::iterator it = shard.formulas.begin();
+    while (it != shard.formulas.end())
+    {
+      if (it->second.use_count() == 1)
+        shard.formulas.erase(it++);
+      else
+        it++;
+    }
+    if (shard.formulas.size() >= SHARD_SIZE)
+      shard.formulas.clear();
+  }
+
+  return shard.formulas.insert(std::make_pair(key, compiled)).first->second;
+}
+
+/* Function: valid
+ * Params: none
+ * Return: true if the formula parsed and can be evaluated
+ */
+bool formula::valid() const
+{
+  return parsed;
+}
+
+/* Function: get_references
+ * Params: none
+ * Return: coordinates of the cells the formula refers to, in order of first use
+ */
+const std::vector<cell_coord> & formula::get_references() const
+{
+  return references;
+}
+
+/* Function: evaluate
+ * Params: value of each reference (same order as get_references, NaN for a cell
+ *         without a number), scratch stack (reused between calls), where to store the result
+ * Return: FORMULA_OK, or why the formula has no value
+ *
+ * Description: A cell without a number is an error where it is used directly, as in
+ *              the client, but is skipped where it is part of a function's range.
+ */
+int formula::evaluate(const std::vector<double> & reference_values, std::vector<double> & stack, double * result) const
+{
+  if (!parsed)
+    return FORMULA_BAD_SYNTAX;
+
+  stack.clear();
+
+  std::vector<instruction>::const_iterator it;
+  for (it = program.begin(); it != program.end(); it++)
+  {
+    switch (it->op)
+    {
+      case 'n':
+        stack.push_back(it->number);
+        continue;
+
+      case 'r':
+        if (isnan(reference_values[it->reference]))
+          return FORMULA_BAD_REF;
+        stack.push_back(reference_values[it->reference]);
+        continue;
+
+      case 'g':
+        for (int i = 0; i < it->count; i++)
+          stack.push_back(reference_values[range_references[it->reference + i]]);
+        continue;
+
+      case 'f':
+      {
+        double total = 0, lowest = 0, highest = 0;
+        int numbers = 0;
+        for (size_t i = stack.size() - it->count; i < stack.size(); i++)
+        {
+          double value = stack[i];
+          if (isnan(value))
+            continue;
+          if (numbers == 0 || value < lowest)
+            lowest = value;
+          if (numbers == 0 || value > highest)
+            highest = value;
+          total += value;
+          numbers++;
+        }
+        stack.resize(stack.size() - it->count);
+
+        if (it->reference == FUNCTION_AVERAGE)
+        {
+          if (numbers == 0)
+            return FORMULA_DIV_ZERO;
+          total /= numbers;
+        }
+        stack.push_back(it->reference == FUNCTION_MIN ? lowest : it->reference == FUNCTION_MAX ? highest : total);
+        continue;
+      }
+    }
+
+    double right = stack.back();
+    stack.pop_back();
+    double & left = stack.back();
+    switch (it->op)
+    {
+      case '+': left += right; break;
+      case '-': left -= right; break;
+      case '*': left *= right; break;
+      case '/':
+        if (right == 0)
+          return FORMULA_DIV_ZERO;
+        left /= right;
+        break;
+    }
+  }
+
+  *result = stack.back();
+  if (!isfinite(*result))
+    return FORMULA_BAD_NUMBER;
+  return FORMULA_OK;
+}
+
+/* Function: emit
+ * Params: fields of the instruction
+ * Return: void
+ */
+void formula::emit(char op, int reference, int count, double number)
+{
+  instruction i;
+  i.op = op;
+  i.reference = reference;
+  i.count = count;
+  i.number = number;
+  program.push_back(i);
+}
+
+/* Function: parse_expression
+ * Params: none
+ * Return: true if a valid expression was compiled
+ */
+bool formula::parse_expression()
+{
+  if (!parse_term())
+    return false;
+
+  skip_spaces();
+  while (position < end && (*position == '+' || *position == '-'))
+  {
+    char op = *position++;
+    skip_spaces();
+    if (!parse_term())
+      return false;
+
+    emit(op, -1, 0, 0);
+    skip_spaces();
+  }
+  return true;
+}
+
+/* Function: parse_term
+ * Params: none
+ * Return: true if a valid term was compiled
+ */
+bool formula::parse_term()
+{
+  if (!parse_factor())
+    return false;
+
+  skip_spaces();
+  while (position < end && (*position == '*' || *position == '/'))
+  {
+    char op = *position++;
+    skip_spaces();
+    if (!parse_factor())
+      return false;
+
+    emit(op, -1, 0, 0);
+    skip_spaces();
+  }
+  return true;
+}
+
+/* Function: parse_factor
+ * Params: none
+ * Return: true if a valid number, reference, function call or parenthesized expression was compiled
+ */
+bool formula::parse_factor()
+{
+  if (position >= end)
+    return false;
+
+  char kind;
+  cell_range range;
+  const char * token_end = scan_token(position, end, &kind, &range);
+
+  if (kind == 'n')
+  {
+    emit('n', -1, 0, strtod(position, NULL));
+    position = token_end;
+    return true;
+  }
+
+  if (kind == 'r')
+  {
+    emit('r', add_reference(range.first), 0, 0);
+    position = token_end;
+    return true;
+  }
+
+  if (kind == '(')
+  {
+    if (++nesting > MAX_NESTING)
+      return false;
+
+    position = token_end;
+    skip_spaces();
+    if (!parse_expression())
+      return false;
+    skip_spaces();
+    if (position >= end || *position != ')')
+      return false;
+    position++;
+    nesting--;
+    return true;
+  }
+
+  if (kind == 'i')
+  {
+    int function = function_id(position, token_end - position);
+    if (function == -1 || ++nesting > MAX_NESTING)
+      return false;
+
+    position = token_end;
+    skip_spaces();
+    if (position >= end || *position != '(')
+      return false;
+    position++;
+
+    int count;
+    if (!parse_arguments(&count))
+      return false;
+    emit('f', function, count, 0);
+    nesting--;
+    return true;
+  }
+
+  return false;
+}
+
+/* Function: parse_arguments
+ * Params: where to store how many values the arguments push
+ * Return: true if a comma-separated list of arguments and the closing ')' were compiled
+ *
+ * Description: A range, or a reference standing alone, pushes the value of every cell it
+ *              covers; anything else is an expression and pushes its one value.
+ */
+bool formula::parse_arguments(int * count)
+{
+  *count = 0;
+  while (1)
+  {
+    skip_spaces();
+    if (position >= end)
+      return false;
+
+    char kind;
+    cell_range range;
+    const char * token_end = scan_token(position, end, &kind, &range);
+
+    const char * after = token_end;
+    while (after < end && isspace((unsigned char)*after))
+      after++;
+    bool alone = (after < end && (*after == ',' || *after == ')'));
+
+    if (kind == 'g' || (kind == 'r' && alone))
+    {
+      int first = range_references.size();
+      for (unsigned int column = coord_column(range.first); column <= coord_column(range.last); column++)
+      {
+        for (unsigned int row = coord_row(range.first); row <= coord_row(range.last); row++)
+          range_references.push_back(add_reference(make_coord(column, row)));
+      }
+      emit('g', first, range_references.size() - first, 0);
+      *count += range_references.size() - first;
+      position = token_end;
+    }
+    else
+    {
+      if (!parse_expression())
+        return false;
+      (*count)++;
+    }
+
+    skip_spaces();
+    if (position >= end)
+      return false;
+    if (*position == ')')
+    {
+      position++;
+      return true;
+    }
+    if (*position != ',')
+      return false;
+    position++;
+  }
+}
+
+/* Function: skip_spaces
+ * Params: none
+ * Return: void
+ */
+void formula::skip_spaces()
+{
+  while (position < end && isspace((unsigned char)*position))
+    position++;
+}
@@ -0,0 +1,136 @@
+/*
+ * Filename: formula.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "cell_ref.h"
+
+#ifndef FORMULA_CACHE_SIZE
+#define FORMULA_CACHE_SIZE 65536 // Compiled formulas kept for reuse by compile()
+#endif
+#ifndef FORMULA_CACHE_SHARDS
+#define FORMULA_CACHE_SHARDS 64 // Parts of the cache, each with its own lock, a formula's hash picks from
+#endif
+#ifndef FORMULA_MAX_RANGE_CELLS
+#define FORMULA_MAX_RANGE_CELLS 65536 // Most cells one range may cover
+#endif
+#ifndef FORMULA_MAX_CELLS
+#define FORMULA_MAX_CELLS 262144 // Most cells all of a formula's references may cover, counting repeats
+#endif
+
+// Why evaluating a formula failed
+#define FORMULA_OK          0
+#define FORMULA_BAD_SYNTAX  1 // The formula doesn't parse
+#define FORMULA_BAD_REF     2 // A referenced cell is empty, text or an error
+#define FORMULA_DIV_ZERO    3 // Division by zero
+#define FORMULA_BAD_NUMBER  4 // The result overflowed or isn't a number
+
+/* Class: formula
+ *
+ * Description: A formula compiled once into a postfix program, with the
+ *              same grammar as the client's Formula class: numbers, cell
+ *              references, + - * / and parentheses. On top of that, SUM,
+ *              MIN, MAX and AVERAGE take ranges (A1:C500), references and
+ *              expressions; empty and text cells in their ranges are skipped.
+ *              References are found by a reference_scanner and kept as
+ *              packed coordinates in order of first use, without duplicates;
+ *              a range adds every cell it covers. The program refers to them
+ *              by position, so the spreadsheet can bind them to cells once
+ *              and evaluate without any lookups by name. A formula that
+ *              doesn't parse still reports its references, so the dependency
+ *              graph matches what was typed.
+ *
+ *              Compiled formulas never change, so compile() shares them
+ *              between cells and spreadsheets through a process-wide cache
+ *              keyed by the normalized text: whitespace removed and letters
+ *              uppercased. Retyping, undoing, copying or replaying a formula
+ *              doesn't parse it again. The cache is split into shards by the
+ *              hash of the key, each locked on its own, so edits on different
+ *              spreadsheets rarely wait for each other in it.
+ *
+ * Public Functions:
+ *   constructor:       compiles the text of a formula (without its '=')
+ *   compile:           returns the cached compilation of a formula, compiling it if needed
+ *   valid:             tells if the formula parsed
+ *   get_references:    returns the coordinates of the cells it refers to
+ *   evaluate:          runs the program over the values of its references
+ *
+ * Private Functions:
+ *   add_reference:     returns the position of a cell in the references, adding it if new
+ *   parse_expression:  compiles terms joined by + and -
+ *   parse_term:        compiles factors joined by * and /
+ *   parse_factor:      compiles a number, a reference, a function call or a parenthesized expression
+ *   parse_arguments:   compiles the ranges and expressions passed to a function
+ *   emit:              appends an instruction to the program
+ *   skip_spaces:       moves past whitespace
+ *   normalize:         builds the cache key of a formula's text
+ */
+class formula
+{
+  /* Class: cache_shard
+   *
+   * Description: One part of the cache of compiled formulas and its lock
+   */
+  class cache_shard
+  {
+  public:
+    std::map<std::string, std::shared_ptr<const formula> > formulas;
+    std::mutex lock;
+  };
+
+  /* Class: instruction
+   *
+   * Description: One step of the postfix program
+   */
+  class instruction
+  {
+  public:
+    char op;        //'n' push number, 'r' push reference, 'g' push range, 'f' call function, or one of + - * /
+    int reference;  //Position in the references for 'r', in range_references for 'g', function for 'f'
+    int count;      //Values pushed by 'g', or taken by 'f'
+    double number;  //Value for 'n'
+  };
+
+ public:
+  formula(const std::string & text);
+  static std::shared_ptr<const formula> compile(const char * text, size_t length, std::string & key);
+  bool valid() const;
+  const std::vector<cell_coord> & get_references() const;
+  int evaluate(const std::vector<double> & reference_values, std::vector<double> & stack, double * result) const;
+
+ private:
+  int add_reference(cell_coord coord);
+  bool parse_expression();
+  bool parse_term();
+  bool parse_factor();
+  bool parse_arguments(int * count);
+  void emit(char op, int reference, int count, double number);
+  void skip_spaces();
+  static void normalize(const char * text, size_t length, std::string & key);
+
+  std::vector<instruction> program;
+  std::vector<cell_coord> references;
+  std::vector<int> range_references; //Positions in references of the cells of each range, range after range
+  bool parsed;
+
+  // Parser state, only meaningful while compiling
+  const char * position;
+  const char * end;
+  int nesting;   //Parentheses and calls open at the position
+  std::map<cell_coord, int> * reference_positions;
+
+  // Shared compilations, keyed by normalized text and sharded by its hash
+  static cache_shard cache[FORMULA_CACHE_SHARDS];
+};
+
+#endif
@@ -0,0 +1,1044 @@
+/*
+ * Filename: load_gen.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Load generator for the spreadsheet server, speaking its protocol over
+ *   TCP like the clients do. Every run registers a user, connects every client to its
+ *   spreadsheet, then starts them at once:
+ *
+ *   hot, spread: each of the sheets has writers and readers connected to it. Every
+ *     writer sends cell commands at a fixed rate (or as fast as it can, with -r 0),
+ *     and an undo every so often (-u). The contents of each edit carry the time it
+ *     was scheduled to be sent, so every member of the sheet measures the latency of
+ *     its broadcast, counting the time a writer fell behind its schedule too.
+ *     "hot" is many readers on one sheet; "spread" is many sheets with two writers each.
+ *   bulk: one client fills a sheet with -n cells, then every client connects to it at
+ *     once; the latency is the time from sending connect to receiving the last cell.
+ *   churn: each sheet has one writer that connects, makes an edit, waits for its
+ *     broadcast and disconnects again, -r times a second, so the server can unload the
+ *     sheet between visits. Afterwards every sheet is connected to once more and must
+ *     hold its writer's last edit. Against a server built with a tiny SHEET_MEMORY_BUDGET
+ *     this unloads sheets right after their edits are flushed, while their logs still
+ *     wait for a group sync.
+ *
+ *   With -i, that many idle connections are opened before the run and held through it
+ *   without sending anything, to see what they cost the active clients and the server's
+ *   memory; the ones the server closed are counted at the end.
+ *
+ *   Reports edits and broadcasts per second, p50/p99/p999 latency, broadcasts that never
+ *   arrived, errors and the server's resident memory (with -P or -S), then one RESULT
+ *   line of key=value pairs for scripts comparing runs. A run is reproducible: -e seeds
+ *   which cells are written, and -S starts a fresh server in an empty directory for it.
+ *   Exits with 1 if a broadcast went missing, an idle connection was closed, a churned
+ *   sheet lost its last edit or p99 latency is above the -l limit, so a deploy script
+ *   can gate on it.
+ *
+ *   Usage: load_gen [-m hot|spread|bulk|churn] [-h host] [-p port] [-S server binary | -P server pid]
+ *                   [-s sheets] [-w writers per sheet] [-c readers per sheet (clients, for bulk)]
+ *                   [-r edits per second per writer] [-d seconds] [-n cells] [-u undo percent] [-e seed]
+ *                   [-l p99 limit in microseconds] [-i idle connections]
+ */
+
+#include <algorithm> // find, max, max_element, nth_element
+#include <arpa/inet.h>
+#include <atomic>
+#include <condition_variable>
+#include <errno.h>
+#include <ftw.h> // nftw, to remove a server's directory
+#include <limits.h> // PATH_MAX
+#include <mutex>
+#include <netdb.h> // getaddrinfo
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h> // atoi, mkdtemp, realpath
+#include <string.h> // memchr, strncmp
+#include <string>
+#include <sys/resource.h> // setrlimit, to hold many idle connections
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <time.h> // clock_gettime, nanosleep
+#include <unistd.h> // getopt, fork, execl
+#include <vector>
+
+#define RECEIVE_SIZE 65536        // Bytes each client asks recv() for
+#define QUIET_MS 1000             // Broadcasts have drained once none arrives for this long after the writers stop
+#define DRAIN_LIMIT_MS 30000      // Longest the run waits for broadcasts to drain
+#define SETUP_LIMIT_MS 60000      // Longest the clients may take to connect
+#define RSS_SAMPLE_MS 100         // How often the server's memory is sampled
+#define LOAD_USER "loadgen"       // User every client connects as
+
+/* Class: load_options
+ *
+ * Description: What to run, from the command line
+ */
+class load_options
+{
+ public:
+  std::string mix;
+  std::string host;
+  std::string port;
+  std::string server;   //Binary to start in a fresh directory, or ""
+  int pid;              //Server to sample memory of, or 0
+  int sheets;
+  int writers;          //Per sheet
+  int readers;          //Per sheet; for bulk, clients connecting at once
+  int rate;             //Edits per second per writer, 0 for as fast as possible
+  int seconds;
+  int cells;            //Cells a writer picks from; for bulk, cells in the sheet
+  int undo_percent;
+  unsigned int seed;
+  int p99_limit_us;     //The run fails if p99 latency is above this, or 0
+  int idle;             //Connections held open without sending anything
+};
+
+/* Class: load_client
+ *
+ * Description: One connection and what it measured. Written by its own threads only
+ *              until the run is over.
+ */
+class load_client
+{
+ public:
+  int sock;
+  int sheet;
+  int writer;                         //Index among all writers, or -1 for a reader
+  std::vector<long long> latencies;   //Nanoseconds, one per fresh broadcast (or the connect, for bulk)
+  std::vector<long long> newest;      //Highest sequence seen from each writer
+  long long broadcasts;               //Fresh broadcasts received
+  long long reverted;                 //Broadcasts of undone cells
+  long long errors;                   //"error" lines received
+  long long edits;                    //Cell commands sent (writers)
+  long long undos;                    //Undo commands sent (writers)
+  std::string last_edit;              //"<cell> <contents>" of the last edit applied (churn)
+};
+
+/* Class: line_reader
+ *
+ * Description: Splits what a blocking socket receives into lines
+ */
+class line_reader
+{
+ public:
+  line_reader(int sock) : sock(sock), start(0) {}
+
+  /* Function: next
+   * Params: where to store the line (without its '\n')
+   * Return: false once the socket is closed or fails
+   */
+  bool next(std::string & line)
+  {
+    while (true)
+    {
+      const char * data = buffer.data() + start;
+      const char * newline = (const char *)memchr(data, '\n', buffer.size() - start);
+      if (newline != NULL)
+      {
+        line.assign(data, newline - data);
+        start += newline - data + 1;
+        return true;
+      }
+
+      buffer.erase(0, start);
+      start = 0;
+      size_t used = buffer.size();
+      buffer.resize(used + RECEIVE_SIZE);
+      ssize_t received = recv(sock, &buffer[used], RECEIVE_SIZE, 0);
+      if (received == -1 && errno == EINTR)
+        received = 0;
+      else if (received <= 0)
+        return false;
+      buffer.resize(used + received);
+    }
+  }
+
+ private:
+  int sock;
+  std::string buffer;
+  size_t start;    //Where the unread part of the buffer begins
+};
+
+static load_options options;
+static std::vector<load_client*> clients;
+static std::atomic<int> ready(0);              //Clients connected and synced
+static std::atomic<bool> go(false);            //Set once every client is ready
+static std::mutex go_lock;
+static std::condition_variable go_signal;      //Wakes the clients waiting for go
+static std::atomic<int> finished(0);           //Bulk clients done connecting
+static std::atomic<long long> last_received_ns(0);
+static std::string server_directory;           //Directory of the server started by -S, or ""
+
+/* Function: now_ns
+ * Params: none
+ * Return: nanoseconds on a monotonic clock, which every process on the host shares
+ */
+static long long now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Function: sleep_until
+ * Params: time on the now_ns() clock
+ * Return: void
+ */
+static void sleep_until(long long ns)
+{
+  long long wait = ns - now_ns();
+  if (wait <= 0)
+    return;
+  struct timespec duration;
+  duration.tv_sec = wait / 1000000000LL;
+  duration.tv_nsec = wait % 1000000000LL;
+  nanosleep(&duration, NULL);
+}
+
+/* Function: next_random
+ * Params: state of a generator
+ * Return: the next number (xorshift), the same for the same seed on every host
+ */
+static unsigned int next_random(unsigned int * state)
+{
+  unsigned int x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/* Function: cell_name
+ * Params: number of the cell, buffer of at least 16 bytes
+ * Return: void
+ *
+ * Description: Numbers cells across columns A to Z, then down the rows
+ */
+static void cell_name(int n, char * name)
+{
+  snprintf(name, 16, "%c%d", 'A' + n % 26, n / 26 + 1);
+}
+
+/* Function: send_all
+ * Params: socket, text
+ * Return: false if the connection failed
+ */
+static bool send_all(int sock, const std::string & text)
+{
+  size_t sent = 0;
+  while (sent < text.size())
+  {
+    ssize_t written = send(sock, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+    if (written == -1 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    sent += written;
+  }
+  return true;
+}
+
+/* Function: open_connection
+ * Params: none
+ * Return: a socket connected to the server, or -1
+ */
+static int open_connection()
+{
+  struct addrinfo hints, *result;
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &result) != 0)
+    return -1;
+
+  int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+  if (sock != -1 && connect(sock, result->ai_addr, result->ai_addrlen) == -1)
+  {
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(result);
+
+  int nodelay = 1;
+  if (sock != -1)
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof nodelay);
+  return sock;
+}
+
+/* Function: connect_sheet
+ * Params: socket, its reader, user, spreadsheet, vector to store the cell lines in (or NULL)
+ * Return: cells the server sent, or -1 if it refused or the connection failed
+ *
+ * Description: Connects to the spreadsheet and reads the "connected" reply and every
+ *              cell after it. Errors before the reply (error 4 of a register, say) are skipped.
+ */
+static long long connect_sheet(int sock, line_reader & reader, const char * user, const std::string & sheet,
+                               std::vector<std::string> * cell_lines = NULL)
+{
+  if (!send_all(sock, std::string("connect ") + user + " " + sheet + "\n"))
+    return -1;
+
+  std::string line;
+  while (reader.next(line))
+  {
+    if (line.compare(0, 10, "connected ") != 0)
+      continue;
+    long long cells = atoll(line.c_str() + 10);
+    for (long long i = 0; i < cells; i++)
+    {
+      if (!reader.next(line))
+        return -1;
+      if (cell_lines != NULL)
+        cell_lines->push_back(line);
+    }
+    return cells;
+  }
+  return -1;
+}
+
+/* Function: open_idle
+ * Params: vector to store the sockets in
+ * Return: false if a connection failed
+ *
+ * Description: Opens options.idle connections that never send anything, raising the
+ *              descriptor limit to its hard limit first so they fit
+ */
+static bool open_idle(std::vector<int> & idle)
+{
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  for (int i = 0; i < options.idle; i++)
+  {
+    int sock = open_connection();
+    if (sock == -1)
+      return false;
+    idle.push_back(sock);
+  }
+  return true;
+}
+
+/* Function: count_closed
+ * Params: idle sockets
+ * Return: how many of them the server has closed
+ */
+static int count_closed(const std::vector<int> & idle)
+{
+  int closed = 0;
+  char byte;
+  for (size_t i = 0; i < idle.size(); i++)
+  {
+    ssize_t received = recv(idle[i], &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+      closed++;
+  }
+  return closed;
+}
+
+/* Function: sheet_name
+ * Params: number of a sheet
+ * Return: its name for this mix
+ */
+static std::string sheet_name(int sheet)
+{
+  char name[64];
+  snprintf(name, sizeof name, "load_%s_%d", options.mix.c_str(), sheet);
+  return name;
+}
+
+/* Function: wait_for_go
+ * Params: none
+ * Return: once every client is ready
+ *
+ * Description: Sleeps until woken, so a thousand waiting clients don't take the
+ *              CPU the server and the clients still connecting need
+ */
+static void wait_for_go()
+{
+  std::unique_lock<std::mutex> lock(go_lock);
+  while (!go)
+    go_signal.wait(lock);
+}
+
+/* Function: receive_broadcast
+ * Params: client, a line it received
+ * Return: void
+ *
+ * Description: Counts the line. A cell whose contents hold a newer sequence number of
+ *              their writer than any seen before is a fresh edit, and its latency is
+ *              taken; an older one was brought back by an undo.
+ */
+static void receive_broadcast(load_client * c, const std::string & line, long long now)
+{
+  if (line.compare(0, 6, "error ") == 0)
+  {
+    c->errors++;
+    return;
+  }
+  if (line.compare(0, 5, "cell ") != 0)
+    return;
+
+  size_t space = line.find(' ', 5);
+  long long sent_ns, sequence;
+  int writer;
+  if (space == std::string::npos ||
+      sscanf(line.c_str() + space + 1, "t%lld_%d_%lld", &sent_ns, &writer, &sequence) != 3 ||
+      writer < 0 || writer >= (int)c->newest.size() || sequence <= c->newest[writer])
+  {
+    c->reverted++;
+    return;
+  }
+
+  c->newest[writer] = sequence;
+  c->broadcasts++;
+  c->latencies.push_back(now - sent_ns);
+}
+
+/* Function: write_edits
+ * Params: writer
+ * Return: void
+ *
+ * Description: Sends edits until the run's time is up. With a rate, edit n is due n
+ *              periods after the start and carries that time even when sent late.
+ */
+static void write_edits(load_client * c)
+{
+  unsigned int random = options.seed * 2654435761u + c->writer + 1;
+  if (random == 0)
+    random = 1;
+  long long start = now_ns();
+  long long end = start + options.seconds * 1000000000LL;
+  long long period = options.rate > 0 ? 1000000000LL / options.rate : 0;
+  char line[128], name[16];
+
+  for (long long n = 0; ; n++)
+  {
+    long long due = period > 0 ? start + n * period : now_ns();
+    if (due >= end)
+      break;
+    sleep_until(due);
+
+    int length;
+    if (options.undo_percent > 0 && (int)(next_random(&random) % 100) < options.undo_percent)
+    {
+      length = snprintf(line, sizeof line, "undo\n");
+      c->undos++;
+    }
+    else
+    {
+      cell_name(next_random(&random) % options.cells, name);
+      length = snprintf(line, sizeof line, "cell %s t%lld_%d_%lld\n", name, due, c->writer, n);
+      c->edits++;
+    }
+    if (!send_all(c->sock, std::string(line, length)))
+      break;
+  }
+}
+
+/* Function: run_client
+ * Params: client of a hot or spread run
+ * Return: void
+ *
+ * Description: Connects, waits for the others, then receives broadcasts until its
+ *              socket is shut down, writing from a second thread if it is a writer.
+ */
+static void run_client(load_client * c)
+{
+  line_reader reader(c->sock);
+  if (connect_sheet(c->sock, reader, LOAD_USER, sheet_name(c->sheet)) < 0)
+  {
+    fprintf(stderr, "load_gen: a client couldn't connect to %s\n", sheet_name(c->sheet).c_str());
+    return;
+  }
+  ready++;
+  wait_for_go();
+
+  std::thread writer;
+  if (c->writer >= 0)
+    writer = std::thread(write_edits, c);
+
+  std::string line;
+  while (reader.next(line))
+  {
+    long long now = now_ns();
+    receive_broadcast(c, line, now);
+    last_received_ns.store(now, std::memory_order_relaxed);
+  }
+
+  if (writer.joinable())
+    writer.join();
+}
+
+/* Function: run_bulk_client
+ * Params: client of a bulk run
+ * Return: void
+ *
+ * Description: Waits for the others, then times a connect to the big sheet
+ */
+static void run_bulk_client(load_client * c)
+{
+  line_reader reader(c->sock);
+  ready++;
+  wait_for_go();
+
+  long long start = now_ns();
+  long long cells = connect_sheet(c->sock, reader, LOAD_USER, sheet_name(0));
+  long long end = now_ns();
+  if (cells < 0)
+    c->errors++;
+  else
+  {
+    c->latencies.push_back(end - start);
+    c->broadcasts = cells;
+  }
+
+  long long last = last_received_ns;
+  while (end > last && !last_received_ns.compare_exchange_weak(last, end))
+    ;
+  finished++;
+}
+
+/* Function: run_churn_client
+ * Params: client of a churn run
+ * Return: void
+ *
+ * Description: Waits for the others, then visits its sheet on a fresh connection every
+ *              period until the run's time is up: connects, sends one edit and reads
+ *              until its broadcast comes back before disconnecting. The latency is from
+ *              when the visit was due to the broadcast, so it counts the connect too.
+ */
+static void run_churn_client(load_client * c)
+{
+  ready++;
+  wait_for_go();
+
+  unsigned int random = options.seed * 2654435761u + c->writer + 1;
+  if (random == 0)
+    random = 1;
+  long long start = now_ns();
+  long long end = start + options.seconds * 1000000000LL;
+  long long period = options.rate > 0 ? 1000000000LL / options.rate : 0;
+  char edit[128], name[16];
+
+  for (long long n = 0; ; n++)
+  {
+    long long due = period > 0 ? start + n * period : now_ns();
+    if (due >= end)
+      break;
+    sleep_until(due);
+
+    if (n > 0)
+      c->sock = open_connection();
+    line_reader reader(c->sock);
+    if (c->sock == -1 || connect_sheet(c->sock, reader, LOAD_USER, sheet_name(c->sheet)) < 0)
+    {
+      c->errors++;
+      break;
+    }
+
+    cell_name(next_random(&random) % options.cells, name);
+    int length = snprintf(edit, sizeof edit, "%s t%lld_%d_%lld", name, due, c->writer, n);
+    c->edits++;
+    if (!send_all(c->sock, "cell " + std::string(edit, length) + "\n"))
+      break;
+
+    std::string line;
+    long long errors = c->errors;
+    while (c->newest[c->writer] < n && c->errors == errors && reader.next(line))
+    {
+      long long now = now_ns();
+      receive_broadcast(c, line, now);
+      last_received_ns.store(now, std::memory_order_relaxed);
+    }
+    if (c->newest[c->writer] == n)
+      c->last_edit.assign(edit, length);
+
+    close(c->sock);
+    c->sock = -1;
+  }
+  if (c->sock != -1)
+    close(c->sock);
+  c->sock = -1;
+}
+
+/* Function: holds_last_edit
+ * Params: client of a churn run, once it is done
+ * Return: true if its sheet, connected to again, still holds the last edit it saw applied
+ */
+static bool holds_last_edit(load_client * c)
+{
+  if (c->last_edit.empty())
+    return true;
+
+  int sock = open_connection();
+  if (sock == -1)
+    return false;
+  line_reader reader(sock);
+  std::vector<std::string> cell_lines;
+  bool held = connect_sheet(sock, reader, LOAD_USER, sheet_name(c->sheet), &cell_lines) >= 0 &&
+              std::find(cell_lines.begin(), cell_lines.end(), "cell " + c->last_edit) != cell_lines.end();
+  close(sock);
+  return held;
+}
+
+/* Function: fill_sheet
+ * Params: socket connected as the load user
+ * Return: false if the connection failed
+ *
+ * Description: Sets every cell of the bulk sheet, sending all the edits at once
+ *              from a second thread and waiting for their broadcasts
+ */
+static bool fill_sheet(int sock, line_reader & reader)
+{
+  if (connect_sheet(sock, reader, LOAD_USER, sheet_name(0)) < 0)
+    return false;
+
+  std::thread sender([sock]() {
+    std::string batch;
+    char name[16], line[64];
+    for (int i = 0; i < options.cells; i++)
+    {
+      cell_name(i, name);
+      batch.append(line, snprintf(line, sizeof line, "cell %s %d\n", name, i));
+      if (batch.size() >= RECEIVE_SIZE || i + 1 == options.cells)
+      {
+        send_all(sock, batch);
+        batch.clear();
+      }
+    }
+  });
+
+  std::string line;
+  int received = 0;
+  while (received < options.cells && reader.next(line))
+  {
+    if (line.compare(0, 5, "cell ") == 0)
+      received++;
+  }
+  sender.join();
+  return received == options.cells;
+}
+
+/* Function: resident_kb
+ * Params: process id, field of /proc/<pid>/status ("VmRSS:" or "VmHWM:")
+ * Return: its kilobytes, or -1 if unknown
+ */
+static long long resident_kb(int pid, const char * field)
+{
+  char path[64], line[256];
+  snprintf(path, sizeof path, "/proc/%d/status", pid);
+  FILE * file = fopen(path, "r");
+  if (file == NULL)
+    return -1;
+
+  long long kb = -1;
+  size_t field_length = strlen(field);
+  while (fgets(line, sizeof line, file) != NULL)
+  {
+    if (strncmp(line, field, field_length) == 0)
+    {
+      kb = atoll(line + field_length);
+      break;
+    }
+  }
+  fclose(file);
+  return kb;
+}
+
+/* Function: remove_entry
+ * Params: see nftw()
+ * Return: 0 to keep walking
+ */
+static int remove_entry(const char * path, const struct stat *, int, struct FTW *)
+{
+  remove(path);
+  return 0;
+}
+
+/* Function: start_server
+ * Params: none
+ * Return: pid of a server started on options.port in a new empty directory, or -1
+ *
+ * Description: Its output goes to server.log in that directory. Waits until it accepts
+ *              connections.
+ */
+static int start_server()
+{
+  char binary[PATH_MAX];
+  char scratch[] = "/tmp/load_gen.XXXXXX";
+  if (realpath(options.server.c_str(), binary) == NULL || mkdtemp(scratch) == NULL)
+  {
+    perror("load_gen server");
+    return -1;
+  }
+  server_directory = scratch;
+
+  int pid = fork();
+  if (pid == 0)
+  {
+    if (chdir(scratch) == 0 && freopen("server.log", "w", stdout) != NULL && dup2(fileno(stdout), STDERR_FILENO) != -1)
+      execl(binary, binary, options.port.c_str(), (char *)NULL);
+    perror("load_gen exec");
+    _exit(127);
+  }
+
+  for (int attempt = 0; attempt < 500; attempt++)
+  {
+    int sock = open_connection();
+    if (sock != -1)
+    {
+      close(sock);
+      return pid;
+    }
+    if (waitpid(pid, NULL, WNOHANG) == pid)
+    {
+      fprintf(stderr, "load_gen: the server exited; see %s/server.log\n", scratch);
+      return -1;
+    }
+    usleep(10000);
+  }
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  fprintf(stderr, "load_gen: the server didn't start; see %s/server.log\n", scratch);
+  return -1;
+}
+
+/* Function: finish
+ * Params: exit status
+ * Return: doesn't
+ *
+ * Description: Stops the server started by -S and removes its directory, then exits
+ *              without waiting for client threads
+ */
+static void finish(int status)
+{
+  if (!server_directory.empty())
+  {
+    kill(options.pid, SIGTERM);
+    waitpid(options.pid, NULL, 0);
+    nftw(server_directory.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  }
+  exit(status);
+}
+
+/* Function: percentile
+ * Params: latencies (reordered), fraction
+ * Return: the latency that fraction of them are at most, in microseconds
+ */
+static double percentile(std::vector<long long> & latencies, double fraction)
+{
+  if (latencies.empty())
+    return 0;
+  size_t rank = (size_t)(fraction * latencies.size());
+  if (rank >= latencies.size())
+    rank = latencies.size() - 1;
+  std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+  return latencies[rank] / 1000.0;
+}
+
+/* Function: use_mix
+ * Params: name of the mix
+ * Return: false if there is no such mix
+ *
+ * Description: Sets the defaults of the mix, which the other options override
+ */
+static bool use_mix(const std::string & mix)
+{
+  options.mix = mix;
+  options.rate = 500;
+  options.seconds = 5;
+  options.cells = 1000;
+  options.undo_percent = 0;
+  if (mix == "hot")
+  {
+    options.sheets = 1;
+    options.writers = 4;
+    options.readers = 100;
+  }
+  else if (mix == "spread")
+  {
+    options.sheets = 50;
+    options.writers = 2;
+    options.readers = 0;
+  }
+  else if (mix == "bulk")
+  {
+    options.sheets = 1;
+    options.writers = 0;
+    options.readers = 20;
+    options.cells = 100000;
+  }
+  else if (mix == "churn")
+  {
+    options.sheets = 20;
+    options.writers = 1;
+    options.readers = 0;
+    options.rate = 20;
+  }
+  else
+    return false;
+  return true;
+}
+
+/* Function: main
+ * Params: see Usage above
+ * Return: 0 if the run completed within its limits, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  options.host = "127.0.0.1";
+  options.port = "2000";
+  options.pid = 0;
+  options.seed = 1;
+  options.p99_limit_us = 0;
+  options.idle = 0;
+  use_mix("hot");
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (strcmp(argv[i], "-m") == 0 && !use_mix(argv[i + 1]))
+    {
+      fprintf(stderr, "load_gen: unknown mix %s (hot, spread, bulk or churn)\n", argv[i + 1]);
+      return 1;
+    }
+  }
+
+  int option;
+  while ((option = getopt(argc, argv, "m:h:p:S:P:s:w:c:r:d:n:u:e:l:i:")) != -1)
+  {
+    switch (option)
+    {
+    case 'm': break;
+    case 'h': options.host = optarg; break;
+    case 'p': options.port = optarg; break;
+    case 'S': options.server = optarg; break;
+    case 'P': options.pid = atoi(optarg); break;
+    case 's': options.sheets = atoi(optarg); break;
+    case 'w': options.writers = atoi(optarg); break;
+    case 'c': options.readers = atoi(optarg); break;
+    case 'r': options.rate = atoi(optarg); break;
+    case 'd': options.seconds = atoi(optarg); break;
+    case 'n': options.cells = atoi(optarg); break;
+    case 'u': options.undo_percent = atoi(optarg); break;
+    case 'e': options.seed = strtoul(optarg, NULL, 10); break;
+    case 'l': options.p99_limit_us = atoi(optarg); break;
+    case 'i': options.idle = atoi(optarg); break;
+    default:
+      fprintf(stderr, "Usage: load_gen [-m hot|spread|bulk|churn] [-h host] [-p port] [-S server binary | -P server pid]\n"
+                      "                [-s sheets] [-w writers per sheet] [-c readers per sheet (clients, for bulk)]\n"
+                      "                [-r edits per second per writer] [-d seconds] [-n cells] [-u undo percent] [-e seed]\n"
+                      "                [-l p99 limit in microseconds] [-i idle connections]\n");
+      return 1;
+    }
+  }
+  bool bulk = options.mix == "bulk";
+  bool churn = options.mix == "churn";
+  if (options.sheets < 1 || options.writers < 0 || options.readers < 0 || options.writers + options.readers < 1 ||
+      options.rate < 0 || options.seconds < 1 || options.cells < 1 || options.undo_percent < 0 || options.undo_percent > 100 ||
+      options.idle < 0)
+  {
+    fprintf(stderr, "load_gen: sheets, seconds and cells must be positive and some client must connect\n");
+    return 1;
+  }
+  if (churn && (options.writers != 1 || options.readers != 0 || options.undo_percent != 0))
+  {
+    fprintf(stderr, "load_gen: churn has one writer per sheet, no readers and no undos\n");
+    return 1;
+  }
+
+  if (!options.server.empty())
+  {
+    options.pid = start_server();
+    if (options.pid == -1)
+      return 1;
+  }
+
+  // Register the load user: connect as sysadmin, register, then connect as the user to
+  // know the registration went through (an error 4 means it already exists, which is fine)
+  int setup = open_connection();
+  line_reader setup_reader(setup);
+  if (setup == -1 || connect_sheet(setup, setup_reader, "sysadmin", sheet_name(0)) < 0 ||
+      !send_all(setup, "register " LOAD_USER "\n") || connect_sheet(setup, setup_reader, LOAD_USER, sheet_name(0)) < 0)
+  {
+    fprintf(stderr, "load_gen: couldn't register %s at %s:%s\n", LOAD_USER, options.host.c_str(), options.port.c_str());
+    finish(1);
+  }
+
+  long long fill_ms = 0;
+  if (bulk)
+  {
+    long long start = now_ns();
+    if (!fill_sheet(setup, setup_reader))
+    {
+      fprintf(stderr, "load_gen: filling %s failed\n", sheet_name(0).c_str());
+      finish(1);
+    }
+    fill_ms = (now_ns() - start) / 1000000;
+  }
+
+  std::vector<int> idle;
+  long long idle_start = now_ns();
+  if (!open_idle(idle))
+  {
+    fprintf(stderr, "load_gen: only %d of %d idle connections opened: %s\n", (int)idle.size(), options.idle, strerror(errno));
+    finish(1);
+  }
+  long long idle_ms = (now_ns() - idle_start) / 1000000;
+
+  int writer_count = bulk ? 0 : options.sheets * options.writers;
+  int per_sheet = bulk ? options.readers : options.writers + options.readers;
+  for (int sheet = 0; sheet < (bulk ? 1 : options.sheets); sheet++)
+  {
+    for (int i = 0; i < per_sheet; i++)
+    {
+      load_client * c = new load_client();
+      c->sock = open_connection();
+      if (c->sock == -1)
+      {
+        perror("load_gen connect");
+        finish(1);
+      }
+      c->sheet = sheet;
+      c->writer = i < options.writers && !bulk ? sheet * options.writers + i : -1;
+      c->newest.assign(writer_count, -1);
+      c->broadcasts = c->reverted = c->errors = c->edits = c->undos = 0;
+      clients.push_back(c);
+    }
+  }
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < clients.size(); i++)
+    threads.push_back(std::thread(bulk ? run_bulk_client : churn ? run_churn_client : run_client, clients[i]));
+
+  long long setup_deadline = now_ns() + SETUP_LIMIT_MS * 1000000LL;
+  while (ready < (int)clients.size() && now_ns() < setup_deadline)
+    usleep(1000);
+  if (ready < (int)clients.size())
+  {
+    fprintf(stderr, "load_gen: only %d of %d clients connected\n", (int)ready, (int)clients.size());
+    finish(1);
+  }
+
+  // Run, sampling the server's memory; once the writers are done, wait for quiet
+  long long peak_kb = options.pid > 0 ? resident_kb(options.pid, "VmRSS:") : -1;
+  long long start = now_ns();
+  long long writers_end = start + options.seconds * 1000000000LL;
+  last_received_ns = start;
+  {
+    std::lock_guard<std::mutex> guard(go_lock);
+    go = true;
+  }
+  go_signal.notify_all();
+  while (true)
+  {
+    usleep(RSS_SAMPLE_MS * 1000);
+    if (options.pid > 0)
+      peak_kb = std::max(peak_kb, resident_kb(options.pid, "VmRSS:"));
+
+    long long now = now_ns();
+    if (bulk)
+    {
+      if (finished == (int)clients.size())
+        break;
+      continue;
+    }
+    if (now < writers_end)
+      continue;
+    if (now - last_received_ns > QUIET_MS * 1000000LL || now - writers_end > DRAIN_LIMIT_MS * 1000000LL)
+      break;
+  }
+
+  // Churn clients disconnect on their own once their time is up
+  if (!bulk && !churn)
+  {
+    for (size_t i = 0; i < clients.size(); i++)
+      shutdown(clients[i]->sock, SHUT_RDWR);
+  }
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+  long long elapsed = last_received_ns - start;
+
+  // By now the server has had QUIET_MS to unload the churned sheets; load them again
+  int lost_edits = 0;
+  for (size_t i = 0; i < clients.size() && churn; i++)
+  {
+    if (!holds_last_edit(clients[i]))
+      lost_edits++;
+  }
+
+  // Tally: every member of a sheet should see every edit made to it
+  std::vector<long long> latencies;
+  std::vector<long long> sheet_edits(options.sheets, 0);
+  long long edits = 0, undos = 0, broadcasts = 0, reverted = 0, errors = 0;
+  for (size_t i = 0; i < clients.size(); i++)
+  {
+    load_client * c = clients[i];
+    latencies.insert(latencies.end(), c->latencies.begin(), c->latencies.end());
+    sheet_edits[c->sheet] += c->edits;
+    edits += c->edits;
+    undos += c->undos;
+    broadcasts += c->broadcasts;
+    reverted += c->reverted;
+    errors += c->errors;
+  }
+  long long expected = 0;
+  for (int sheet = 0; sheet < options.sheets && !bulk; sheet++)
+    expected += sheet_edits[sheet] * per_sheet;
+  long long missing = bulk ? (long long)clients.size() * options.cells - broadcasts : expected - broadcasts;
+
+  long long rss_kb = options.pid > 0 ? resident_kb(options.pid, "VmRSS:") : -1;
+  long long hwm_kb = options.pid > 0 ? resident_kb(options.pid, "VmHWM:") : -1;
+  peak_kb = std::max(peak_kb, rss_kb);
+  double seconds = elapsed / 1e9;
+  double p50 = percentile(latencies, 0.5), p99 = percentile(latencies, 0.99), p999 = percentile(latencies, 0.999);
+  double max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end()) / 1000.0;
+
+  if (bulk)
+  {
+    printf("mix bulk: %d clients connecting at once to a sheet of %d cells (filled in %lld ms)\n", options.readers, options.cells, fill_ms);
+    printf("received %lld cells in %.3f s, %.0f cells/s; %lld missing, %lld errors\n", broadcasts, seconds, broadcasts / seconds, missing, errors);
+    printf("connect latency: p50 %.0f us, p99 %.0f us, p999 %.0f us, max %.0f us\n", p50, p99, p999, max);
+  }
+  else
+  {
+    printf("mix %s: %d sheet(s) x (%d writers + %d readers), %s%d edits/s per writer, %d s, %d%% undos\n",
+           options.mix.c_str(), options.sheets, options.writers, options.readers,
+           options.rate > 0 ? "" : "unlimited ", options.rate, options.seconds, options.undo_percent);
+    printf("sent %lld edits and %lld undos, %.0f edits/s; %lld broadcasts delivered, %.0f/s (+%lld of undone cells)\n",
+           edits, undos, edits / (double)options.seconds, broadcasts, broadcasts / seconds, reverted);
+    printf("%.0f edits/s applied (every member of a sheet got them); %lld broadcasts missing, %lld errors\n",
+           broadcasts / seconds / per_sheet, missing, errors);
+    printf("broadcast latency: p50 %.0f us, p99 %.0f us, p999 %.0f us, max %.0f us\n", p50, p99, p999, max);
+  }
+  if (churn)
+    printf("churn: %d of %d sheets lost their last edit (or the server stopped answering)\n", lost_edits, options.sheets);
+  int idle_closed = count_closed(idle);
+  if (options.idle > 0)
+    printf("idle: %d connections held through the run (opened in %lld ms), %d closed by the server\n",
+           options.idle, idle_ms, idle_closed);
+  if (options.pid > 0)
+    printf("server memory: %lld KB resident at the end, %lld KB at most while sampled, %lld KB peak (VmHWM)\n", rss_kb, peak_kb, hwm_kb);
+  printf("RESULT mix=%s sheets=%d writers=%d readers=%d idle=%d edits_per_s=%.0f applied_per_s=%.0f deliveries_per_s=%.0f p50_us=%.0f p99_us=%.0f p999_us=%.0f max_us=%.0f missing=%lld lost_edits=%d errors=%lld rss_kb=%lld peak_rss_kb=%lld\n",
+         options.mix.c_str(), options.sheets, options.writers, options.readers, options.idle, bulk ? 0 : edits / (double)options.seconds,
+         bulk ? 0 : broadcasts / seconds / per_sheet, broadcasts / seconds, p50, p99, p999, max,
+         missing, lost_edits, errors, rss_kb, hwm_kb);
+
+  close(setup);
+  for (size_t i = 0; i < clients.size(); i++)
+    close(clients[i]->sock);
+  for (size_t i = 0; i < idle.size(); i++)
+    close(idle[i]);
+  bool too_slow = options.p99_limit_us > 0 && p99 > options.p99_limit_us;
+  if (too_slow)
+    printf("p99 latency is above the limit of %d us\n", options.p99_limit_us);
+  finish(missing == 0 && idle_closed == 0 && lost_edits == 0 && !too_slow ? 0 : 1);
+}
@@ -0,0 +1,420 @@
+/*
+ * Filename: logger.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "logger.h"
+#include <errno.h>
+#include <stdio.h> // vsnprintf, snprintf
+#include <string.h> // memcpy, strerror_r
+#include <sys/time.h> // gettimeofday
+#include <time.h> // gmtime_r
+#include <unistd.h>
+
+#define LOG_BATCH_SIZE 65536 // Bytes of formatted records the writer collects per write()
+#define LOG_LINE_MAX 1024    // Longest formatted record, escapes and all
+
+logger::slot * logger::slots = NULL;
+std::atomic<size_t> logger::tail(0);
+size_t logger::head = 0;
+std::atomic<bool> logger::running(false);
+std::atomic<bool> logger::stopping(false);
+std::atomic<int> logger::level(LOG_LEVEL);
+std::atomic<long long> logger::dropped_records(0);
+std::thread logger::writer;
+
+static const char * level_names[] = { "debug", "info", "warn", "error" };
+
+/* Function: write_all
+ * Params: buffer and its length
+ * Return: void
+ *
+ * Description: Writes the whole buffer to stderr, giving up on errors other than EINTR
+ */
+static void write_all(const char * buffer, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t written = ::write(STDERR_FILENO, buffer, length);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    buffer += written;
+    length -= written;
+  }
+}
+
+/* Function: copy_field
+ * Params: text to copy, field to copy it to and its size, where to store the length kept
+ * Return: void
+ */
+static void copy_field(const text_view & text, char * field, size_t size, unsigned char * length)
+{
+  size_t kept = text.length < size ? text.length : size;
+  if (kept > 0)
+    memcpy(field, text.data, kept);
+  *length = (unsigned char)kept;
+}
+
+/* Function: append_value
+ * Params: value, buffer, its size, where the buffer ends so far
+ * Return: void
+ *
+ * Description: Appends a logfmt value, quoted if it holds a space, '=', '"' or
+ *              nothing, with '"', '\' and control characters escaped so every
+ *              record stays on one line
+ */
+static void append_value(const char * value, size_t length, char * buffer, size_t size, size_t * used)
+{
+  bool quote = length == 0;
+  for (size_t i = 0; i < length && !quote; i++)
+    quote = value[i] == ' ' || value[i] == '=' || value[i] == '"' || (unsigned char)value[i] < 0x20 || value[i] == '\\';
+
+  size_t at = *used;
+  if (quote && at < size)
+    buffer[at++] = '"';
+  for (size_t i = 0; i < length && at + 4 < size; i++)
+  {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\')
+    {
+      buffer[at++] = '\\';
+      buffer[at++] = c;
+    }
+    else if (c == '\n')
+    {
+      buffer[at++] = '\\';
+      buffer[at++] = 'n';
+    }
+    else if (c < 0x20 || c == 0x7f)
+      at += snprintf(buffer + at, size - at, "\\x%02x", c);
+    else
+      buffer[at++] = c;
+  }
+  if (quote && at < size)
+    buffer[at++] = '"';
+  *used = at;
+}
+
+/* Function: append_text
+ * Params: text, buffer, its size, where the buffer ends so far
+ * Return: void
+ *
+ * Description: Appends text as is (keys and numbers)
+ */
+static void append_text(const char * text, char * buffer, size_t size, size_t * used)
+{
+  size_t at = *used;
+  for (; *text != '\0' && at < size; text++)
+    buffer[at++] = *text;
+  *used = at;
+}
+
+/* Function: start
+ * Params: none
+ * Return: void
+ *
+ * Description: Allocates the queue and launches the writer thread. Records logged
+ *              before this were written to stderr directly.
+ */
+void logger::start()
+{
+  if (running)
+    return;
+
+  if (slots == NULL)
+  {
+    slots = new slot[LOG_QUEUE_SIZE];
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  stopping = false;
+  running = true;
+  writer = std::thread(run);
+}
+
+/* Function: stop
+ * Params: none
+ * Return: void
+ *
+ * Description: Writes every queued record and joins the writer thread. Call it once the
+ *              other threads have stopped logging; whatever is logged after it is
+ *              written to stderr directly.
+ */
+void logger::stop()
+{
+  if (!running)
+    return;
+
+  stopping = true;
+  writer.join();
+  running = false;
+
+  // Anything queued while the writer was finishing up
+  char buffer[LOG_BATCH_SIZE];
+  size_t length = drain(buffer, sizeof buffer);
+  write_all(buffer, length);
+}
+
+/* Function: enabled
+ * Params: level of a record
+ * Return: true if records of that level are kept
+ */
+bool logger::enabled(int record_level)
+{
+  return record_level >= level.load(std::memory_order_relaxed);
+}
+
+/* Function: set_level
+ * Params: least severe level to keep
+ * Return: void
+ */
+void logger::set_level(int new_level)
+{
+  level = new_level;
+}
+
+/* Function: sample
+ * Params: none
+ * Return: true for one call in LOG_SAMPLE_EVERY on each thread
+ *
+ * Description: Per-message records (one per command handled, say) are only logged
+ *              when this says so, which keeps their cost and volume bounded under load
+ */
+bool logger::sample()
+{
+  static __thread unsigned int calls = 0;
+  return calls++ % LOG_SAMPLE_EVERY == 0;
+}
+
+/* Function: log
+ * Params: level, structured fields, printf-style format of the message and its arguments
+ * Return: void
+ *
+ * Description: Queues the record for the writer thread if its level is kept
+ */
+void logger::log(int record_level, const log_fields & fields, const char * format, ...)
+{
+  if (!enabled(record_level))
+    return;
+
+  va_list arguments;
+  va_start(arguments, format);
+  push(record_level, fields, format, arguments);
+  va_end(arguments);
+}
+
+/* Function: error
+ * Params: what failed
+ * Return: void
+ *
+ * Description: Logs what failed with the description of errno, as perror() printed it
+ */
+void logger::error(const char * what)
+{
+  log_fields fields;
+  fields.error = errno;
+  log(LOG_ERROR, fields, "%s", what);
+}
+
+/* Function: dropped
+ * Params: none
+ * Return: number of records dropped because the queue was full
+ */
+long long logger::dropped()
+{
+  return dropped_records;
+}
+
+/* Function: push
+ * Params: level, structured fields, format of the message and its arguments
+ * Return: void
+ *
+ * Description: Claims the slot at the tail of the queue with one compare-and-swap and
+ *              formats the record into it, or drops the record if the queue is full.
+ *              If the writer isn't running the record is written straight to stderr.
+ */
+void logger::push(int record_level, const log_fields & fields, const char * format, va_list arguments)
+{
+  int saved_errno = errno;
+  record local;
+  record * r = &local;
+  slot * claimed = NULL;
+  size_t position = 0;
+
+  if (running.load(std::memory_order_acquire))
+  {
+    position = tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+      slot * s = &slots[position & (LOG_QUEUE_SIZE - 1)];
+      size_t sequence = s->sequence.load(std::memory_order_acquire);
+      long long difference = (long long)sequence - (long long)position;
+      if (difference == 0)
+      {
+        if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          claimed = s;
+          break;
+        }
+      }
+      else if (difference < 0)
+      {
+        dropped_records++;
+        errno = saved_errno;
+        return;
+      }
+      else
+        position = tail.load(std::memory_order_relaxed);
+    }
+    r = &claimed->entry;
+  }
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  r->time_us = (long long)now.tv_sec * 1000000 + now.tv_usec;
+  r->level = record_level;
+  r->socket = fields.socket;
+  r->latency_us = fields.latency_us;
+  r->error = fields.error;
+  copy_field(fields.sheet, r->sheet, sizeof r->sheet, &r->sheet_length);
+  copy_field(fields.command, r->command, sizeof r->command, &r->command_length);
+  int length = vsnprintf(r->text, sizeof r->text, format, arguments);
+  r->text_length = length < 0 ? 0 : (length < (int)sizeof r->text ? length : sizeof r->text - 1);
+
+  if (claimed != NULL)
+    claimed->sequence.store(position + 1, std::memory_order_release);
+  else
+  {
+    char line[LOG_LINE_MAX];
+    write_all(line, logger::format(local, line, sizeof line));
+  }
+  errno = saved_errno;
+}
+
+/* Function: run
+ * Params: none
+ * Return: void
+ *
+ * Description: The writer thread. Drains the queue in batches until stop() is called
+ *              and the queue is empty, sleeping LOG_DRAIN_INTERVAL_MS whenever it is.
+ */
+void logger::run()
+{
+  char * buffer = new char[LOG_BATCH_SIZE];
+  long long reported_drops = 0;
+
+  while (true)
+  {
+    bool finishing = stopping;
+    size_t length = drain(buffer, LOG_BATCH_SIZE);
+
+    long long drops = dropped_records;
+    if (drops != reported_drops && length + LOG_LINE_MAX <= LOG_BATCH_SIZE)
+    {
+      record r;
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      r.time_us = (long long)now.tv_sec * 1000000 + now.tv_usec;
+      r.level = LOG_WARN;
+      r.socket = -1;
+      r.latency_us = -1;
+      r.error = 0;
+      r.sheet_length = 0;
+      r.command_length = 0;
+      int text_length = snprintf(r.text, sizeof r.text, "log queue full, dropped %lld records", drops - reported_drops);
+      r.text_length = text_length < (int)sizeof r.text ? text_length : sizeof r.text - 1;
+      length += format(r, buffer + length, LOG_BATCH_SIZE - length);
+      reported_drops = drops;
+    }
+
+    if (length > 0)
+      write_all(buffer, length);
+    else if (finishing)
+      break;
+    else
+      usleep(LOG_DRAIN_INTERVAL_MS * 1000);
+  }
+
+  delete [] buffer;
+}
+
+/* Function: drain
+ * Params: buffer and its size
+ * Return: bytes of formatted records put in the buffer
+ *
+ * Description: Formats queued records in order until the queue is empty or the buffer
+ *              can't be sure to fit another, freeing each slot for the producers
+ */
+size_t logger::drain(char * buffer, size_t size)
+{
+  size_t length = 0;
+  while (length + LOG_LINE_MAX <= size)
+  {
+    slot * s = &slots[head & (LOG_QUEUE_SIZE - 1)];
+    if (s->sequence.load(std::memory_order_acquire) != head + 1)
+      break;
+
+    length += format(s->entry, buffer + length, size - length);
+    s->sequence.store(head + LOG_QUEUE_SIZE, std::memory_order_release);
+    head++;
+  }
+  return length;
+}
+
+/* Function: format
+ * Params: record, buffer and its size (at least LOG_LINE_MAX)
+ * Return: bytes written: one logfmt line, ending in '\n'
+ */
+size_t logger::format(const record & r, char * buffer, size_t size)
+{
+  size_t used = 0;
+  size_t limit = size - 1; // Room for the '\n'
+  char number[64];
+
+  time_t seconds = r.time_us / 1000000;
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  used = strftime(buffer, limit, "time=%Y-%m-%dT%H:%M:%S", &utc);
+  snprintf(number, sizeof number, ".%03dZ level=", (int)(r.time_us % 1000000 / 1000));
+  append_text(number, buffer, limit, &used);
+  append_text(level_names[r.level < 0 ? 0 : (r.level > LOG_ERROR ? LOG_ERROR : r.level)], buffer, limit, &used);
+
+  append_text(" msg=", buffer, limit, &used);
+  append_value(r.text, r.text_length, buffer, limit, &used);
+  if (r.socket != -1)
+  {
+    snprintf(number, sizeof number, " socket=%d", r.socket);
+    append_text(number, buffer, limit, &used);
+  }
+  if (r.sheet_length > 0)
+  {
+    append_text(" sheet=", buffer, limit, &used);
+    append_value(r.sheet, r.sheet_length, buffer, limit, &used);
+  }
+  if (r.command_length > 0)
+  {
+    append_text(" command=", buffer, limit, &used);
+    append_value(r.command, r.command_length, buffer, limit, &used);
+  }
+  if (r.latency_us != -1)
+  {
+    snprintf(number, sizeof number, " latency_us=%lld", r.latency_us);
+    append_text(number, buffer, limit, &used);
+  }
+  if (r.error != 0)
+  {
+    char description[128];
+    const char * text = strerror_r(r.error, description, sizeof description);
+    append_text(" error=", buffer, limit, &used);
+    append_value(text, strlen(text), buffer, limit, &used);
+  }
+
+  buffer[used++] = '\n';
+  return used;
+}
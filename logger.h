@@ -0,0 +1,145 @@
+/*
+ * Filename: logger.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <stdarg.h> // va_list
+#include <stddef.h>
+#include <thread>
+#include "text_view.h"
+
+// Levels of log records, least severe first
+#define LOG_DEBUG 0
+#define LOG_INFO  1
+#define LOG_WARN  2
+#define LOG_ERROR 3
+
+// Logging limits (override with -D at compile time)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO        // Records below this level are dropped before anything is formatted
+#endif
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 4096       // Records waiting to be written (a power of two); more are dropped and counted
+#endif
+#ifndef LOG_SAMPLE_EVERY
+#define LOG_SAMPLE_EVERY 1024     // Per-message records are kept for one message in this many
+#endif
+#ifndef LOG_DRAIN_INTERVAL_MS
+#define LOG_DRAIN_INTERVAL_MS 20  // How long the writer thread sleeps when the queue is empty
+#endif
+#define LOG_TEXT_SIZE 160         // Longest message a record keeps
+#define LOG_FIELD_SIZE 48         // Longest sheet or command a record keeps
+
+/* Class: log_fields
+ *
+ * Description: Structured fields of a log record. A field left as constructed
+ *              is not written. The text is copied, so views only need to be
+ *              valid until the record is logged.
+ */
+class log_fields
+{
+ public:
+  log_fields() : socket(-1), latency_us(-1), error(0) {}
+  int socket;             //Client socket the record is about
+  text_view sheet;        //Spreadsheet name
+  text_view command;      //Command word
+  long long latency_us;   //How long handling took
+  int error;              //errno value, written as its description
+};
+
+/* Class: logger
+ *
+ * Description: Leveled, structured logging that never blocks the thread logging.
+ *              Each record (time, level, message and log_fields) is formatted into
+ *              a fixed-size slot of a bounded lock-free queue, which a background
+ *              thread drains, writing the records to stderr as logfmt lines
+ *              (time=... level=info msg="..." socket=7 ...) in batches. Taking a
+ *              slot is one compare-and-swap; nothing is allocated and no lock is
+ *              taken. When the queue is full the record is dropped and counted,
+ *              and the count is logged once there is room. Before start() and
+ *              after stop(), records are written straight to stderr instead, so
+ *              tools that never start the writer thread still see them.
+ *
+ * Public Functions:
+ *   start:     launches the writer thread
+ *   stop:      writes every queued record and joins the writer thread
+ *   enabled:   tells if records of a level are kept
+ *   set_level: keeps records of a level and above
+ *   sample:    tells if this message's per-message records should be kept (one in LOG_SAMPLE_EVERY per thread)
+ *   log:       logs a printf-style message with structured fields
+ *   error:     logs what failed at LOG_ERROR with errno's description, like perror()
+ *   dropped:   returns how many records were dropped because the queue was full
+ *
+ * Private Functions:
+ *   push:      formats a record into the queue, or writes it straight away if the writer isn't running
+ *   run:       the writer thread: drains the queue into stderr
+ *   drain:     formats every queued record into a buffer
+ *   format:    appends a record as one logfmt line to a buffer
+ */
+class logger
+{
+  /* Class: record
+   *
+   * Description: One queued log record, with its fields copied in
+   */
+  class record
+  {
+  public:
+    long long time_us;    //Wall clock time it was logged
+    int level;
+    int socket;
+    long long latency_us;
+    int error;
+    unsigned char sheet_length;
+    unsigned char command_length;
+    unsigned char text_length;
+    char sheet[LOG_FIELD_SIZE];
+    char command[LOG_FIELD_SIZE];
+    char text[LOG_TEXT_SIZE];
+  };
+
+  /* Class: slot
+   *
+   * Description: Place in the queue. Its sequence tells whether it is free for the
+   *              producer at a position or holds the record for the writer there.
+   */
+  class slot
+  {
+  public:
+    std::atomic<size_t> sequence;
+    record entry;
+  };
+
+ public:
+  static void start();
+  static void stop();
+  static bool enabled(int level);
+  static void set_level(int level);
+  static bool sample();
+  static void log(int level, const log_fields & fields, const char * format, ...) __attribute__((format(printf, 3, 4)));
+  static void error(const char * what);
+  static long long dropped();
+
+ private:
+  static void push(int level, const log_fields & fields, const char * format, va_list arguments);
+  static void run();
+  static size_t drain(char * buffer, size_t size);
+  static size_t format(const record & r, char * buffer, size_t size);
+
+  static slot * slots;                 //LOG_QUEUE_SIZE slots, allocated by start()
+  static std::atomic<size_t> tail;     //Next position a producer takes
+  static size_t head;                  //Next position the writer reads; only the writer touches it
+  static std::atomic<bool> running;    //The writer thread owns the queue
+  static std::atomic<bool> stopping;
+  static std::atomic<int> level;
+  static std::atomic<long long> dropped_records;
+  static std::thread writer;
+};
+
+#endif
@@ -0,0 +1,567 @@
+/*
+ * Filename: metrics.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "metrics.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h> // snprintf, fopen, rename
+#include <string.h> // memset, strcmp, strstr
+#include <sys/socket.h>
+#include <time.h> // clock_gettime
+#include <unistd.h>
+#include "logger.h"
+
+#define METRICS_POLL_MS 200          // Longest the admin thread waits before checking whether to stop
+#define METRICS_REQUEST_MAX 4096     // Bytes of a scrape request read before answering
+#define METRICS_LOW_BUCKET_BITS 10   // Prometheus buckets run from 2^10 ns (about a microsecond)...
+#define METRICS_HIGH_BUCKET_BITS 36  // ...to 2^36 ns (about a minute), doubling
+
+std::vector<metrics::shard*> metrics::shards;
+std::mutex metrics::shards_lock;
+metrics_collector metrics::collector = NULL;
+std::atomic<bool> metrics::stopping(false);
+std::thread metrics::admin;
+
+/* Class: histogram_info
+ *
+ * Description: How a histogram is exported: its metric family, the help line of the
+ *              family and the label telling it apart from the rest of the family
+ */
+class histogram_info
+{
+ public:
+  const char * family;
+  const char * help;
+  const char * label;   //Label name, or NULL for a family of one
+  const char * value;   //Label value; NULL for commands, which use command_name()
+};
+
+static const histogram_info histograms[HISTOGRAM_COUNT] = {
+  { "spreadsheet_command_duration_seconds", "Time to handle a command, from parsing to queueing its replies", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_command_duration_seconds", "", "command", NULL },
+  { "spreadsheet_lock_wait_seconds", "Time spent waiting to take a lock", "lock", "sheet" },
+  { "spreadsheet_lock_wait_seconds", "", "lock", "registry" },
+  { "spreadsheet_lock_hold_seconds", "Time a lock was held", "lock", "sheet" },
+  { "spreadsheet_lock_hold_seconds", "", "lock", "registry" },
+  { "spreadsheet_flush_duration_seconds", "Time to append a round of edits to the logs", NULL, NULL },
+  { "spreadsheet_compaction_duration_seconds", "Time to copy a spreadsheet and rewrite its snapshot", NULL, NULL },
+  { "spreadsheet_sheet_load_duration_seconds", "Time to recover a saved spreadsheet from disk", NULL, NULL },
+};
+
+static const char * counter_names[COUNTER_COUNT] = {
+  "spreadsheet_connections_total",
+  "spreadsheet_received_bytes_total",
+  "spreadsheet_received_lines_total",
+  "spreadsheet_sent_bytes_total",
+  "spreadsheet_flushed_records_total",
+};
+
+static const char * counter_helps[COUNTER_COUNT] = {
+  "Connections accepted",
+  "Bytes read from clients",
+  "Command lines received",
+  "Bytes written to clients",
+  "Cell changes appended to the logs",
+};
+
+/* Function: first_of_family
+ * Params: one of the HISTOGRAM_* ids
+ * Return: true if it starts its family's block. A family's histograms are numbered
+ *         together, since Prometheus wants each family's lines in one block.
+ */
+static bool first_of_family(int histogram)
+{
+  return histogram == 0 || strcmp(histograms[histogram - 1].family, histograms[histogram].family) != 0;
+}
+
+/* Function: label_prefix
+ * Params: one of the HISTOGRAM_* ids
+ * Return: "{" followed by the histogram's label and a comma if it has one, ready for
+ *         one more label
+ */
+static std::string label_prefix(int histogram)
+{
+  const histogram_info & info = histograms[histogram];
+  std::string prefix = "{";
+  if (info.label != NULL)
+    prefix = prefix + info.label + "=\"" + (info.value != NULL ? info.value : command_name(histogram - HISTOGRAM_COMMAND)) + "\",";
+  return prefix;
+}
+
+/* Function: add
+ * Params: a counter of the calling thread's shard, amount
+ * Return: void
+ *
+ * Description: Only the shard's thread writes to it, so a load and a store do
+ *              what an atomic add would, without locking the cache line
+ */
+static inline void add(std::atomic<unsigned long long> & to, unsigned long long n)
+{
+  to.store(to.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/* Function: instrumented_mutex constructor
+ * Params: histograms to record waits and holds in
+ * Return: void
+ */
+instrumented_mutex::instrumented_mutex(int wait_histogram, int hold_histogram)
+{
+  this->locked_at_ns = 0;
+  this->wait_histogram = wait_histogram;
+  this->hold_histogram = hold_histogram;
+}
+
+/* Function: lock
+ * Params: none
+ * Return: void
+ *
+ * Description: Locks the mutex. An uncontended lock reads the clock once and
+ *              records a wait of 0.
+ */
+void instrumented_mutex::lock()
+{
+  long long waited = 0;
+  if (!m.try_lock())
+  {
+    long long start = metrics::now_ns();
+    m.lock();
+    locked_at_ns = metrics::now_ns();
+    waited = locked_at_ns - start;
+  }
+  else
+    locked_at_ns = metrics::now_ns();
+  metrics::record(wait_histogram, waited);
+}
+
+/* Function: unlock
+ * Params: none
+ * Return: void
+ *
+ * Description: Unlocks the mutex, recording how long it was held once it is free
+ */
+void instrumented_mutex::unlock()
+{
+  long long held = metrics::now_ns() - locked_at_ns;
+  m.unlock();
+  metrics::record(hold_histogram, held);
+}
+
+/* Function: shard constructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Starts every count at 0
+ */
+metrics::shard::shard()
+{
+  for (int i = 0; i < COUNTER_COUNT; i++)
+    counters[i].store(0, std::memory_order_relaxed);
+  for (int i = 0; i < HISTOGRAM_COUNT; i++)
+  {
+    sums[i].store(0, std::memory_order_relaxed);
+    for (int j = 0; j < HISTOGRAM_BUCKETS; j++)
+      buckets[i][j].store(0, std::memory_order_relaxed);
+  }
+}
+
+/* Function: now_ns
+ * Params: none
+ * Return: nanoseconds on a monotonic clock
+ */
+long long metrics::now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Function: count
+ * Params: one of the COUNTER_* ids, amount to add
+ * Return: void
+ */
+void metrics::count(int counter, long long n)
+{
+  add(local_shard()->counters[counter], n);
+}
+
+/* Function: record
+ * Params: one of the HISTOGRAM_* ids, duration in nanoseconds
+ * Return: void
+ */
+void metrics::record(int histogram, long long ns)
+{
+  if (ns < 0)
+    ns = 0;
+  shard * s = local_shard();
+  add(s->buckets[histogram][bucket_of(ns)], 1);
+  add(s->sums[histogram], ns);
+}
+
+/* Function: local_shard
+ * Params: none
+ * Return: the calling thread's shard
+ */
+metrics::shard * metrics::local_shard()
+{
+  static __thread shard * mine = NULL;
+  if (mine == NULL)
+  {
+    mine = new shard();
+    std::lock_guard<std::mutex> guard(shards_lock);
+    shards.push_back(mine);
+  }
+  return mine;
+}
+
+/* Function: bucket_of
+ * Params: value
+ * Return: its bucket
+ *
+ * Description: The first 2^HISTOGRAM_SUB_BITS buckets hold one value each. Past
+ *              them, the bucket is picked by the value's highest bit and the
+ *              HISTOGRAM_SUB_BITS bits below it.
+ */
+int metrics::bucket_of(unsigned long long ns)
+{
+  const unsigned long long sub_buckets = 1ULL << HISTOGRAM_SUB_BITS;
+  if (ns < sub_buckets)
+    return (int)ns;
+  if (ns >= 1ULL << HISTOGRAM_MAX_BITS)
+    ns = 1ULL << HISTOGRAM_MAX_BITS;
+
+  int highest = 63 - __builtin_clzll(ns);
+  int shift = highest - HISTOGRAM_SUB_BITS;
+  return (shift + 1) * sub_buckets + (int)((ns >> shift) - sub_buckets);
+}
+
+/* Function: bucket_floor
+ * Params: bucket
+ * Return: the least value it holds
+ */
+unsigned long long metrics::bucket_floor(int bucket)
+{
+  const int sub_buckets = 1 << HISTOGRAM_SUB_BITS;
+  if (bucket < sub_buckets)
+    return bucket;
+  int shift = bucket / sub_buckets - 1;
+  return (unsigned long long)(sub_buckets + bucket % sub_buckets) << shift;
+}
+
+/* Function: start
+ * Params: admin port (0 for none), function appending the caller's own metrics to every scrape (or NULL)
+ * Return: void
+ *
+ * Description: Listens on 127.0.0.1 only, so scrapes come from the host or a local
+ *              agent. If the port can't be bound the error is logged and the
+ *              metrics are still dumped.
+ */
+void metrics::start(int port, metrics_collector collector)
+{
+  metrics::collector = collector;
+
+  int listen_socket = -1;
+  if (port > 0)
+  {
+    listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuseaddr = 1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listen_socket == -1 ||
+        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuseaddr, sizeof reuseaddr) == -1 ||
+        bind(listen_socket, (struct sockaddr*)&address, sizeof address) == -1 ||
+        listen(listen_socket, 16) == -1)
+    {
+      logger::error("metrics port");
+      if (listen_socket != -1)
+        close(listen_socket);
+      listen_socket = -1;
+    }
+    else
+    {
+      log_fields fields;
+      logger::log(LOG_INFO, fields, "serving metrics on 127.0.0.1:%d/metrics", port);
+    }
+  }
+
+  if (listen_socket == -1 && METRICS_DUMP_INTERVAL_MS <= 0)
+    return;
+  stopping = false;
+  admin = std::thread(run, listen_socket);
+}
+
+/* Function: stop
+ * Params: none
+ * Return: void
+ *
+ * Description: Joins the admin thread, which writes one last dump on the way out
+ */
+void metrics::stop()
+{
+  if (!admin.joinable())
+    return;
+  stopping = true;
+  admin.join();
+}
+
+/* Function: run
+ * Params: listening socket of the admin port, or -1
+ * Return: void
+ *
+ * Description: The admin thread. Answers scrapes one at a time; they are rare and
+ *              small, so nothing else is worth a thread of its own.
+ */
+void metrics::run(int listen_socket)
+{
+  long long next_dump_ns = now_ns() + METRICS_DUMP_INTERVAL_MS * 1000000LL;
+  while (!stopping)
+  {
+    struct pollfd listening;
+    listening.fd = listen_socket;
+    listening.events = POLLIN;
+    listening.revents = 0;
+    int ready = poll(&listening, 1, METRICS_POLL_MS);
+
+    if (ready > 0 && (listening.revents & POLLIN))
+    {
+      int client = accept4(listen_socket, NULL, NULL, SOCK_CLOEXEC);
+      if (client != -1)
+      {
+        serve(client);
+        close(client);
+      }
+    }
+
+    if (METRICS_DUMP_INTERVAL_MS > 0 && now_ns() >= next_dump_ns)
+    {
+      dump();
+      next_dump_ns = now_ns() + METRICS_DUMP_INTERVAL_MS * 1000000LL;
+    }
+  }
+
+  if (METRICS_DUMP_INTERVAL_MS > 0)
+    dump();
+  if (listen_socket != -1)
+    close(listen_socket);
+}
+
+/* Function: serve
+ * Params: accepted socket
+ * Return: void
+ *
+ * Description: Reads an HTTP request and answers GET /metrics (or /) with the
+ *              metrics and anything else with 404. A client that doesn't send a
+ *              whole request within a second is answered as it is.
+ */
+void metrics::serve(int client)
+{
+  struct timeval timeout;
+  timeout.tv_sec = 1;
+  timeout.tv_usec = 0;
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+  char request[METRICS_REQUEST_MAX + 1];
+  size_t length = 0;
+  while (length < METRICS_REQUEST_MAX)
+  {
+    ssize_t received = recv(client, request + length, METRICS_REQUEST_MAX - length, 0);
+    if (received <= 0)
+      break;
+    length += received;
+    request[length] = '\0';
+    if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL)
+      break;
+  }
+  request[length] = '\0';
+
+  std::string body;
+  const char * status = "404 Not Found";
+  if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0 ||
+      strncmp(request, "GET /metrics?", 13) == 0)
+  {
+    status = "200 OK";
+    render(body);
+  }
+  else
+    body = "not found\n";
+
+  char header[256];
+  int header_length = snprintf(header, sizeof header,
+                               "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+                               status, (unsigned long)body.size());
+  std::string response(header, header_length);
+  response += body;
+
+  size_t sent = 0;
+  while (sent < response.size())
+  {
+    ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (written == -1 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    sent += written;
+  }
+}
+
+/* Function: dump
+ * Params: none
+ * Return: void
+ *
+ * Description: Writes the metrics to a temporary file renamed over METRICS_DUMP_FILE,
+ *              so readers never see half a dump
+ */
+void metrics::dump()
+{
+  std::string text;
+  render(text);
+
+  std::string temporary = std::string(METRICS_DUMP_FILE) + ".tmp";
+  FILE * file = fopen(temporary.c_str(), "w");
+  if (file == NULL)
+  {
+    logger::error("metrics dump");
+    return;
+  }
+  bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+  if (fclose(file) != 0 || !written || rename(temporary.c_str(), METRICS_DUMP_FILE) != 0)
+    logger::error("metrics dump");
+}
+
+/* Function: append_value
+ * Params: scrape, metric name, its type ("gauge" or "counter"), help line, value
+ * Return: void
+ */
+void metrics::append_value(std::string & out, const char * name, const char * type, const char * help, double value)
+{
+  char line[512];
+  snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+  out += line;
+}
+
+/* Function: render
+ * Params: string to append to
+ * Return: void
+ *
+ * Description: Adds up every thread's shard and appends the counters, then each
+ *              histogram as a Prometheus histogram with a bucket per power of
+ *              two (which fall on bucket edges here, so they are exact) along
+ *              with its p50, p99 and p999 at full resolution as gauges, then
+ *              whatever the collector appends. Durations are in seconds.
+ */
+void metrics::render(std::string & out)
+{
+  std::vector<unsigned long long> counters(COUNTER_COUNT, 0);
+  std::vector<unsigned long long> sums(HISTOGRAM_COUNT, 0);
+  std::vector<unsigned long long> buckets(HISTOGRAM_COUNT * HISTOGRAM_BUCKETS, 0);
+  std::vector<unsigned long long> totals(HISTOGRAM_COUNT, 0);
+  {
+    std::lock_guard<std::mutex> guard(shards_lock);
+    for (size_t s = 0; s < shards.size(); s++)
+    {
+      for (int i = 0; i < COUNTER_COUNT; i++)
+        counters[i] += shards[s]->counters[i].load(std::memory_order_relaxed);
+      for (int i = 0; i < HISTOGRAM_COUNT; i++)
+      {
+        sums[i] += shards[s]->sums[i].load(std::memory_order_relaxed);
+        for (int j = 0; j < HISTOGRAM_BUCKETS; j++)
+          buckets[i * HISTOGRAM_BUCKETS + j] += shards[s]->buckets[i][j].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  char line[512];
+  for (int i = 0; i < COUNTER_COUNT; i++)
+    append_value(out, counter_names[i], "counter", counter_helps[i], (double)counters[i]);
+
+  for (int i = 0; i < HISTOGRAM_COUNT; i++)
+  {
+    const histogram_info & info = histograms[i];
+    if (first_of_family(i))
+    {
+      snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s histogram\n", info.family, info.help, info.family);
+      out += line;
+    }
+
+    std::string prefix = label_prefix(i);
+    std::string labels = prefix.size() > 1 ? prefix.substr(0, prefix.size() - 1) + "}" : "";
+    const unsigned long long * counts = &buckets[i * HISTOGRAM_BUCKETS];
+    totals[i] = 0;
+    for (int j = 0; j < HISTOGRAM_BUCKETS; j++)
+      totals[i] += counts[j];
+    unsigned long long total = totals[i];
+
+    // Values under 2^bits are exactly those in the buckets before 2^bits' own
+    unsigned long long cumulative = 0;
+    int next = 0;
+    for (int bits = METRICS_LOW_BUCKET_BITS; bits <= METRICS_HIGH_BUCKET_BITS; bits++)
+    {
+      int edge = bucket_of(1ULL << bits);
+      for (; next < edge; next++)
+        cumulative += counts[next];
+      snprintf(line, sizeof line, "%s_bucket%sle=\"%.12g\"} %llu\n", info.family, prefix.c_str(), (double)(1ULL << bits) / 1e9, cumulative);
+      out += line;
+    }
+    snprintf(line, sizeof line, "%s_bucket%sle=\"+Inf\"} %llu\n%s_sum%s %.9f\n%s_count%s %llu\n",
+             info.family, prefix.c_str(), total, info.family, labels.c_str(), (double)sums[i] / 1e9,
+             info.family, labels.c_str(), total);
+    out += line;
+  }
+
+  // Quantiles, reported as the highest value of the bucket they fall in
+  static const double quantiles[] = { 0.5, 0.99, 0.999 };
+  for (int i = 0; i < HISTOGRAM_COUNT; i++)
+  {
+    const histogram_info & info = histograms[i];
+    std::string family(info.family);
+    family = family.substr(0, family.size() - strlen("_seconds")) + "_quantile_seconds";
+    if (first_of_family(i))
+    {
+      snprintf(line, sizeof line, "# HELP %s Quantiles of %s since startup\n# TYPE %s gauge\n", family.c_str(), info.family, family.c_str());
+      out += line;
+    }
+
+    std::string prefix = label_prefix(i);
+    const unsigned long long * counts = &buckets[i * HISTOGRAM_BUCKETS];
+    unsigned long long total = totals[i];
+
+    for (size_t q = 0; q < sizeof quantiles / sizeof quantiles[0]; q++)
+    {
+      double value = 0;
+      if (total > 0)
+      {
+        unsigned long long rank = (unsigned long long)(quantiles[q] * total + 0.999999);
+        if (rank == 0)
+          rank = 1;
+        unsigned long long cumulative = 0;
+        int j = 0;
+        for (; j < HISTOGRAM_BUCKETS - 1; j++)
+        {
+          cumulative += counts[j];
+          if (cumulative >= rank)
+            break;
+        }
+        value = (double)(bucket_floor(j + 1) - 1) / 1e9;
+      }
+      snprintf(line, sizeof line, "%s%squantile=\"%g\"} %.9g\n", family.c_str(), prefix.c_str(), quantiles[q], value);
+      out += line;
+    }
+  }
+
+  if (collector != NULL)
+    collector(out);
+}
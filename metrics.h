@@ -0,0 +1,153 @@
+/*
+ * Filename: metrics.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "client_command.h"
+
+// Metrics limits and outputs (override with -D at compile time)
+#ifndef METRICS_PORT
+#define METRICS_PORT 2001                  // Local admin port serving /metrics (0 for none)
+#endif
+#ifndef METRICS_DUMP_INTERVAL_MS
+#define METRICS_DUMP_INTERVAL_MS 60000     // How often the metrics are written to METRICS_DUMP_FILE (0 for never)
+#endif
+#ifndef METRICS_DUMP_FILE
+#define METRICS_DUMP_FILE "metrics.prom"
+#endif
+
+// Counters
+#define COUNTER_CONNECTIONS     0 // Connections accepted
+#define COUNTER_BYTES_RECEIVED  1 // Bytes read from clients
+#define COUNTER_LINES_RECEIVED  2 // Command lines framed
+#define COUNTER_BYTES_SENT      3 // Bytes written to clients
+#define COUNTER_RECORDS_FLUSHED 4 // Cell changes appended to logs
+#define COUNTER_COUNT           5
+
+// Latency histograms (those exported as one metric family are numbered together)
+#define HISTOGRAM_COMMAND            0  // Plus a COMMAND_* kind: service time of each command
+#define HISTOGRAM_SHEET_LOCK_WAIT    (HISTOGRAM_COMMAND + COMMAND_COUNT)
+#define HISTOGRAM_REGISTRY_LOCK_WAIT (HISTOGRAM_SHEET_LOCK_WAIT + 1)
+#define HISTOGRAM_SHEET_LOCK_HOLD    (HISTOGRAM_SHEET_LOCK_WAIT + 2)
+#define HISTOGRAM_REGISTRY_LOCK_HOLD (HISTOGRAM_SHEET_LOCK_WAIT + 3)
+#define HISTOGRAM_FLUSH              (HISTOGRAM_SHEET_LOCK_WAIT + 4) // A flush round that wrote something
+#define HISTOGRAM_COMPACTION         (HISTOGRAM_SHEET_LOCK_WAIT + 5) // Copying a sheet and rewriting its snapshot
+#define HISTOGRAM_SHEET_LOAD         (HISTOGRAM_SHEET_LOCK_WAIT + 6) // Recovering a saved sheet from disk
+#define HISTOGRAM_COUNT              (HISTOGRAM_SHEET_LOCK_WAIT + 7)
+
+// Buckets: values under 2^HISTOGRAM_SUB_BITS nanoseconds are exact; above, each power of
+// two is split in 2^HISTOGRAM_SUB_BITS, so a bucket is within 1/16 of its values
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_MAX_BITS 40     // Values from 2^40 ns (18 minutes) up share the last bucket
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) << HISTOGRAM_SUB_BITS)
+
+// Appends a server's own gauges and counters, in Prometheus text format, to a scrape
+typedef void (*metrics_collector)(std::string & out);
+
+/* Class: instrumented_mutex
+ *
+ * Description: Mutex that records how long each lock() waited and how long the
+ *              lock was then held, in two latency histograms. Works with
+ *              std::lock_guard like std::mutex.
+ *
+ * Public Functions:
+ *   constructor:  sets the histograms to record to
+ *   lock:         locks, recording the wait
+ *   unlock:       records the hold and unlocks
+ */
+class instrumented_mutex
+{
+ public:
+  instrumented_mutex(int wait_histogram, int hold_histogram);
+  void lock();
+  void unlock();
+
+ private:
+  instrumented_mutex(const instrumented_mutex &);            //Not copyable
+  instrumented_mutex & operator=(const instrumented_mutex &);
+  std::mutex m;
+  long long locked_at_ns;   //Written only by the holder
+  int wait_histogram;
+  int hold_histogram;
+};
+
+/* Class: metrics
+ *
+ * Description: Process-wide counters and latency histograms. Each thread records
+ *              into its own shard, created the first time it records anything,
+ *              with plain loads and stores; no lock or atomic read-modify-write
+ *              is taken on the hot path, and threads never share a cache line.
+ *              Histograms are HDR-style: log-linear buckets keep every value to
+ *              within 1/16 from nanoseconds to minutes. Readers add the shards up.
+ *              A background thread serves the totals in Prometheus text format
+ *              on a local admin port (GET /metrics) and writes them to
+ *              METRICS_DUMP_FILE every METRICS_DUMP_INTERVAL_MS, ready for a
+ *              textfile collector.
+ *
+ * Public Functions:
+ *   now_ns:       returns nanoseconds on a monotonic clock
+ *   count:        adds to a counter
+ *   record:       adds a duration to a histogram
+ *   start:        launches the admin thread
+ *   stop:         joins it, writing one last dump
+ *   render:       writes every metric in Prometheus text format
+ *   append_value: appends one sample of a server's own metric to a scrape
+ *
+ * Private Functions:
+ *   local_shard:  returns the calling thread's shard, creating it if needed
+ *   bucket_of:    returns the bucket of a value
+ *   bucket_floor: returns the least value of a bucket
+ *   run:          the admin thread: serves scrapes and writes dumps
+ *   serve:        answers one scrape on an accepted socket
+ *   dump:         writes METRICS_DUMP_FILE
+ */
+class metrics
+{
+  /* Class: shard
+   *
+   * Description: One thread's counts. Only that thread writes them.
+   */
+  class shard
+  {
+  public:
+    shard();
+    std::atomic<unsigned long long> counters[COUNTER_COUNT];
+    std::atomic<unsigned long long> sums[HISTOGRAM_COUNT];   //Nanoseconds recorded
+    std::atomic<unsigned long long> buckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKETS];
+  };
+
+ public:
+  static long long now_ns();
+  static void count(int counter, long long n);
+  static void record(int histogram, long long ns);
+  static void start(int port, metrics_collector collector);
+  static void stop();
+  static void render(std::string & out);
+  static void append_value(std::string & out, const char * name, const char * type, const char * help, double value);
+
+ private:
+  static shard * local_shard();
+  static int bucket_of(unsigned long long ns);
+  static unsigned long long bucket_floor(int bucket);
+  static void run(int listen_socket);
+  static void serve(int client);
+  static void dump();
+
+  static std::vector<shard*> shards;     //Every thread's shard; never freed, so totals survive their threads
+  static std::mutex shards_lock;
+  static metrics_collector collector;
+  static std::atomic<bool> stopping;
+  static std::thread admin;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Filename: outbound_ring.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "outbound_ring.h"
+
+#define INITIAL_SLOTS 16 // Slots allocated for a new ring
+
+/* Function: outbound_ring constructor
+ * Params: most messages the ring may hold
+ * Return: void
+ */
+outbound_ring::outbound_ring(size_t max_messages)
+{
+  this->max_messages = max_messages;
+  this->head = 0;
+  this->count = 0;
+  this->held_bytes = 0;
+}
+
+/* Function: push
+ * Params: message to add
+ * Return: true if the message was added, false if the ring is full
+ *
+ * Description: Adds the message at the back, doubling the slot array (and
+ *              moving the messages to the front of it) when it is out of room.
+ */
+bool outbound_ring::push(const shared_message & message)
+{
+  if (count == slots.size())
+  {
+    if (count >= max_messages)
+      return false;
+
+    size_t new_size = slots.empty() ? INITIAL_SLOTS : slots.size() * 2;
+    if (new_size > max_messages)
+      new_size = max_messages;
+
+    std::vector<shared_message> grown(new_size);
+    for (size_t i = 0; i < count; i++)
+      grown[i].swap(slots[(head + i) % slots.size()]);
+    slots.swap(grown);
+    head = 0;
+  }
+
+  held_bytes += message->size();
+  slots[(head + count) % slots.size()] = message;
+  count++;
+  return true;
+}
+
+/* Function: at
+ * Params: position from the front (must be less than size())
+ * Return: the message at that position
+ */
+const std::string & outbound_ring::at(size_t i)
+{
+  return *slots[(head + i) % slots.size()];
+}
+
+/* Function: pop
+ * Params: none
+ * Return: the front message, which has been removed (the ring must not be empty)
+ */
+shared_message outbound_ring::pop()
+{
+  shared_message message;
+  message.swap(slots[head]);
+  held_bytes -= message->size();
+  head = (head + 1) % slots.size();
+  count--;
+  return message;
+}
+
+/* Function: clear
+ * Params: none
+ * Return: void
+ *
+ * Description: Drops every message and releases the slot array
+ */
+void outbound_ring::clear()
+{
+  std::vector<shared_message>().swap(slots);
+  head = 0;
+  count = 0;
+  held_bytes = 0;
+}
+
+/* Function: size
+ * Params: none
+ * Return: number of messages held
+ */
+size_t outbound_ring::size()
+{
+  return count;
+}
+
+/* Function: empty
+ * Params: none
+ * Return: true if no message is held
+ */
+bool outbound_ring::empty()
+{
+  return count == 0;
+}
+
+/* Function: bytes
+ * Params: none
+ * Return: total bytes of the messages held
+ */
+size_t outbound_ring::bytes()
+{
+  return held_bytes;
+}
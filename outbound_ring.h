@@ -0,0 +1,57 @@
+/*
+ * Filename: outbound_ring.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef OUTBOUND_RING_H
+#define OUTBOUND_RING_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// A message shared by every queue it was sent to; never modified once queued.
+typedef std::shared_ptr<const std::string> shared_message;
+
+/* Class: outbound_ring
+ *
+ * Description: Bounded FIFO ring of messages waiting to be written to one
+ *              socket. The slot array starts small and doubles as needed, but
+ *              never past max_messages; push fails once the ring is full.
+ *              Keeps a running total of the bytes it holds. Messages are
+ *              shared, so a broadcast sits in every subscriber's ring as
+ *              one buffer.
+ *
+ * Public Functions:
+ *   constructor:   sets the most messages the ring may hold
+ *   push:          adds a message at the back, unless the ring is full
+ *   at:            returns the i-th message from the front
+ *   pop:           removes the front message and returns it for reuse
+ *   clear:         drops every message
+ *   size:          number of messages held
+ *   empty:         tells if no message is held
+ *   bytes:         total bytes of the messages held
+ */
+class outbound_ring
+{
+ public:
+  outbound_ring(size_t max_messages);
+  bool push(const shared_message & message);
+  const std::string & at(size_t i);
+  shared_message pop();
+  void clear();
+  size_t size();
+  bool empty();
+  size_t bytes();
+
+ private:
+  std::vector<shared_message> slots;
+  size_t head;          //Slot of the front message
+  size_t count;         //Messages held
+  size_t max_messages;
+  size_t held_bytes;
+};
+
+#endif
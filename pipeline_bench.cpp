@@ -0,0 +1,218 @@
+/*
+ * Filename: pipeline_bench.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Times the reactors' read path under heavily pipelined clients. Starts
+ *   one reactor per core on a local port, as the server does, with a line handler that
+ *   only counts and checks lines, so nothing but reading and line framing is measured.
+ *   Each client connects and sends every one of its lines back to back in large writes,
+ *   never waiting for a reply. Every seventh line (by default) carries a '\0' byte,
+ *   which must reach the handler like any other. Reports the best of several rounds in lines and megabytes
+ *   per second, and how many lines reached the handler cut short or mangled.
+ *
+ *   Usage: pipeline_bench [clients] [lines per client] [line length] [rounds] [nul every]
+ */
+
+#include <algorithm> // max()
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h> // perror error message printing
+#include <stdlib.h> // atoi
+#include <string.h> // memcmp
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "reactor.h"
+
+#define WRITE_SIZE 65536 // Bytes each client hands to send() at a time
+
+static std::atomic<long long> lines_seen(0);
+static std::atomic<long long> bytes_seen(0);
+static std::atomic<long long> bad_lines(0);
+static size_t line_length;
+static long long nul_every;  //Every this many lines carries a '\0' byte (0 for none)
+
+/* Function: now_ms
+ * Params: none
+ * Return: milliseconds on a monotonic clock, with fractions
+ */
+static double now_ms()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: make_line
+ * Params: line number, string to store the line in (with its '\n')
+ * Return: void
+ *
+ * Description: Builds a cell command exactly line_length bytes long before its '\n'
+ */
+static void make_line(long long n, std::string & line)
+{
+  char head[32];
+  int head_length = snprintf(head, sizeof head, "cell A%lld ", n % 1000 + 1);
+  line.assign(head, head_length);
+  line.resize(std::max(line_length, (size_t)head_length), 'x');
+  if (nul_every > 0 && n % nul_every == 0)
+    line[line.size() - 1] = '\0';
+  line += '\n';
+}
+
+/* Function: lines_received
+ * Params: socket, lines framed from it, how many
+ * Return: void
+ *
+ * Description: Counts the lines, and counts each as bad unless it arrived whole
+ */
+static void lines_received(int, const text_view * lines, size_t count)
+{
+  lines_seen += count;
+  for (size_t i = 0; i < count; i++)
+  {
+    const text_view & line = lines[i];
+    bytes_seen += line.length + 1;
+    if (line.length != line_length || memcmp(line.data, "cell A", 6) != 0 || line.data[line.length - 2] != 'x')
+      bad_lines++;
+  }
+}
+
+/* Function: client_disconnected
+ * Params: socket that closed
+ * Return: void
+ */
+static void client_disconnected(int)
+{
+}
+
+/* Function: run_client
+ * Params: port to connect to, number of lines to send
+ * Return: void
+ *
+ * Description: Sends every line back to back, WRITE_SIZE bytes at a time, then
+ *              waits for the server to see the connection close
+ */
+static void run_client(int port, long long lines)
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(sock, (struct sockaddr *)&address, sizeof address) == -1)
+  {
+    perror("pipeline_bench connect");
+    close(sock);
+    return;
+  }
+
+  std::string pending, line;
+  for (long long n = 0; n < lines; n++)
+  {
+    make_line(n, line);
+    pending += line;
+    if (pending.size() >= WRITE_SIZE || n + 1 == lines)
+    {
+      size_t sent = 0;
+      while (sent < pending.size())
+      {
+        ssize_t count = send(sock, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL);
+        if (count == -1)
+        {
+          perror("pipeline_bench send");
+          close(sock);
+          return;
+        }
+        sent += count;
+      }
+      pending.clear();
+    }
+  }
+
+  shutdown(sock, SHUT_WR);
+  char ignored[64];
+  while (recv(sock, ignored, sizeof ignored, 0) > 0)
+    ;
+  close(sock);
+}
+
+/* Function: main
+ * Params: number of arguments, string arguments
+ * Return: 0 if every line arrived whole, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  int clients = argc > 1 ? atoi(argv[1]) : 16;
+  long long lines = argc > 2 ? atoll(argv[2]) : 200000;
+  line_length = argc > 3 ? atoi(argv[3]) : 24;
+  int rounds = argc > 4 ? atoi(argv[4]) : 3;
+  nul_every = argc > 5 ? atoll(argv[5]) : 7;
+  if (clients < 1 || lines < 1 || line_length < 12 || rounds < 1 || nul_every < 0)
+  {
+    fprintf(stderr, "Usage: pipeline_bench [clients] [lines per client] [line length >= 12] [rounds] [nul every]\n");
+    return 1;
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_length = sizeof address;
+  if (bind(listener, (struct sockaddr *)&address, sizeof address) == -1 || listen(listener, 128) == -1 ||
+      getsockname(listener, (struct sockaddr *)&address, &address_length) == -1 ||
+      fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK) == -1)
+  {
+    perror("pipeline_bench listen");
+    return 1;
+  }
+  int port = ntohs(address.sin_port);
+
+  unsigned int reactor_count = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<reactor*> reactors;
+  for (unsigned int i = 0; i < reactor_count; i++)
+  {
+    reactors.push_back(new reactor(listener, lines_received, client_disconnected));
+    reactors.back()->start();
+  }
+
+  double best_ms = 1e300;
+  long long total = (long long)clients * lines;
+  for (int round = 0; round < rounds; round++)
+  {
+    lines_seen = 0;
+    bytes_seen = 0;
+    double start = now_ms();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++)
+      threads.push_back(std::thread(run_client, port, lines));
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+    best_ms = std::min(best_ms, now_ms() - start);
+    if (lines_seen != total)
+      bad_lines += total - lines_seen;
+  }
+
+  for (size_t i = 0; i < reactors.size(); i++)
+    reactors[i]->stop();
+  for (size_t i = 0; i < reactors.size(); i++)
+  {
+    reactors[i]->join();
+    delete reactors[i];
+  }
+  close(listener);
+
+  double megabytes = (double)total * (line_length + 1) / (1 << 20);
+  printf("%d clients x %lld lines of %zu bytes, %u reactors, best of %d rounds\n", clients, lines, line_length,
+         reactor_count, rounds);
+  printf("%.1f ms, %.0f lines/s, %.1f MB/s, %lld lines cut short or lost\n", best_ms, total / best_ms * 1000,
+         megabytes / best_ms * 1000, bad_lines.load());
+  return bad_lines == 0 ? 0 : 1;
+}
@@ -0,0 +1,777 @@
+/*
+ * Filename: reactor.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "reactor.h"
+#include <arpa/inet.h> // inet_ntoa
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h> // writev
+#include <unistd.h>
+#include "logger.h"
+#include "metrics.h"
+
+#define MAX_EVENTS 256 // Events handled per epoll_wait() call
+#define MAX_IOVECS 64  // Queued messages written per writev() call
+#define BUFFER_POOL_SIZE 64 // Large buffers kept for reuse by take_buffer()
+#define TICK_MS 1000   // How often each reactor checks its clients for stalled queues
+
+std::map<int, std::shared_ptr<reactor::connection> > reactor::all_clients;
+std::mutex reactor::all_clients_lock;
+std::vector<std::string> reactor::buffer_pool;
+std::mutex reactor::buffer_pool_lock;
+std::atomic<long long> reactor::evictions(0);
+
+/* Function: now_ms
+ * Params: none
+ * Return: milliseconds on a monotonic clock
+ */
+static long long now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: connection constructor
+ * Params: socket the connection wraps
+ * Return: void
+ *
+ * Description: Creates an open connection with empty buffers
+ */
+reactor::connection::connection(int socket_id) : outbound(OUTBOUND_MAX_MESSAGES)
+{
+  this->socket_id = socket_id;
+  this->closed = false;
+  this->evicted = false;
+  this->paused = false;
+  this->front_offset = 0;
+  this->last_progress_ms = now_ms();
+  this->peak_queued_bytes = 0;
+  this->bytes_sent = 0;
+}
+
+/* Function: reactor constructor
+ * Params: non-blocking listening socket, line and disconnect callbacks
+ * Return: void
+ *
+ * Description: Creates the epoll instance and registers the listening socket with it.
+ *              EPOLLEXCLUSIVE keeps a new connection from waking every reactor at once.
+ */
+reactor::reactor(int listen_socket, line_handler on_line, disconnect_handler on_disconnect)
+{
+  this->listen_socket = listen_socket;
+  this->on_line = on_line;
+  this->on_disconnect = on_disconnect;
+  this->stopping = false;
+
+  wake_id = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  epoll_id = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_id == -1 || wake_id == -1)
+  {
+    logger::error("epoll_create1");
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+  ev.data.ptr = NULL; // NULL marks the listening socket
+  if (epoll_ctl(epoll_id, EPOLL_CTL_ADD, listen_socket, &ev) == -1)
+    logger::error("epoll_ctl(listen)");
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = &wake_id; // Marks the wake-up eventfd
+  if (epoll_ctl(epoll_id, EPOLL_CTL_ADD, wake_id, &ev) == -1)
+    logger::error("epoll_ctl(wake)");
+}
+
+/* Function: reactor destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Closes the epoll instance
+ */
+reactor::~reactor()
+{
+  if (epoll_id != -1)
+    close(epoll_id);
+  if (wake_id != -1)
+    close(wake_id);
+}
+
+/* Function: start
+ * Params: none
+ * Return: void
+ *
+ * Description: Runs the event loop on a new thread
+ */
+void reactor::start()
+{
+  loop_thread = std::thread(&reactor::run, this);
+}
+
+/* Function: stop
+ * Params: none
+ * Return: void
+ *
+ * Description: Asks the event loop to exit once it finishes the events in hand.
+ *              No line is dispatched after the loop notices, so once join()
+ *              returns this reactor will not touch any spreadsheet again.
+ */
+void reactor::stop()
+{
+  stopping = true;
+  uint64_t one = 1;
+  if (write(wake_id, &one, sizeof one) == -1)
+    logger::error("reactor stop");
+}
+
+/* Function: join
+ * Params: none
+ * Return: void
+ *
+ * Description: Blocks until the event loop thread exits
+ */
+void reactor::join()
+{
+  if (loop_thread.joinable())
+    loop_thread.join();
+}
+
+/* Function: run
+ * Params: none
+ * Return: void
+ *
+ * Description: Waits for socket events and services them. Client sockets are
+ *              registered edge-triggered for both directions, so every event
+ *              must be drained until the socket reports EAGAIN. A paused client
+ *              is read again as soon as a write drains its queue.
+ */
+void reactor::run()
+{
+  struct epoll_event events[MAX_EVENTS];
+  long long next_tick = now_ms() + TICK_MS;
+
+  while (!stopping)
+  {
+    int timeout = next_tick - now_ms();
+    int count = epoll_wait(epoll_id, events, MAX_EVENTS, timeout > 0 ? timeout : 0);
+    if (count == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      logger::error("epoll_wait");
+      return;
+    }
+
+    for (int i = 0; i < count && !stopping; i++)
+    {
+      if (events[i].data.ptr == &wake_id)
+        continue;
+
+      connection * c = (connection *)events[i].data.ptr;
+      if (c == NULL)
+      {
+        accept_clients();
+        continue;
+      }
+
+      bool resume = false;
+      if (events[i].events & EPOLLOUT)
+      {
+        bool was_paused = c->paused; // Only this reactor changes paused
+        flush_client(c);
+        resume = was_paused && !backlogged(c);
+      }
+
+      // Reading also notices hangups and errors (recv returns 0 or -1).
+      if (resume || (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+        read_client(c);
+    }
+
+    if (now_ms() >= next_tick)
+    {
+      tick();
+      next_tick = now_ms() + TICK_MS;
+    }
+  }
+}
+
+/* Function: tick
+ * Params: none
+ * Return: void
+ *
+ * Description: Evicts clients whose queue has made no progress for
+ *              SLOW_CONSUMER_TIMEOUT_MS, and resumes reading paused clients
+ *              whose queue has drained (in case no EPOLLOUT edge said so).
+ */
+void reactor::tick()
+{
+  std::vector<std::shared_ptr<connection> > resumed;
+  long long now = now_ms();
+
+  std::map<int, std::shared_ptr<connection> >::iterator it;
+  for (it = clients.begin(); it != clients.end(); it++)
+  {
+    connection * c = it->second.get();
+    {
+      std::lock_guard<std::mutex> guard(c->lock);
+      if (!c->outbound.empty() && now - c->last_progress_ms > SLOW_CONSUMER_TIMEOUT_MS)
+        evict_client(c, "no progress");
+    }
+
+    if (c->paused && !backlogged(c)) // Only this reactor changes paused
+      resumed.push_back(it->second);
+  }
+
+  // Reading may close clients, so it can't happen while walking the map.
+  for (size_t i = 0; i < resumed.size() && !stopping; i++)
+    read_client(resumed[i].get());
+}
+
+/* Function: accept_clients
+ * Params: none
+ * Return: void
+ *
+ * Description: Accepts every pending connection and registers it with this reactor
+ */
+void reactor::accept_clients()
+{
+  while (1)
+  {
+    struct sockaddr_in their_addr;
+    socklen_t size = sizeof(struct sockaddr_in);
+    int newsock = accept4(listen_socket, (struct sockaddr*)&their_addr, &size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (newsock == -1)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        logger::error("accept");
+      return;
+    }
+
+    log_fields fields;
+    fields.socket = newsock;
+    logger::log(LOG_INFO, fields, "accepted connection from %s:%d", inet_ntoa(their_addr.sin_addr), ntohs(their_addr.sin_port));
+
+    // Broadcasts are coalesced per batch of edits, so small writes are already rare;
+    // Nagle would only hold each one back until the client's delayed ACK.
+    int one = 1;
+    if (setsockopt(newsock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one) == -1)
+      logger::error("setsockopt(TCP_NODELAY)");
+
+    metrics::count(COUNTER_CONNECTIONS, 1);
+    std::shared_ptr<connection> c(new connection(newsock));
+    {
+      std::lock_guard<std::mutex> guard(all_clients_lock);
+      all_clients[newsock] = c;
+    }
+    clients[newsock] = c;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c.get();
+    if (epoll_ctl(epoll_id, EPOLL_CTL_ADD, newsock, &ev) == -1)
+    {
+      logger::error("epoll_ctl(client)");
+      close_client(c.get());
+    }
+  }
+}
+
+/* Function: read_client
+ * Params: connection that became readable (or was resumed)
+ * Return: void
+ *
+ * Description: Dispatches any lines left over from before the client was paused,
+ *              then receives until the socket would block, dispatching complete
+ *              lines as they arrive. Stops reading (leaving data in the socket so
+ *              TCP pushes back on the client) while the client is backlogged.
+ *              A client whose unfinished line grows past RECEIVE_MAX_LINE is
+ *              closed, so no client can make its buffer grow without bound.
+ */
+void reactor::read_client(connection * c)
+{
+  int newsock = c->socket_id;
+
+  if (!dispatch_lines(c))
+    return;
+
+  while (!stopping)
+  {
+    // Read straight into the connection's buffer, after what is still unframed.
+    char * incoming_data_buffer = c->inbound.reserve(INCOMING_BUFFER_SIZE);
+
+    ssize_t bytes_received = recv(newsock, incoming_data_buffer, c->inbound.space(), 0);
+
+    // If the client has shut down, clean up and stop reading.
+    if (bytes_received == 0)
+    {
+      close_client(c);
+      return;
+    }
+
+    if (bytes_received == -1)
+    {
+      // Drained everything the socket had for us; an idle client keeps no buffer.
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        c->inbound.release();
+        return;
+      }
+      if (errno == EINTR)
+        continue;
+
+      log_fields fields;
+      fields.socket = newsock;
+      fields.error = errno;
+      logger::log(LOG_ERROR, fields, "receive failed");
+      close_client(c);
+      return;
+    }
+
+    c->inbound.commit(bytes_received);
+    metrics::count(COUNTER_BYTES_RECEIVED, bytes_received);
+
+    if (!dispatch_lines(c))
+      return;
+
+    // Every complete line was taken, so what is left is one unfinished line.
+    if (c->inbound.pending() > RECEIVE_MAX_LINE)
+    {
+      log_fields fields;
+      fields.socket = newsock;
+      logger::log(LOG_WARN, fields, "closing client: line longer than %lu bytes", (unsigned long)RECEIVE_MAX_LINE);
+      close_client(c);
+      return;
+    }
+  }
+}
+
+/* Function: dispatch_lines
+ * Params: connection with buffered input
+ * Return: false if the client is backlogged (or the reactor is stopping), true otherwise
+ *
+ * Description: Takes complete lines (terminated by '\n') off the front of the
+ *              connection's buffer and passes them to the line handler in batches
+ *              of up to DISPATCH_MAX_LINES, checking before each batch that the
+ *              client isn't backlogged. The handler gets views of the lines without
+ *              their '\n', valid until it returns: the buffer is only moved or freed
+ *              by the next read.
+ */
+bool reactor::dispatch_lines(connection * c)
+{
+  text_view current_line;
+
+  while (!stopping)
+  {
+    if (backlogged(c))
+      return false;
+
+    batch.clear();
+    while (batch.size() < DISPATCH_MAX_LINES && c->inbound.next_line(current_line))
+      batch.push_back(current_line);
+
+    if (batch.empty())
+      return true;
+
+    metrics::count(COUNTER_LINES_RECEIVED, batch.size());
+    on_line(c->socket_id, &batch[0], batch.size());
+  }
+
+  return false;
+}
+
+/* Function: backlogged
+ * Params: connection to check
+ * Return: true if the client's commands should wait for its queue to drain
+ *
+ * Description: Pauses a client once its queue passes OUTBOUND_HIGH_WATER and
+ *              resumes it once the queue falls under OUTBOUND_LOW_WATER.
+ */
+bool reactor::backlogged(connection * c)
+{
+  std::lock_guard<std::mutex> guard(c->lock);
+  size_t queued = c->outbound.bytes() - c->front_offset;
+
+  if (c->paused)
+    c->paused = queued > OUTBOUND_LOW_WATER;
+  else
+    c->paused = queued > OUTBOUND_HIGH_WATER;
+
+  return c->paused;
+}
+
+/* Function: find_client
+ * Params: socket to look up
+ * Return: the socket's connection, or an empty pointer if it isn't connected
+ */
+std::shared_ptr<reactor::connection> reactor::find_client(int socket_id)
+{
+  std::lock_guard<std::mutex> guard(all_clients_lock);
+  std::map<int, std::shared_ptr<connection> >::iterator it = all_clients.find(socket_id);
+  if (it == all_clients.end())
+    return std::shared_ptr<connection>();
+  return it->second;
+}
+
+/* Function: send
+ * Params: socket to send to, message to send
+ * Return: 0 if the message was sent or queued, 1 otherwise
+ *
+ * Description: Writes directly to the socket when nothing is queued ahead of
+ *              the message. Whatever the socket won't take right now is copied
+ *              into the queue and written by the owning reactor once the socket
+ *              is writable.
+ */
+int reactor::send(int socket_id, const std::string & message)
+{
+  std::shared_ptr<connection> c = find_client(socket_id);
+  if (!c)
+    return 1;
+
+  std::lock_guard<std::mutex> guard(c->lock);
+  ssize_t offset = write_now(c.get(), message);
+  if (offset == -1)
+    return 1;
+
+  if ((size_t)offset < message.size())
+    return enqueue(c.get(), std::make_shared<const std::string>(message, offset));
+
+  return 0;
+}
+
+/* Function: send
+ * Params: socket to send to, shared message to send
+ * Return: 0 if the message was sent or queued, 1 otherwise
+ *
+ * Description: Same as above, but whatever the socket won't take is queued by
+ *              reference, so broadcasting one message to many sockets never
+ *              copies it.
+ */
+int reactor::send(int socket_id, const shared_message & message)
+{
+  std::shared_ptr<connection> c = find_client(socket_id);
+  if (!c)
+    return 1;
+
+  std::lock_guard<std::mutex> guard(c->lock);
+  ssize_t offset = write_now(c.get(), *message);
+  if (offset == -1)
+    return 1;
+
+  if ((size_t)offset < message->size())
+  {
+    if (enqueue(c.get(), message))
+      return 1;
+    if (offset > 0)
+      c->front_offset = offset; // The queue was empty, so this is its front
+  }
+
+  return 0;
+}
+
+/* Function: write_now
+ * Params: connection (its lock must be held), message to write
+ * Return: bytes written, or -1 if the connection is closed or broken
+ *
+ * Description: Writes as much of the message as the socket takes right now, but
+ *              only if nothing is queued ahead of it (otherwise writes 0 bytes).
+ */
+ssize_t reactor::write_now(connection * c, const std::string & message)
+{
+  if (c->closed || c->evicted)
+    return -1;
+
+  size_t offset = 0;
+  if (c->outbound.empty())
+  {
+    while (offset < message.size())
+    {
+      ssize_t bytes_sent = ::send(c->socket_id, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+      if (bytes_sent == -1)
+      {
+        if (errno == EINTR)
+          continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        return -1; // The reactor will notice the broken socket and close it.
+      }
+      offset += bytes_sent;
+      c->bytes_sent += bytes_sent;
+      metrics::count(COUNTER_BYTES_SENT, bytes_sent);
+    }
+  }
+
+  return offset;
+}
+
+/* Function: queue
+ * Params: socket to send to, buffers to send in order (emptied)
+ * Return: 0 if the buffers were queued, 1 otherwise
+ *
+ * Description: Moves the buffers onto the end of the socket's outbound queue
+ *              without writing anything, so a caller can fix its place in the
+ *              stream while holding a lock and write it with flush() afterwards.
+ */
+int reactor::queue(int socket_id, std::vector<std::string> & buffers)
+{
+  std::shared_ptr<connection> c = find_client(socket_id);
+  int result = c ? 0 : 1;
+
+  if (c)
+  {
+    std::lock_guard<std::mutex> guard(c->lock);
+    for (size_t i = 0; i < buffers.size() && result == 0; i++)
+    {
+      if (!buffers[i].empty())
+        result = enqueue(c.get(), shared_message(std::make_shared<std::string>(std::move(buffers[i]))));
+    }
+  }
+
+  buffers.clear();
+  return result;
+}
+
+/* Function: enqueue
+ * Params: connection (its lock must be held), message to queue
+ * Return: 0 if the message was queued, 1 otherwise
+ *
+ * Description: Adds the message to the connection's queue. A client whose queue
+ *              would pass OUTBOUND_LIMIT bytes or OUTBOUND_MAX_MESSAGES messages
+ *              is evicted instead.
+ */
+int reactor::enqueue(connection * c, const shared_message & message)
+{
+  if (c->closed || c->evicted)
+    return 1;
+
+  if (c->outbound.bytes() + message->size() > OUTBOUND_LIMIT || !c->outbound.push(message))
+  {
+    evict_client(c, "outbound queue overflow");
+    return 1;
+  }
+
+  if (c->outbound.size() == 1)
+    c->last_progress_ms = now_ms();
+
+  long long queued = c->outbound.bytes() - c->front_offset;
+  if (queued > c->peak_queued_bytes)
+    c->peak_queued_bytes = queued;
+
+  return 0;
+}
+
+/* Function: evict_client
+ * Params: connection (its lock must be held), reason for the log
+ * Return: void
+ *
+ * Description: Drops everything queued for a slow client and shuts its socket
+ *              down. The owning reactor then sees the hangup and closes it as
+ *              for any other disconnect.
+ */
+void reactor::evict_client(connection * c, const char * reason)
+{
+  if (c->closed || c->evicted)
+    return;
+
+  log_fields fields;
+  fields.socket = c->socket_id;
+  logger::log(LOG_WARN, fields, "evicting slow client (%s, %lu bytes queued)", reason, (unsigned long)c->outbound.bytes());
+  c->evicted = true;
+  c->outbound.clear();
+  c->front_offset = 0;
+  shutdown(c->socket_id, SHUT_RDWR);
+  evictions++;
+}
+
+/* Function: flush
+ * Params: socket to write
+ * Return: void
+ *
+ * Description: Writes as much of the socket's outbound queue as it will take now
+ */
+void reactor::flush(int socket_id)
+{
+  std::shared_ptr<connection> c = find_client(socket_id);
+  if (c)
+    flush_client(c.get());
+}
+
+/* Function: take_buffer
+ * Params: none
+ * Return: an empty string with room for at least OUTGOING_BUFFER_SIZE bytes
+ *
+ * Description: Hands out a buffer from the pool (or a new one) for serializing
+ *              large responses. flush_client() returns buffers once written.
+ */
+std::string reactor::take_buffer()
+{
+  {
+    std::lock_guard<std::mutex> guard(buffer_pool_lock);
+    if (!buffer_pool.empty())
+    {
+      std::string buffer = std::move(buffer_pool.back());
+      buffer_pool.pop_back();
+      return buffer;
+    }
+  }
+
+  std::string buffer;
+  buffer.reserve(OUTGOING_BUFFER_SIZE);
+  return buffer;
+}
+
+/* Function: give_buffer
+ * Params: buffer that is no longer needed
+ * Return: void
+ *
+ * Description: Keeps large buffers for reuse, up to BUFFER_POOL_SIZE of them
+ */
+void reactor::give_buffer(std::string & buffer)
+{
+  if (buffer.capacity() < OUTGOING_BUFFER_SIZE)
+    return;
+
+  buffer.clear();
+  std::lock_guard<std::mutex> guard(buffer_pool_lock);
+  if (buffer_pool.size() < BUFFER_POOL_SIZE)
+    buffer_pool.push_back(std::move(buffer));
+}
+
+/* Function: flush_client
+ * Params: connection that became writable
+ * Return: void
+ *
+ * Description: Writes queued messages with writev() until the queue is empty or the
+ *              socket would block. front_offset tracks how much of the first queued
+ *              message was already written.
+ */
+void reactor::flush_client(connection * c)
+{
+  std::lock_guard<std::mutex> guard(c->lock);
+
+  while (!c->closed && !c->evicted && !c->outbound.empty())
+  {
+    struct iovec chunks[MAX_IOVECS];
+    int count = 0;
+    for ( ; count < MAX_IOVECS && (size_t)count < c->outbound.size(); count++)
+    {
+      const std::string & message = c->outbound.at(count);
+      size_t skip = (count == 0) ? c->front_offset : 0;
+      chunks[count].iov_base = (void *)(message.data() + skip);
+      chunks[count].iov_len = message.size() - skip;
+    }
+
+    ssize_t bytes_sent = writev(c->socket_id, chunks, count);
+    if (bytes_sent == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      return; // Blocked (wait for the next EPOLLOUT edge) or broken (EPOLLIN/HUP closes it)
+    }
+
+    c->bytes_sent += bytes_sent;
+    metrics::count(COUNTER_BYTES_SENT, bytes_sent);
+    c->last_progress_ms = now_ms();
+
+    // Drop every message that was written completely.
+    size_t written = bytes_sent;
+    while (written > 0)
+    {
+      size_t remaining = c->outbound.at(0).size() - c->front_offset;
+      if (written < remaining)
+      {
+        c->front_offset += written;
+        break;
+      }
+
+      written -= remaining;
+      c->front_offset = 0;
+      shared_message sent = c->outbound.pop();
+
+      // A pooled buffer nobody else holds goes back to the pool. It was created
+      // non-const by queue(), so taking the const off to reuse it is safe.
+      if (sent.use_count() == 1)
+        give_buffer(const_cast<std::string &>(*sent));
+    }
+  }
+}
+
+/* Function: get_client_stats
+ * Params: vector to store the stats of every connection
+ * Return: void
+ */
+void reactor::get_client_stats(std::vector<client_stats> & stats)
+{
+  std::vector<std::shared_ptr<connection> > connections;
+  {
+    std::lock_guard<std::mutex> guard(all_clients_lock);
+    std::map<int, std::shared_ptr<connection> >::iterator it;
+    for (it = all_clients.begin(); it != all_clients.end(); it++)
+      connections.push_back(it->second);
+  }
+
+  stats.clear();
+  for (size_t i = 0; i < connections.size(); i++)
+  {
+    connection * c = connections[i].get();
+    std::lock_guard<std::mutex> guard(c->lock);
+
+    client_stats cs;
+    cs.socket_id = c->socket_id;
+    cs.queued_bytes = c->outbound.bytes() - c->front_offset;
+    cs.queued_messages = c->outbound.size();
+    cs.peak_queued_bytes = c->peak_queued_bytes;
+    cs.bytes_sent = c->bytes_sent;
+    cs.paused = c->paused;
+    stats.push_back(cs);
+  }
+}
+
+/* Function: get_evictions
+ * Params: none
+ * Return: number of slow clients evicted since startup
+ */
+long long reactor::get_evictions()
+{
+  return evictions;
+}
+
+/* Function: close_client
+ * Params: connection to close
+ * Return: void
+ *
+ * Description: Runs the disconnect handler while the socket id is still ours (so a
+ *              new connection reusing the id can't be confused with this one), then
+ *              marks the connection closed and closes the socket.
+ */
+void reactor::close_client(connection * c)
+{
+  int socket_id = c->socket_id;
+  std::shared_ptr<connection> keep_alive = clients[socket_id];
+
+  epoll_ctl(epoll_id, EPOLL_CTL_DEL, socket_id, NULL);
+  on_disconnect(socket_id);
+
+  {
+    std::lock_guard<std::mutex> guard(all_clients_lock);
+    all_clients.erase(socket_id);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(c->lock);
+    c->closed = true;
+    c->outbound.clear();
+    c->front_offset = 0;
+    close(socket_id);
+  }
+
+  clients.erase(socket_id);
+}
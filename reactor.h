@@ -0,0 +1,193 @@
+/*
+ * Filename: reactor.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h> // ssize_t
+#include "outbound_ring.h"
+#include "receive_buffer.h"
+#include "text_view.h"
+
+#define INCOMING_BUFFER_SIZE 4096 // Least room each read from a socket is given in its receive buffer
+#define OUTGOING_BUFFER_SIZE 65536 // Size of the pooled buffers large responses are serialized into
+
+#ifndef DISPATCH_MAX_LINES
+#define DISPATCH_MAX_LINES 1024   // Most lines handed to the line handler at once (override with -D)
+#endif
+
+// Outbound queue limits of each connection (override with -D at compile time)
+#ifndef OUTBOUND_HIGH_WATER
+#define OUTBOUND_HIGH_WATER (1 << 20)    // Queued bytes at which a client's own commands stop being read
+#endif
+#ifndef OUTBOUND_LOW_WATER
+#define OUTBOUND_LOW_WATER (256 << 10)   // Queued bytes at which they are read again
+#endif
+#ifndef OUTBOUND_LIMIT
+#define OUTBOUND_LIMIT (64 << 20)        // Queued bytes past which a client is evicted
+#endif
+#ifndef OUTBOUND_MAX_MESSAGES
+#define OUTBOUND_MAX_MESSAGES (1 << 18)  // Queued messages past which a client is evicted
+#endif
+#ifndef SLOW_CONSUMER_TIMEOUT_MS
+#define SLOW_CONSUMER_TIMEOUT_MS 30000   // A client whose queue makes no progress this long is evicted
+#endif
+
+/* Class: client_stats
+ *
+ * Description: Aggregate holding a point-in-time view of one connection's output
+ */
+class client_stats
+{
+ public:
+  int socket_id;
+  long long queued_bytes;      //Bytes waiting to be written
+  long long queued_messages;   //Messages waiting to be written
+  long long peak_queued_bytes; //Most bytes ever waiting at once
+  long long bytes_sent;        //Bytes written since the client connected
+  bool paused;                 //Its commands aren't being read until its queue drains
+};
+
+/* Class: reactor
+ *
+ * Description: Edge-triggered epoll event loop. Owns accepting, reading,
+ *              line framing and write-readiness for every socket it accepts.
+ *              The server runs one reactor per core; every reactor watches
+ *              the shared listening socket (EPOLLEXCLUSIVE) and keeps the
+ *              connections it accepted. Each socket is read straight into
+ *              its connection's receive_buffer, and the complete lines a read
+ *              brought are handed to the line handler together (up to
+ *              DISPATCH_MAX_LINES at a time), as views into it, without
+ *              copying, so a client that pipelines commands can have them
+ *              applied as a batch.
+ *
+ *              Each connection's output waits in a bounded outbound_ring.
+ *              Past OUTBOUND_HIGH_WATER queued bytes the reactor stops reading
+ *              that client's commands until the queue falls under
+ *              OUTBOUND_LOW_WATER. A client that overflows its queue, or whose
+ *              queue makes no progress for SLOW_CONSUMER_TIMEOUT_MS, is evicted
+ *              so it can't hold up the rest of its spreadsheet.
+ *
+ * Public Functions:
+ *   constructor:  creates the epoll instance and registers the listening socket
+ *   destructor:   closes the epoll instance
+ *   start:        launches the event loop on its own thread
+ *   stop:         asks the event loop to exit (any thread)
+ *   join:         waits for the event loop thread to finish
+ *   send:         queues/sends a message to any connected socket (any thread);
+ *                 shared messages are queued by reference, not copied
+ *   queue:        queues buffers for a socket without writing them yet
+ *   flush:        writes as much of a socket's queue as it will take
+ *   take_buffer:  hands out a pooled buffer for serializing large responses
+ *   give_buffer:  returns a buffer to the pool
+ *   get_client_stats: fills in the output counters of every connection
+ *   get_evictions:    returns how many slow clients have been evicted
+ *
+ * Private Functions:
+ *   find_client:      looks up the connection of a socket
+ *   run:              the event loop
+ *   tick:             evicts stalled clients and resumes drained ones
+ *   accept_clients:   accepts every pending connection on the listening socket
+ *   read_client:      drains a readable socket and dispatches complete lines
+ *   dispatch_lines:   hands buffered lines to the line handler in batches unless backlogged
+ *   backlogged:       tells if a client's commands should wait for its queue to drain
+ *   write_now:        writes what the socket takes now if nothing is queued ahead
+ *   enqueue:          adds a message to a connection's queue, evicting on overflow
+ *   evict_client:     drops a slow client's queue and shuts its socket down
+ *   flush_client:     writes as much queued output as the socket accepts
+ *   close_client:     unregisters and closes a connection
+ */
+class reactor
+{
+  /* Class: connection
+   *
+   * Description: State for one accepted socket. The inbound buffer is only
+   *              touched by the owning reactor; everything else is shared
+   *              with whichever thread sends to the socket, so it is guarded
+   *              by the connection's mutex.
+   */
+  class connection
+  {
+  public:
+    connection(int socket_id);
+    int socket_id;
+    bool closed;          //The socket was closed by its reactor
+    bool evicted;         //The socket was shut down for being too slow
+    bool paused;          //Its commands wait until its queue drains
+    receive_buffer inbound;
+    outbound_ring outbound;
+    size_t front_offset;  //Bytes of the first outbound message already written
+    long long last_progress_ms; //When the queue last became non-empty or was written to
+    long long peak_queued_bytes;
+    long long bytes_sent;
+    std::mutex lock;
+  };
+
+ public:
+  // Gets a client's next lines, in order; the views are valid until it returns
+  typedef void (*line_handler)(int socket_id, const text_view * lines, size_t count);
+  typedef void (*disconnect_handler)(int socket_id);
+
+  reactor(int listen_socket, line_handler on_line, disconnect_handler on_disconnect);
+  ~reactor();
+  void start();
+  void stop();
+  void join();
+  static int send(int socket_id, const std::string & message);
+  static int send(int socket_id, const shared_message & message);
+  static int queue(int socket_id, std::vector<std::string> & buffers);
+  static void flush(int socket_id);
+  static std::string take_buffer();
+  static void give_buffer(std::string & buffer);
+  static void get_client_stats(std::vector<client_stats> & stats);
+  static long long get_evictions();
+
+ private:
+  static std::shared_ptr<connection> find_client(int socket_id);
+  void run();
+  void tick();
+  void accept_clients();
+  void read_client(connection * c);
+  bool dispatch_lines(connection * c);
+  static bool backlogged(connection * c);
+  static ssize_t write_now(connection * c, const std::string & message);
+  static int enqueue(connection * c, const shared_message & message);
+  static void evict_client(connection * c, const char * reason);
+  static void flush_client(connection * c);
+  void close_client(connection * c);
+
+  int epoll_id;
+  int wake_id;              //eventfd that interrupts epoll_wait() when stopping
+  std::atomic<bool> stopping;
+  int listen_socket;
+  line_handler on_line;
+  std::vector<text_view> batch; //Lines being dispatched; reused so dispatching doesn't allocate
+  disconnect_handler on_disconnect;
+  std::thread loop_thread;
+
+  // Connections accepted by this reactor, keyed by socket.
+  std::map<int, std::shared_ptr<connection> > clients;
+
+  // Every live connection in the process, so any thread can send to any socket.
+  static std::map<int, std::shared_ptr<connection> > all_clients;
+  static std::mutex all_clients_lock;
+
+  // Large buffers kept for reuse by take_buffer().
+  static std::vector<std::string> buffer_pool;
+  static std::mutex buffer_pool_lock;
+
+  static std::atomic<long long> evictions;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Filename: receive_buffer.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "receive_buffer.h"
+#include <new> // bad_alloc
+#include <stdlib.h> // malloc, free
+#include <string.h> // memchr, memcpy, memmove
+
+/* Function: receive_buffer constructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Creates an empty buffer; nothing is allocated until the first read
+ */
+receive_buffer::receive_buffer()
+{
+  bytes = NULL;
+  capacity = 0;
+  front = 0;
+  scanned = 0;
+  end = 0;
+}
+
+/* Function: receive_buffer destructor
+ * Params: none
+ * Return: void
+ */
+receive_buffer::~receive_buffer()
+{
+  free(bytes);
+}
+
+/* Function: reserve
+ * Params: least number of bytes the next read should have room for
+ * Return: where to read them to; space() tells how many fit
+ *
+ * Description: Starts over at the front of the buffer once every line has been
+ *              taken. Otherwise, when the end is out of room, moves the unframed
+ *              bytes to the front, doubling the buffer first if they would still
+ *              fill more than half of it, so a long line is moved a bounded
+ *              number of times.
+ */
+char * receive_buffer::reserve(size_t wanted)
+{
+  if (front == end)
+    front = scanned = end = 0;
+
+  if (capacity - end < wanted)
+  {
+    size_t new_capacity = capacity == 0 ? RECEIVE_BUFFER_SIZE : capacity;
+    while (new_capacity < 2 * (end - front + wanted))
+      new_capacity *= 2;
+    resize(new_capacity);
+  }
+
+  return bytes + end;
+}
+
+/* Function: space
+ * Params: none
+ * Return: bytes that fit after the end
+ */
+size_t receive_buffer::space()
+{
+  return capacity - end;
+}
+
+/* Function: commit
+ * Params: number of bytes just read to where reserve() said (at most space())
+ * Return: void
+ */
+void receive_buffer::commit(size_t count)
+{
+  end += count;
+}
+
+/* Function: next_line
+ * Params: view to set to the line
+ * Return: true if a complete line was taken off the front, false if none is buffered
+ *
+ * Description: The line is viewed without its '\n' and stays valid until the next
+ *              call to reserve() or release(). Only bytes not searched before are
+ *              searched for the '\n'.
+ */
+bool receive_buffer::next_line(text_view & line)
+{
+  const char * newline = NULL;
+  if (scanned < end)
+    newline = (const char *)memchr(bytes + scanned, '\n', end - scanned);
+  if (newline == NULL)
+  {
+    scanned = end;
+    return false;
+  }
+
+  line.data = bytes + front;
+  line.length = newline - line.data;
+  front = scanned = newline - bytes + 1;
+  return true;
+}
+
+/* Function: pending
+ * Params: none
+ * Return: bytes received and not yet taken as lines
+ */
+size_t receive_buffer::pending()
+{
+  return end - front;
+}
+
+/* Function: release
+ * Params: none
+ * Return: void
+ *
+ * Description: Frees the buffer if every line in it has been taken, so an idle
+ *              connection holds no memory for its input.
+ */
+void receive_buffer::release()
+{
+  if (front != end)
+    return;
+
+  free(bytes);
+  bytes = NULL;
+  capacity = 0;
+  front = scanned = end = 0;
+}
+
+/* Function: resize
+ * Params: size of the buffer to use (at least the unframed bytes)
+ * Return: void
+ *
+ * Description: Moves the bytes not yet taken as lines to the front, into a new
+ *              buffer if the size changes
+ */
+void receive_buffer::resize(size_t new_capacity)
+{
+  size_t count = end - front;
+  if (new_capacity == capacity)
+    memmove(bytes, bytes + front, count);
+  else
+  {
+    char * grown = (char *)malloc(new_capacity);
+    if (grown == NULL)
+      throw std::bad_alloc();
+    if (count > 0)
+      memcpy(grown, bytes + front, count);
+    free(bytes);
+    bytes = grown;
+    capacity = new_capacity;
+  }
+
+  scanned -= front;
+  end -= front;
+  front = 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Filename: receive_buffer.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <stddef.h>
+#include "text_view.h"
+
+#define RECEIVE_BUFFER_SIZE 16384 // Bytes a connection's receive buffer starts with
+#ifndef RECEIVE_MAX_LINE
+#define RECEIVE_MAX_LINE (8 << 20) // Longest line a client may send; one still longer is closed (override with -D)
+#endif
+
+/* Class: receive_buffer
+ *
+ * Description: Growable buffer a socket is read straight into, and the lines
+ *              are framed in place. Bytes between the front and the end wait
+ *              to be framed; a scanning cursor remembers how far they have
+ *              been searched for '\n', so each byte is looked at once however
+ *              many reads a line arrives in. Lines are handed out as views
+ *              into the buffer, without copying; the buffer only moves its
+ *              bytes when a read needs room, and then only the unframed tail.
+ *              It doubles to fit a line longer than itself, up to about twice
+ *              RECEIVE_MAX_LINE (the reactor closes a client whose line is
+ *              longer), and an idle connection's buffer is freed once every
+ *              line has been taken.
+ *              Not thread safe: used only by the connection's reactor.
+ *
+ * Public Functions:
+ *   constructor:  creates an empty buffer
+ *   destructor:   frees the buffer
+ *   reserve:      returns where to read to, with room for at least some bytes
+ *   space:        returns the room after the end
+ *   commit:       adds bytes just read at the end
+ *   next_line:    takes the next complete line off the front, if there is one
+ *   pending:      returns the bytes not yet taken as lines
+ *   release:      frees the buffer if it holds nothing
+ *
+ * Private Functions:
+ *   resize:       moves the unframed bytes to the front of a buffer of a new size
+ */
+class receive_buffer
+{
+ public:
+  receive_buffer();
+  ~receive_buffer();
+  char * reserve(size_t wanted);
+  size_t space();
+  void commit(size_t count);
+  bool next_line(text_view & line);
+  size_t pending();
+  void release();
+
+ private:
+  receive_buffer(const receive_buffer &);            //Not copyable
+  receive_buffer & operator=(const receive_buffer &);
+  void resize(size_t new_capacity);
+
+  char * bytes;
+  size_t capacity;
+  size_t front;     //First byte not yet taken as a line
+  size_t scanned;   //Bytes before this have been searched and hold no '\n'
+  size_t end;       //One past the last byte read
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Filename: sheet_arena.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "sheet_arena.h"
+#include <new>      // bad_alloc
+#include <stdint.h> // SIZE_MAX
+#include <stdlib.h> // malloc, free
+
+/* Function: sheet_arena constructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Creates an arena holding no memory. The first chunk is taken on first use;
+ *              chunks start small and double, so an arena is cheap for a small sheet.
+ */
+sheet_arena::sheet_arena()
+{
+  next = NULL;
+  left = 0;
+  in_use = 0;
+  large_blocks = 0;
+  large = NULL;
+  chunk_size = ARENA_FIRST_CHUNK;
+  reserved = 0;
+  large_bytes = 0;
+  for (int i = 0; i < ARENA_CLASSES; i++)
+    free_lists[i] = NULL;
+}
+
+/* Function: sheet_arena destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Frees every chunk and large block, whether or not it was released
+ */
+sheet_arena::~sheet_arena()
+{
+  for (size_t i = 0; i < chunks.size(); i++)
+    free(chunks[i]);
+  while (large != NULL)
+  {
+    large_block * next = large->next;
+    free(large);
+    large = next;
+  }
+}
+
+/* Function: size_class
+ * Params: size of a block
+ * Return: the class serving it (class i holds blocks of ARENA_MIN_BLOCK << i bytes)
+ */
+int sheet_arena::size_class(size_t size)
+{
+  int c = 0;
+  size_t block = ARENA_MIN_BLOCK;
+  while (block < size)
+  {
+    block <<= 1;
+    c++;
+  }
+  return c;
+}
+
+/* Function: allocate
+ * Params: bytes needed
+ * Return: a block of at least that size, aligned for any type
+ *
+ * Description: Reuses a released block of the same class if there is one, otherwise
+ *              carves one from the newest chunk, taking a new chunk when it runs out.
+ *              Throws std::bad_alloc, as operator new does, when malloc fails; the
+ *              arena is left as it was.
+ */
+void * sheet_arena::allocate(size_t size)
+{
+  if (size > ARENA_MAX_BLOCK)
+  {
+    large_block * header = size > SIZE_MAX - sizeof(large_block) ? NULL : (large_block *)malloc(sizeof(large_block) + size);
+    if (header == NULL)
+      throw std::bad_alloc();
+    header->previous = NULL;
+    header->next = large;
+    if (large != NULL)
+      large->previous = header;
+    large = header;
+    large_blocks++;
+    large_bytes += size;
+    in_use += size;
+    return header + 1;
+  }
+
+  int c = size_class(size);
+  size_t block = (size_t)ARENA_MIN_BLOCK << c;
+
+  if (free_lists[c] != NULL)
+  {
+    void * reused = free_lists[c];
+    free_lists[c] = *(void **)reused;
+    in_use += block;
+    return reused;
+  }
+
+  if (left < block)
+  {
+    while (chunk_size < block)
+      chunk_size *= 2;
+    chunks.reserve(chunks.size() + 1);
+    char * chunk = (char *)malloc(chunk_size);
+    if (chunk == NULL)
+      throw std::bad_alloc();
+
+    // The tail of the old chunk is too small for this class; split it up for smaller ones
+    while (left >= ARENA_MIN_BLOCK)
+    {
+      int tail = size_class(left);
+      if (((size_t)ARENA_MIN_BLOCK << tail) > left)
+        tail--;
+      *(void **)next = free_lists[tail];
+      free_lists[tail] = next;
+      next += (size_t)ARENA_MIN_BLOCK << tail;
+      left -= (size_t)ARENA_MIN_BLOCK << tail;
+    }
+
+    next = chunk;
+    left = chunk_size;
+    reserved += chunk_size;
+    chunks.push_back(next);
+    if (chunk_size < ARENA_CHUNK_SIZE)
+      chunk_size *= 2;
+  }
+
+  void * carved = next;
+  next += block;
+  left -= block;
+  in_use += block;
+  return carved;
+}
+
+/* Function: release
+ * Params: block from allocate(), the size it was allocated with
+ * Return: void
+ */
+void sheet_arena::release(void * block, size_t size)
+{
+  if (block == NULL)
+    return;
+
+  if (size > ARENA_MAX_BLOCK)
+  {
+    large_block * header = (large_block *)block - 1;
+    if (header->previous != NULL)
+      header->previous->next = header->next;
+    else
+      large = header->next;
+    if (header->next != NULL)
+      header->next->previous = header->previous;
+    large_blocks--;
+    large_bytes -= size;
+    in_use -= size;
+    free(header);
+    return;
+  }
+
+  int c = size_class(size);
+  in_use -= (size_t)ARENA_MIN_BLOCK << c;
+  *(void **)block = free_lists[c];
+  free_lists[c] = block;
+}
+
+/* Function: get_stats
+ * Params: stats to fill in
+ * Return: void
+ */
+void sheet_arena::get_stats(arena_stats * stats)
+{
+  stats->chunks = chunks.size();
+  stats->reserved = reserved;
+  stats->large_bytes = large_bytes;
+  stats->in_use = in_use;
+  stats->large_blocks = large_blocks;
+}
@@ -0,0 +1,97 @@
+/*
+ * Filename: sheet_arena.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef SHEET_ARENA_H
+#define SHEET_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+#define ARENA_FIRST_CHUNK (4 << 10)  // Size of an arena's first chunk; each next one doubles...
+#define ARENA_CHUNK_SIZE (256 << 10) // ...up to this, so a small sheet holds little
+#define ARENA_MIN_BLOCK 16           // Smallest block handed out
+#define ARENA_MAX_BLOCK (16 << 10)   // Larger blocks are malloc'd one by one
+#define ARENA_CLASSES 11             // Size classes 16, 32, ... ARENA_MAX_BLOCK
+
+/* Class: arena_stats
+ *
+ * Description: Aggregate holding a point-in-time view of an arena
+ */
+class arena_stats
+{
+ public:
+  long long chunks;        //Chunks taken from malloc
+  long long reserved;      //Bytes held in chunks
+  long long large_bytes;   //Bytes held in large blocks
+  long long in_use;        //Bytes handed out and not released, rounded up to their size class if they have one
+  long long large_blocks;  //Blocks too big for a size class, malloc'd one by one
+};
+
+/* Class: sheet_arena
+ *
+ * Description: Memory of one spreadsheet: long cell contents, dependency lists
+ *              and undo records. Blocks are rounded up to a power-of-two size
+ *              class and carved from chunks that double in size; a released
+ *              block goes on its class's free list and is handed out again
+ *              before a new chunk is taken, so a sheet being edited in place
+ *              stops calling malloc once its working set is warm. Blocks too
+ *              big for a class are malloc'd on their own but still tracked,
+ *              so everything is freed at once when the arena is destroyed
+ *              with its spreadsheet; nothing has to be released one by one
+ *              first.
+ *              Not thread safe: used only under the spreadsheet's lock.
+ *
+ * Public Functions:
+ *   constructor:  creates an empty arena
+ *   destructor:   frees every chunk and large block
+ *   allocate:     returns a block of at least the given size (throws std::bad_alloc)
+ *   release:      gives a block back for reuse (pass the size it was allocated with)
+ *   get_stats:    fills in how much memory the arena holds
+ *
+ * Private Functions:
+ *   size_class:   returns the class of a block size
+ */
+class sheet_arena
+{
+  /* Class: large_block
+   *
+   * Description: Header in front of a block too big for a size class, linking it
+   *              into the list of large blocks the destructor frees
+   */
+  class large_block
+  {
+  public:
+    large_block * previous;
+    large_block * next;
+    long double align;  //Pads the header so the block after it is aligned for any type
+  };
+
+ public:
+  sheet_arena();
+  ~sheet_arena();
+  void * allocate(size_t size);
+  void release(void * block, size_t size);
+  void get_stats(arena_stats * stats);
+
+ private:
+  sheet_arena(const sheet_arena &);            //Not copyable
+  sheet_arena & operator=(const sheet_arena &);
+  static int size_class(size_t size);
+
+  std::vector<char*> chunks;
+  size_t chunk_size;           //Size of the next chunk
+  long long reserved;          //Bytes in all chunks
+  long long large_bytes;
+  char * next;                 //Unused part of the newest chunk
+  size_t left;                 //Bytes left in it
+  void * free_lists[ARENA_CLASSES];
+  long long in_use;
+  long long large_blocks;
+  large_block * large;         //Newest large block
+};
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * Filename: sheet_log.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "sheet_log.h"
+#include <algorithm> // count()
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "logger.h"
+
+/* Function: now_ms
+ * Params: none
+ * Return: milliseconds on a monotonic clock
+ */
+static long long now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: read_records
+ * Params: file to read, where to append its records, whether empty contents are kept
+ * Return: number of complete records read
+ *
+ * Description: Splits every complete "name=contents" line of the file into its name and
+ *              contents. A final line without its '\n' is a record torn by a crash and is ignored.
+ */
+int sheet_log::read_records(std::string file_name, std::vector<std::pair<std::string, std::string> > & records, bool keep_empty)
+{
+  std::ifstream file_stream(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!file_stream.is_open())
+    return 0;
+
+  std::stringstream buffer;
+  buffer << file_stream.rdbuf();
+  std::string contents = buffer.str();
+  records.reserve(records.size() + std::count(contents.begin(), contents.end(), '\n'));
+
+  int count = 0;
+  size_t line_start = 0;
+  size_t line_end;
+  while ((line_end = contents.find('\n', line_start)) != std::string::npos)
+  {
+    // Separate into cell_name and cell_contents by "=" symbol.
+    size_t equals_index = contents.find('=', line_start);
+    size_t name_start = line_start;
+    line_start = line_end + 1;
+    if (equals_index == std::string::npos || equals_index > line_end)
+      continue;
+    count++;
+
+    if (equals_index + 1 == line_end && !keep_empty)
+      continue;
+
+    records.push_back(std::make_pair(contents.substr(name_start, equals_index - name_start),
+                                     contents.substr(equals_index + 1, line_end - equals_index - 1)));
+  }
+
+  return count;
+}
+
+/* Function: to_snapshot_cells
+ * Params: records to convert, vector to store the cells in
+ * Return: void
+ *
+ * Description: Parses the names of the records into coordinates, skipping records whose
+ *              name isn't a cell. The cells point into the records, which must outlive them.
+ */
+void sheet_log::to_snapshot_cells(const std::vector<std::pair<std::string, std::string> > & records,
+                                  std::vector<snapshot_cell> & cells)
+{
+  cells.reserve(cells.size() + records.size());
+  for (size_t i = 0; i < records.size(); i++)
+  {
+    snapshot_cell cell;
+    const std::string & name = records[i].first;
+    if (!parse_cell_name(name.data(), name.data() + name.size(), &cell.coord))
+      continue;
+    cell.contents = records[i].second.c_str();
+    cell.length = records[i].second.size();
+    cells.push_back(cell);
+  }
+}
+
+/* Function: sheet_log constructor
+ * Params: spreadsheet name, fsync policy, records per group, longest group wait, compaction threshold
+ * Return: void
+ *
+ * Description: Opens the spreadsheet's log for appending, creating it if needed
+ */
+sheet_log::sheet_log(std::string sheet_name, int fsync_policy, int group_size, int group_interval_ms, int compact_after)
+{
+  this->sheet_name = sheet_name;
+  this->fsync_policy = fsync_policy;
+  this->group_size = group_size;
+  this->group_interval_ms = group_interval_ms;
+  this->compact_after = compact_after;
+  this->unsynced = 0;
+  this->last_sync_ms = now_ms();
+
+  std::string file_name = sheet_name + ".axislog";
+  log_file = open(file_name.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (log_file == -1)
+    logger::error("sheet_log open");
+
+  // Count what a previous run left behind so it still counts toward compaction.
+  records = 0;
+  std::ifstream existing(file_name.c_str(), std::ios::in | std::ios::binary);
+  std::string line;
+  while (getline(existing, line))
+    records++;
+}
+
+/* Function: sheet_log destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Syncs and closes the log
+ */
+sheet_log::~sheet_log()
+{
+  if (log_file != -1)
+  {
+    sync();
+    close(log_file);
+  }
+}
+
+/* Function: write_all
+ * Params: buffer and its length
+ * Return: 1 if the whole buffer was written, 0 otherwise
+ */
+int sheet_log::write_all(const char * buffer, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t written = write(log_file, buffer, length);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      logger::error("sheet_log write");
+      return 0;
+    }
+    buffer += written;
+    length -= written;
+  }
+  return 1;
+}
+
+/* Function: append
+ * Params: cell changes (name, new contents) in the order they were made
+ * Return: 1 if the records were written, 0 otherwise
+ *
+ * Description: Appends the records with a single write() and syncs as the policy dictates.
+ *              Under FSYNC_GROUP the records reach the OS immediately but are only
+ *              forced to disk with the rest of their group.
+ */
+int sheet_log::append(const std::vector<std::pair<std::string, std::string> > & changes)
+{
+  if (log_file == -1)
+    return 0;
+  if (changes.empty())
+    return 1;
+
+  size_t length = 0;
+  std::vector<std::pair<std::string, std::string> >::const_iterator it;
+  for (it = changes.begin(); it != changes.end(); it++)
+    length += it->first.size() + it->second.size() + 2;
+
+  std::string batch;
+  batch.reserve(length);
+  for (it = changes.begin(); it != changes.end(); it++)
+  {
+    batch += it->first;
+    batch += '=';
+    batch += it->second;
+    batch += '\n';
+  }
+
+  if (!write_all(batch.data(), batch.size()))
+    return 0;
+
+  records += changes.size();
+  unsynced += changes.size();
+
+  if (fsync_policy == FSYNC_ALWAYS || (fsync_policy == FSYNC_GROUP && unsynced >= group_size))
+    sync();
+  else
+    sync_if_due();
+
+  return 1;
+}
+
+/* Function: sync
+ * Params: none
+ * Return: void
+ *
+ * Description: Forces every appended record to disk
+ */
+void sheet_log::sync()
+{
+  if (log_file != -1 && unsynced > 0)
+    fdatasync(log_file);
+  unsynced = 0;
+  last_sync_ms = now_ms();
+}
+
+/* Function: sync_if_due
+ * Params: none
+ * Return: number of records still waiting for an fsync
+ *
+ * Description: Under FSYNC_GROUP, syncs the records appended so far once
+ *              group_interval_ms has passed since the last sync. Call it periodically
+ *              so a group that stops growing still reaches the disk.
+ */
+int sheet_log::sync_if_due()
+{
+  if (fsync_policy == FSYNC_GROUP && unsynced > 0 && now_ms() - last_sync_ms >= group_interval_ms)
+    sync();
+  return fsync_policy == FSYNC_GROUP ? unsynced : 0;
+}
+
+/* Function: needs_compaction
+ * Params: none
+ * Return: 1 if the log has grown past its compaction threshold, 0 otherwise
+ */
+int sheet_log::needs_compaction()
+{
+  return records >= compact_after;
+}
+
+/* Function: size
+ * Params: none
+ * Return: number of records in the log, that a snapshot doesn't hold yet
+ */
+int sheet_log::size()
+{
+  return records;
+}
+
+/* Function: compact
+ * Params: cells to snapshot (sorted in place)
+ * Return: 1 if succeeded, 0 otherwise
+ *
+ * Description: Writes the binary snapshot to a temporary file, syncs it, renames it
+ *              over <name>.axissnap and syncs the directory, and only then removes
+ *              any text snapshot and empties the log. A crash before the directory
+ *              is synced keeps the full log beside either snapshot; a crash after it
+ *              replays records the new snapshot already holds, which is harmless.
+ *              If the log can't be emptied it is kept whole, for the same reason.
+ *              A text snapshot left beside it is ignored, since the binary one is
+ *              preferred.
+ */
+int sheet_log::compact(std::vector<snapshot_cell> & cells)
+{
+  if (!sheet_snapshot::write(sheet_name + ".axissnap", cells))
+    return 0;
+
+  // The text snapshot an older server wrote is out of date now
+  std::string text_name = sheet_name + ".axissheet";
+  if (unlink(text_name.c_str()) == -1 && errno != ENOENT)
+    logger::error("sheet_log unlink");
+
+  if (log_file != -1)
+  {
+    if (ftruncate(log_file, 0) == -1)
+    {
+      logger::error("sheet_log ftruncate");
+      return 0;
+    }
+    fdatasync(log_file);
+  }
+  records = 0;
+  unsynced = 0;
+  last_sync_ms = now_ms();
+  return 1;
+}
+
+/* Function: recover
+ * Params: spreadsheet to load (named after its files)
+ * Return: number of records replayed from the log
+ *
+ * Description: Loads the binary snapshot <name>.axissnap, or the text snapshot
+ *              <name>.axissheet an older server wrote if there is no usable binary one,
+ *              then replays <name>.axislog over it in order. Empty contents in the text
+ *              snapshot are skipped as before, but in the log they are edits that cleared
+ *              a cell and are replayed. The snapshot holds no cycles, so it is loaded in
+ *              bulk with one check for the whole sheet; the log is replayed edit by edit,
+ *              as it was made, records joined to the one before them (JOINED_RECORD_MARK)
+ *              as one batch with it. Only the edits from the log can be undone; history
+ *              from before the snapshot is in the undo journal, if the spreadsheet has one.
+ */
+int sheet_log::recover(spreadsheet * s)
+{
+  std::vector<std::pair<std::string, std::string> > records;
+  sheet_snapshot * snapshot = sheet_snapshot::open(s->get_name() + ".axissnap");
+  if (snapshot != NULL)
+    s->load_snapshot(snapshot);
+  else
+  {
+    std::vector<snapshot_cell> cells;
+    read_records(s->get_name() + ".axissheet", records, false);
+    to_snapshot_cells(records, cells);
+    s->load_cells(cells, false);
+  }
+
+  records.clear();
+  int count = read_records(s->get_name() + ".axislog", records, true);
+  std::vector<std::pair<text_view, text_view> > batch;
+  size_t i = 0;
+  while (i < records.size())
+  {
+    if (!records[i].first.empty() && records[i].first[0] == JOINED_RECORD_MARK)
+      records[i].first.erase(0, 1); // Nothing before it to join
+    size_t end = i + 1;
+    while (end < records.size() && !records[end].first.empty() && records[end].first[0] == JOINED_RECORD_MARK)
+    {
+      records[end].first.erase(0, 1);
+      end++;
+    }
+
+    if (end == i + 1)
+      s->set_cell(records[i].first, records[i].second);
+    else
+    {
+      batch.clear();
+      for (size_t j = i; j < end; j++)
+        batch.push_back(std::make_pair(text_view(records[j].first), text_view(records[j].second)));
+      size_t bad_cell;
+      s->set_cells(batch, &bad_cell);
+    }
+    i = end;
+  }
+  return count;
+}
@@ -0,0 +1,77 @@
+/*
+ * Filename: sheet_log.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef SHEET_LOG_H
+#define SHEET_LOG_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include "spreadsheet.h"
+
+// When appended records are forced to disk with fsync()
+#define FSYNC_NEVER  0 // Leave it to the OS
+#define FSYNC_GROUP  1 // Once per group of records or interval, whichever comes first
+#define FSYNC_ALWAYS 2 // After every record
+
+/* Class: sheet_log
+ *
+ * Description: Append-only write-ahead log of cell edits for one spreadsheet.
+ *              Every edit appends a "name=contents" record to <name>.axislog
+ *              instead of rewriting the whole <name>.axissnap snapshot; an
+ *              edit of many cells appends one per cell, each after the first
+ *              named with JOINED_RECORD_MARK in front, and is replayed as one.
+ *              Once enough records pile up the log is compacted: the
+ *              snapshot is rewritten from the cells and the log emptied.
+ *              Recovery loads the snapshot and replays the log over it.
+ *
+ * Public Functions:
+ *   constructor:       opens (or creates) the log of the named spreadsheet
+ *   destructor:        syncs and closes the log
+ *   append:            appends a batch of records in one write, syncing as the policy dictates
+ *   sync:              forces every appended record to disk
+ *   sync_if_due:       syncs a group whose interval has run out
+ *   needs_compaction:  tells if the log has grown past its compaction threshold
+ *   size:              returns the number of records in the log
+ *   compact:           rewrites the snapshot from a copy of the cells and empties the log
+ *   recover:           loads a spreadsheet's snapshot and replays its log into it
+ *   read_records:      reads the "name=contents" records of a log or text snapshot
+ *   to_snapshot_cells: parses the names of records into coordinates
+ *
+ * Private Functions:
+ *   write_all:         writes a whole buffer to the log file
+ */
+class sheet_log
+{
+ public:
+  sheet_log(std::string sheet_name, int fsync_policy, int group_size, int group_interval_ms, int compact_after);
+  ~sheet_log();
+  int append(const std::vector<std::pair<std::string, std::string> > & changes);
+  void sync();
+  int sync_if_due();
+  int needs_compaction();
+  int size();
+  int compact(std::vector<snapshot_cell> & cells);
+  static int recover(spreadsheet * s);
+  static int read_records(std::string file_name, std::vector<std::pair<std::string, std::string> > & records, bool keep_empty);
+  static void to_snapshot_cells(const std::vector<std::pair<std::string, std::string> > & records,
+                                std::vector<snapshot_cell> & cells);
+
+ private:
+  int write_all(const char * buffer, size_t length);
+  std::string sheet_name;
+  int log_file;             //Descriptor of <name>.axislog, opened for appending
+  int fsync_policy;
+  int group_size;           //Records per fsync under FSYNC_GROUP
+  int group_interval_ms;    //Longest time a record waits for an fsync under FSYNC_GROUP
+  int compact_after;        //Records in the log before it should be compacted
+  int records;              //Records currently in the log
+  int unsynced;             //Records appended since the last fsync
+  long long last_sync_ms;
+};
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * Filename: sheet_snapshot.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "sheet_snapshot.h"
+#include <algorithm> // stable_sort()
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <stdio.h> // rename
+#include <string.h> // memcmp, memcpy, memset
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logger.h"
+
+/* Class: crc_table
+ *
+ * Description: Lookup table of CRC-32C (Castagnoli), built once
+ */
+class crc_table
+{
+ public:
+  crc_table()
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; bit++)
+        c = (c & 1) ? 0x82F63B78u ^ (c >> 1) : c >> 1;
+      entries[i] = c;
+    }
+  }
+  uint32_t entries[256];
+};
+
+#if defined(__x86_64__)
+/* Function: crc32c_sse42
+ * Params: bytes and their count
+ * Return: their CRC-32C, computed 8 bytes at a time by the SSE4.2 crc32 instruction
+ */
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse42(const char * bytes, size_t length)
+{
+  unsigned long long c = 0xFFFFFFFFu;
+  for (; length >= 8; bytes += 8, length -= 8)
+  {
+    unsigned long long word;
+    memcpy(&word, bytes, sizeof(word));
+    c = __builtin_ia32_crc32di(c, word);
+  }
+  uint32_t tail = (uint32_t)c;
+  for (; length > 0; bytes++, length--)
+    tail = __builtin_ia32_crc32qi(tail, (unsigned char)*bytes);
+  return tail ^ 0xFFFFFFFFu;
+}
+#endif
+
+/* Function: crc32c
+ * Params: bytes and their count
+ * Return: their CRC-32C, in hardware where the CPU has it and from a table otherwise
+ */
+static uint32_t crc32c(const char * bytes, size_t length)
+{
+#if defined(__x86_64__)
+  static const bool sse42 = __builtin_cpu_supports("sse4.2");
+  if (sse42)
+    return crc32c_sse42(bytes, length);
+#endif
+
+  static const crc_table table;
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < length; i++)
+    c = table.entries[(c ^ (unsigned char)bytes[i]) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+/* Function: by_coord
+ * Params: two cells
+ * Return: true if the first comes first in a snapshot's index
+ */
+static bool by_coord(const snapshot_cell & a, const snapshot_cell & b)
+{
+  return a.coord < b.coord;
+}
+
+/* Function: write_all
+ * Params: descriptor, buffer and its length
+ * Return: 1 if the whole buffer was written, 0 otherwise
+ */
+static int write_all(int file, const char * buffer, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t written = write(file, buffer, length);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      logger::error("sheet_snapshot write");
+      return 0;
+    }
+    buffer += written;
+    length -= written;
+  }
+  return 1;
+}
+
+/* Function: sheet_snapshot constructor
+ * Params: mapping of a snapshot file and its length
+ * Return: void
+ */
+sheet_snapshot::sheet_snapshot(const char * base, size_t length)
+{
+  this->base = base;
+  this->length = length;
+  header = (const snapshot_header *)base;
+  index = NULL;
+  strings = NULL;
+}
+
+/* Function: sheet_snapshot destructor
+ * Params: none
+ * Return: void
+ *
+ * Description: Unmaps the file; contents taken from get_cells() are gone with it
+ */
+sheet_snapshot::~sheet_snapshot()
+{
+  munmap((void *)base, length);
+}
+
+/* Function: open
+ * Params: name of a snapshot file
+ * Return: the snapshot, or NULL if there is no such file or it is damaged
+ *
+ * Description: Maps the whole file read-only and checks it before anything is read
+ *              from it. A damaged file is reported, and left for the caller to fall back from.
+ */
+sheet_snapshot * sheet_snapshot::open(std::string file_name)
+{
+  int file = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file == -1)
+  {
+    if (errno != ENOENT)
+      logger::error("sheet_snapshot open");
+    return NULL;
+  }
+
+  struct stat status;
+  if (fstat(file, &status) == -1 || status.st_size < (off_t)sizeof(snapshot_header))
+  {
+    logger::log(LOG_ERROR, log_fields(), "sheet_snapshot: %s is too short", file_name.c_str());
+    close(file);
+    return NULL;
+  }
+
+  void * base = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (base == MAP_FAILED)
+  {
+    logger::error("sheet_snapshot mmap");
+    return NULL;
+  }
+
+  sheet_snapshot * snapshot = new sheet_snapshot((const char *)base, status.st_size);
+  if (!snapshot->check())
+  {
+    logger::log(LOG_ERROR, log_fields(), "sheet_snapshot: %s is damaged", file_name.c_str());
+    delete snapshot;
+    return NULL;
+  }
+  return snapshot;
+}
+
+/* Function: check
+ * Params: none
+ * Return: 1 if the header, index and string table are whole and match their checksums
+ *         and every entry lies inside the string table, 0 otherwise
+ */
+int sheet_snapshot::check()
+{
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION ||
+      header->header_size != sizeof(snapshot_header) ||
+      header->header_checksum != crc32c(base, offsetof(snapshot_header, header_checksum)))
+    return 0;
+
+  if (header->index_offset < sizeof(snapshot_header) || header->index_offset > length ||
+      header->cell_count > (length - header->index_offset) / sizeof(snapshot_entry) ||
+      header->strings_offset > length || header->strings_size > length - header->strings_offset)
+    return 0;
+
+  index = (const snapshot_entry *)(base + header->index_offset);
+  strings = base + header->strings_offset;
+  if (crc32c((const char *)index, header->cell_count * sizeof(snapshot_entry)) != header->index_checksum ||
+      crc32c(strings, header->strings_size) != header->strings_checksum)
+    return 0;
+
+  for (uint64_t i = 0; i < header->cell_count; i++)
+  {
+    if (index[i].offset >= header->strings_size || index[i].length >= header->strings_size - index[i].offset ||
+        strings[(uint64_t)index[i].offset + index[i].length] != '\0')
+      return 0;
+  }
+  return 1;
+}
+
+/* Function: size
+ * Params: none
+ * Return: number of cells in the snapshot
+ */
+size_t sheet_snapshot::size()
+{
+  return header->cell_count;
+}
+
+/* Function: get_cells
+ * Params: vector to store the cells in
+ * Return: void
+ *
+ * Description: The contents point into the mapping; nothing is copied. They stay
+ *              valid until the snapshot is deleted.
+ */
+void sheet_snapshot::get_cells(std::vector<snapshot_cell> & cells)
+{
+  cells.resize(header->cell_count);
+  for (uint64_t i = 0; i < header->cell_count; i++)
+  {
+    cells[i].coord = index[i].coord;
+    cells[i].contents = strings + index[i].offset;
+    cells[i].length = index[i].length;
+  }
+}
+
+/* Function: write
+ * Params: name of the snapshot file, cells to save (sorted in place)
+ * Return: 1 if the snapshot was written and synced, 0 otherwise
+ *
+ * Description: Writes <file_name>.tmp, syncs it and renames it over the file, then
+ *              syncs the directory so the rename itself survives a power loss.
+ *              A cell listed more than once keeps its last contents. Identical
+ *              contents are saved once in the string table.
+ */
+int sheet_snapshot::write(std::string file_name, std::vector<snapshot_cell> & cells)
+{
+  std::stable_sort(cells.begin(), cells.end(), by_coord);
+
+  std::vector<snapshot_entry> entries;
+  entries.reserve(cells.size());
+  std::string table;
+  std::map<std::string, uint32_t> offsets;
+  for (size_t i = 0; i < cells.size(); i++)
+  {
+    if (i + 1 < cells.size() && cells[i + 1].coord == cells[i].coord)
+      continue;
+
+    std::string contents(cells[i].contents, cells[i].length);
+    std::map<std::string, uint32_t>::iterator it = offsets.find(contents);
+    if (it == offsets.end())
+    {
+      if (table.size() + contents.size() >= UINT32_MAX)
+      {
+        logger::log(LOG_ERROR, log_fields(), "sheet_snapshot: %s would hold more than 4GB of contents", file_name.c_str());
+        return 0;
+      }
+      it = offsets.insert(std::make_pair(contents, (uint32_t)table.size())).first;
+      table.append(contents);
+      table += '\0';
+    }
+    snapshot_entry entry;
+    entry.coord = cells[i].coord;
+    entry.offset = it->second;
+    entry.length = cells[i].length;
+    entries.push_back(entry);
+  }
+
+  snapshot_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.header_size = sizeof(snapshot_header);
+  header.cell_count = entries.size();
+  header.index_offset = sizeof(snapshot_header);
+  header.strings_offset = header.index_offset + entries.size() * sizeof(snapshot_entry);
+  header.strings_size = table.size();
+  header.index_checksum = crc32c((const char *)entries.data(), entries.size() * sizeof(snapshot_entry));
+  header.strings_checksum = crc32c(table.data(), table.size());
+  header.header_checksum = crc32c((const char *)&header, offsetof(snapshot_header, header_checksum));
+
+  std::string temp_name = file_name + ".tmp";
+  int file = ::open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (file == -1)
+  {
+    logger::error("sheet_snapshot create");
+    return 0;
+  }
+
+  int written = write_all(file, (const char *)&header, sizeof(header)) &&
+                write_all(file, (const char *)entries.data(), entries.size() * sizeof(snapshot_entry)) &&
+                write_all(file, table.data(), table.size());
+  if (written && fsync(file) == -1)
+  {
+    logger::error("sheet_snapshot fsync");
+    written = 0;
+  }
+  close(file);
+  if (!written)
+    return 0;
+
+  if (rename(temp_name.c_str(), file_name.c_str()) == -1)
+  {
+    logger::error("sheet_snapshot rename");
+    return 0;
+  }
+  return sync_directory(file_name);
+}
+
+/* Function: sync_directory
+ * Params: name of a file
+ * Return: 1 if the directory holding the file was synced, 0 otherwise
+ *
+ * Description: A rename is only durable once its directory is synced; until
+ *              then a power loss may bring back the old file.
+ */
+int sheet_snapshot::sync_directory(const std::string & file_name)
+{
+  size_t slash = file_name.rfind('/');
+  std::string directory = slash == std::string::npos ? "." : file_name.substr(0, slash + 1);
+  int file = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (file == -1)
+  {
+    logger::error("sheet_snapshot open directory");
+    return 0;
+  }
+  int synced = fsync(file) == 0;
+  if (!synced)
+    logger::error("sheet_snapshot fsync directory");
+  close(file);
+  return synced;
+}
@@ -0,0 +1,115 @@
+/*
+ * Filename: sheet_snapshot.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef SHEET_SNAPSHOT_H
+#define SHEET_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "cell_ref.h"
+
+#define SNAPSHOT_MAGIC "AXISSNAP"  // First 8 bytes of every snapshot file
+#define SNAPSHOT_VERSION 1         // Bumped whenever the layout below changes
+
+/* Class: snapshot_cell
+ *
+ * Description: Aggregate holding a cell's coordinates and contents, as saved in
+ *              a snapshot. The contents are followed by '\0' and aren't owned.
+ */
+class snapshot_cell
+{
+ public:
+  cell_coord coord;
+  const char * contents;
+  size_t length;
+};
+
+/* Class: snapshot_header
+ *
+ * Description: First 64 bytes of a snapshot file. Offsets are from the start of
+ *              the file; numbers are in the machine's byte order (little-endian
+ *              on every machine the server runs on).
+ */
+class snapshot_header
+{
+ public:
+  char magic[8];              //SNAPSHOT_MAGIC, without its '\0'
+  uint32_t version;           //SNAPSHOT_VERSION
+  uint32_t header_size;       //sizeof(snapshot_header)
+  uint64_t cell_count;        //Entries in the cell index
+  uint64_t index_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint32_t index_checksum;    //CRC-32C of the cell index
+  uint32_t strings_checksum;  //CRC-32C of the string table
+  uint32_t header_checksum;   //CRC-32C of the header before this field
+  uint32_t reserved;          //Zero
+};
+
+/* Class: snapshot_entry
+ *
+ * Description: One cell of a snapshot's index, which is sorted by coordinates.
+ *              Its contents are in the string table at offset, followed by '\0'.
+ */
+class snapshot_entry
+{
+ public:
+  uint64_t coord;
+  uint32_t offset;
+  uint32_t length;
+};
+
+/* Class: sheet_snapshot
+ *
+ * Description: Binary snapshot of one spreadsheet's cells, <name>.axissnap:
+ *              a header, an index of every cell and a string table holding
+ *              each distinct contents once. Contents may hold any bytes,
+ *              newlines included. A snapshot is opened by mapping the file
+ *              read-only; every offset and checksum is checked first, after
+ *              which the contents are used in place, without parsing or
+ *              copying, for as long as the snapshot is open. Written to a
+ *              temporary file, synced and renamed over the old one, and the
+ *              directory synced, so a crash leaves either snapshot whole; a mapping of the old one stays
+ *              valid after the rename.
+ *
+ * Public Functions:
+ *   open:       maps and checks a snapshot file
+ *   write:      writes a snapshot file from cells
+ *   sync_directory: makes a rename into a file's directory durable
+ *   destructor: unmaps the file
+ *   size:       returns the number of cells
+ *   get_cells:  returns every cell, pointing into the mapping
+ *
+ * Private Functions:
+ *   constructor:  creates a snapshot of a mapping
+ *   check:        tells if the mapping is a whole, undamaged snapshot
+ */
+class sheet_snapshot
+{
+ public:
+  static sheet_snapshot * open(std::string file_name);
+  static int write(std::string file_name, std::vector<snapshot_cell> & cells);
+  static int sync_directory(const std::string & file_name);
+  ~sheet_snapshot();
+  size_t size();
+  void get_cells(std::vector<snapshot_cell> & cells);
+
+ private:
+  sheet_snapshot(const char * base, size_t length);
+  sheet_snapshot(const sheet_snapshot &);            //Not copyable
+  sheet_snapshot & operator=(const sheet_snapshot &);
+  int check();
+  const char * base;      //Start of the mapping
+  size_t length;          //Bytes mapped: the whole file
+  const snapshot_header * header;
+  const snapshot_entry * index;
+  const char * strings;
+};
+
+#endif
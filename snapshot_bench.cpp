@@ -0,0 +1,192 @@
+/*
+ * Filename: snapshot_bench.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Times loading every spreadsheet listed in spreadsheets.axis from its
+ *   text snapshot (<name>.axissheet) and from its binary snapshot (<name>.axissnap),
+ *   as recovery does before the log is replayed. Run snapshot_convert first so both
+ *   exist. For each format it reports the best of several rounds: the time to read
+ *   and parse the files alone, the time to load them into spreadsheets, and the
+ *   bytes on disk. Spreadsheets loaded both ways are checked to hold the same cells.
+ *
+ *   Usage: snapshot_bench [rounds] [directory]
+ */
+
+#include <algorithm> // min(), sort()
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdio.h> // perror error message printing
+#include <stdlib.h> // atoi
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sheet_log.h"
+#include "sheet_snapshot.h"
+#include "spreadsheet.h"
+
+/* Class: format_timing
+ *
+ * Description: Aggregate holding the best times of one format, in milliseconds
+ */
+class format_timing
+{
+ public:
+  double parse_ms;  //Reading the files into cells
+  double load_ms;   //Reading them into spreadsheets
+  long long bytes;  //Size of the files
+};
+
+/* Function: now_ms
+ * Params: none
+ * Return: milliseconds on a monotonic clock, with fractions
+ */
+static double now_ms()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: file_size
+ * Params: name of a file
+ * Return: its size in bytes, or 0 if it doesn't exist
+ */
+static long long file_size(std::string file_name)
+{
+  struct stat status;
+  if (stat(file_name.c_str(), &status) == -1)
+    return 0;
+  return status.st_size;
+}
+
+/* Function: load_text
+ * Params: spreadsheet to fill, or NULL to only parse
+ * Return: number of cells read
+ */
+static size_t load_text(std::string name, spreadsheet * s)
+{
+  std::vector<std::pair<std::string, std::string> > records;
+  std::vector<snapshot_cell> cells;
+  sheet_log::read_records(name + ".axissheet", records, false);
+  sheet_log::to_snapshot_cells(records, cells);
+  if (s != NULL)
+    s->load_cells(cells, false);
+  return cells.size();
+}
+
+/* Function: load_binary
+ * Params: spreadsheet to fill, or NULL to only parse
+ * Return: number of cells read
+ */
+static size_t load_binary(std::string name, spreadsheet * s)
+{
+  sheet_snapshot * snapshot = sheet_snapshot::open(name + ".axissnap");
+  if (snapshot == NULL)
+    return 0;
+  if (s != NULL)
+    return s->load_snapshot(snapshot);
+
+  std::vector<snapshot_cell> cells;
+  snapshot->get_cells(cells);
+  delete snapshot;
+  return cells.size();
+}
+
+/* Function: same_cells
+ * Params: two spreadsheets
+ * Return: true if they hold the same cells with the same contents
+ */
+static bool same_cells(spreadsheet * a, spreadsheet * b)
+{
+  std::vector<std::pair<std::string, std::string> > cells_a;
+  std::vector<std::pair<std::string, std::string> > cells_b;
+  a->get_cells(cells_a);
+  b->get_cells(cells_b);
+  std::sort(cells_a.begin(), cells_a.end());
+  std::sort(cells_b.begin(), cells_b.end());
+  return cells_a == cells_b;
+}
+
+/* Function: main
+ * Params: number of arguments, string arguments
+ * Return: 0 if both formats loaded the same cells, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 5;
+  if (rounds < 1)
+    rounds = 1;
+  if (argc > 2 && chdir(argv[2]) == -1)
+  {
+    perror(argv[2]);
+    return 1;
+  }
+
+  std::vector<std::string> names;
+  std::ifstream catalog("spreadsheets.axis");
+  std::string name;
+  while (getline(catalog, name))
+  {
+    if (name != "" && file_size(name + ".axissheet") > 0 && file_size(name + ".axissnap") > 0)
+      names.push_back(name);
+  }
+  if (names.empty())
+  {
+    std::cerr << "No spreadsheet here has both snapshots; run snapshot_convert first" << std::endl;
+    return 1;
+  }
+
+  format_timing text = { 1e300, 1e300, 0 };
+  format_timing binary = { 1e300, 1e300, 0 };
+  size_t cells = 0;
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    text.bytes += file_size(names[i] + ".axissheet");
+    binary.bytes += file_size(names[i] + ".axissnap");
+  }
+
+  for (int round = 0; round < rounds; round++)
+  {
+    format_timing * formats[2] = { &text, &binary };
+    for (int f = 0; f < 2; f++)
+    {
+      size_t (*load)(std::string, spreadsheet *) = f == 0 ? load_text : load_binary;
+
+      double start = now_ms();
+      cells = 0;
+      for (size_t i = 0; i < names.size(); i++)
+        cells += load(names[i], NULL);
+      formats[f]->parse_ms = std::min(formats[f]->parse_ms, now_ms() - start);
+
+      start = now_ms();
+      for (size_t i = 0; i < names.size(); i++)
+      {
+        spreadsheet s(names[i]);
+        load(names[i], &s);
+      }
+      formats[f]->load_ms = std::min(formats[f]->load_ms, now_ms() - start);
+    }
+  }
+
+  int different = 0;
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    spreadsheet a(names[i]);
+    spreadsheet b(names[i]);
+    load_text(names[i], &a);
+    load_binary(names[i], &b);
+    if (!same_cells(&a, &b))
+      different++;
+  }
+
+  printf("%zu spreadsheets, %zu cells, best of %d rounds\n", names.size(), cells, rounds);
+  printf("%-8s %12s %12s %12s\n", "format", "bytes", "parse ms", "load ms");
+  printf("%-8s %12lld %12.1f %12.1f\n", "text", text.bytes, text.parse_ms, text.load_ms);
+  printf("%-8s %12lld %12.1f %12.1f\n", "binary", binary.bytes, binary.parse_ms, binary.load_ms);
+  printf("binary parses %.1fx and loads %.1fx as fast\n", text.parse_ms / binary.parse_ms, text.load_ms / binary.load_ms);
+  if (different > 0)
+    printf("%d spreadsheets loaded differently!\n", different);
+  return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*
+ * Filename: snapshot_convert.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+/*
+ * Description: Converts the text snapshots (<name>.axissheet) of every spreadsheet
+ *   listed in spreadsheets.axis to binary snapshots (<name>.axissnap), which the
+ *   server loads instead. Each binary snapshot is opened again and compared with the
+ *   text before the next is written. Run it in the server's directory, or pass that
+ *   directory, while the server is stopped; a spreadsheet that already has a binary
+ *   snapshot is left alone. With -r the text snapshots are removed once converted,
+ *   otherwise the server removes each one the next time it compacts that log.
+ *
+ *   Usage: snapshot_convert [-r] [directory]
+ */
+
+#include <fstream>
+#include <iostream>
+#include <stdio.h> // perror error message printing
+#include <string.h> // memcmp, strcmp
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sheet_log.h"
+#include "sheet_snapshot.h"
+
+/* Function: file_size
+ * Params: name of a file
+ * Return: its size in bytes, or -1 if it doesn't exist
+ */
+static long long file_size(std::string file_name)
+{
+  struct stat status;
+  if (stat(file_name.c_str(), &status) == -1)
+    return -1;
+  return status.st_size;
+}
+
+/* Function: convert
+ * Params: name of a spreadsheet, whether to remove its text snapshot, totals to add to
+ * Return: 1 if it was converted, 0 if there was nothing to convert, -1 on failure
+ */
+static int convert(std::string name, bool remove_text, long long * cells, long long * text_bytes, long long * binary_bytes)
+{
+  std::string text_name = name + ".axissheet";
+  std::string binary_name = name + ".axissnap";
+  long long text_size = file_size(text_name);
+  if (text_size == -1 || file_size(binary_name) != -1)
+    return 0;
+
+  std::vector<std::pair<std::string, std::string> > records;
+  std::vector<snapshot_cell> saved;
+  sheet_log::read_records(text_name, records, false);
+  sheet_log::to_snapshot_cells(records, saved);
+  if (!sheet_snapshot::write(binary_name, saved))
+    return -1;
+
+  // saved is sorted by coordinates now, as the snapshot's index is
+  sheet_snapshot * snapshot = sheet_snapshot::open(binary_name);
+  std::vector<snapshot_cell> loaded;
+  if (snapshot != NULL)
+    snapshot->get_cells(loaded);
+
+  bool same = snapshot != NULL && loaded.size() <= saved.size();
+  size_t next = 0;
+  for (size_t i = 0; same && i < saved.size(); i++)
+  {
+    // Of a cell listed more than once, only the last contents are kept
+    if (i + 1 < saved.size() && saved[i + 1].coord == saved[i].coord)
+      continue;
+    same = next < loaded.size() && loaded[next].coord == saved[i].coord && loaded[next].length == saved[i].length &&
+           memcmp(loaded[next].contents, saved[i].contents, saved[i].length) == 0;
+    next++;
+  }
+  same = same && next == loaded.size();
+  delete snapshot;
+
+  if (!same)
+  {
+    std::cerr << binary_name << " doesn't match " << text_name << "; removed it" << std::endl;
+    unlink(binary_name.c_str());
+    return -1;
+  }
+
+  if (remove_text && unlink(text_name.c_str()) == -1)
+    perror("snapshot_convert unlink");
+
+  *cells += loaded.size();
+  *text_bytes += text_size;
+  *binary_bytes += file_size(binary_name);
+  return 1;
+}
+
+/* Function: main
+ * Params: number of arguments, string arguments
+ * Return: 0 if every spreadsheet was converted or had nothing to convert, 1 otherwise
+ */
+int main(int argc, char* argv[])
+{
+  bool remove_text = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-r") == 0)
+      remove_text = true;
+    else if (chdir(argv[i]) == -1)
+    {
+      perror(argv[i]);
+      return 1;
+    }
+  }
+
+  std::ifstream catalog("spreadsheets.axis");
+  if (!catalog.is_open())
+  {
+    std::cerr << "No spreadsheets.axis here" << std::endl;
+    return 1;
+  }
+
+  int converted = 0;
+  int skipped = 0;
+  int failed = 0;
+  long long cells = 0;
+  long long text_bytes = 0;
+  long long binary_bytes = 0;
+  std::string name;
+  while (getline(catalog, name))
+  {
+    if (name == "")
+      continue;
+
+    int result = convert(name, remove_text, &cells, &text_bytes, &binary_bytes);
+    if (result == 1)
+      converted++;
+    else if (result == 0)
+      skipped++;
+    else
+      failed++;
+  }
+
+  std::cout << "Converted " << converted << " spreadsheets (" << cells << " cells, " << text_bytes
+            << " bytes of text to " << binary_bytes << " bytes), skipped " << skipped << ", failed " << failed
+            << "." << std::endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -5,35 +5,45 @@
  */
 
 #include "spreadsheet.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h> // NAN
+#include <stdio.h> // snprintf
+#include <stdlib.h> // strtod
+#include <string.h> // memcpy, memset
 
 /* Constructor
  *
  * Parameter: name of spreadsheet
  * Simply sets the name and clears all data in the map storage
  */
-spreadsheet::spreadsheet(std::string name)
+spreadsheet::spreadsheet(std::string name) : sheet_lock(HISTOGRAM_SHEET_LOCK_WAIT, HISTOGRAM_SHEET_LOCK_HOLD)
 {
   this->name = name;
-  data = new std::map<std::string, std::string>();
-  data->clear();
-  
-  dependencies = new std::map<std::string, std::vector<std::string> >();
-  dependencies->clear();
+  arena = new sheet_arena();
+  data = new cell_store(arena);
 
-  changes = new std::stack<cellChange>();
+  epoch = 0;
+
+  memset(&changes, 0, sizeof(changes));
+  memset(&undone, 0, sizeof(undone));
+  journal = NULL;
+  snapshot = NULL;
 }
 
 /* Function: spreadsheet destructor
  * Params: none
  * Return: void
  *
- * Description: Destroys all data structures stored on heap
+ * Description: Destroys all data structures stored on heap. Undo records and
+ *              dependency lists go with the arena, without being walked.
  */
 spreadsheet::~spreadsheet()
 {
   delete data;
-  delete dependencies;
-  delete changes;
+  delete arena;
+  delete journal;
+  delete snapshot;
 }
 
 /* Function: get_name
@@ -46,14 +56,95 @@ std::string spreadsheet::get_name()
   return this->name;
 }
 
-/* Function: get_data_map
+/* Function: for_each_cell
  *
- * Parameter: none
- * Returns map of spreadsheet data
+ * Parameter: function to call with the coordinates and contents of each cell, context passed to it
+ * Calls the function for every cell with contents. The spreadsheet must not be edited until it returns.
+ */
+void spreadsheet::for_each_cell(cell_store::cell_visitor visit, void * context)
+{
+  data->for_each(visit, context);
+}
+
+/* Function: copy_cell
+ * Params: coordinates and contents of a cell, vector of cells to add it to
+ * Return: void
+ */
+static void copy_cell(cell_coord coord, const char * contents, size_t length, void * context)
+{
+  std::vector<std::pair<std::string, std::string> > * cells = (std::vector<std::pair<std::string, std::string> > *)context;
+  cells->push_back(std::make_pair(cell_name(coord), std::string(contents, length)));
+}
+
+/* Function: get_cells
+ *
+ * Parameter: vector to store the cells
+ * Fills in the name and contents of every cell with contents
+ */
+void spreadsheet::get_cells(std::vector<std::pair<std::string, std::string> > & cells)
+{
+  cells.clear();
+  cells.reserve(data->size());
+  data->for_each(copy_cell, &cells);
+}
+
+/* Class: cell_copy
+ *
+ * Description: Where copy_cells() is copying cells to
+ */
+class cell_copy
+{
+ public:
+  std::string * bytes;
+  std::vector<snapshot_cell> * cells;
+  size_t used;  //Bytes filled so far
+};
+
+/* Function: add_length
+ * Params: a cell, the byte count to add its contents and their '\0' to
+ * Return: void
+ */
+static void add_length(cell_coord, const char *, size_t length, void * context)
+{
+  (*(size_t *)context) += length + 1;
+}
+
+/* Function: copy_to_buffer
+ * Params: coordinates and contents of a cell, cell_copy to add it to
+ * Return: void
  */
-std::map<std::string, std::string>* spreadsheet::get_data_map() 
+static void copy_to_buffer(cell_coord coord, const char * contents, size_t length, void * context)
 {
-  return this->data;
+  cell_copy * copy = (cell_copy *)context;
+  snapshot_cell cell;
+  cell.coord = coord;
+  cell.contents = &(*copy->bytes)[copy->used];
+  cell.length = length;
+  memcpy(&(*copy->bytes)[copy->used], contents, length);
+  copy->used += length + 1;
+  copy->cells->push_back(cell);
+}
+
+/* Function: copy_cells
+ *
+ * Parameter: buffer to copy the contents to, vector to store the cells (pointing into the buffer)
+ * Copies every cell with contents for a snapshot, each followed by '\0'. The buffer is sized
+ * first, so the copy makes two allocations however many cells there are, keeping the time the
+ * caller holds the sheet's lock for to a walk and a memcpy of the contents.
+ */
+void spreadsheet::copy_cells(std::string & bytes, std::vector<snapshot_cell> & cells)
+{
+  size_t total = 0;
+  data->for_each(add_length, &total);
+
+  bytes.assign(total, '\0');
+  cells.clear();
+  cells.reserve(data->size());
+  cell_copy copy;
+  copy.bytes = &bytes;
+  copy.cells = &cells;
+  copy.used = 0;
+  data->for_each(copy_to_buffer, &copy);
 }
 
 /* Function: get_cell
@@ -64,123 +155,955 @@ std::map<std::string, std::string>* spreadsheet::get_data_map()
  */
 std::string spreadsheet::get_cell(std::string cellName)
 {
-  if(data->count(cellName) != 0)
+  cell_coord coord;
+  const char * contents;
+  size_t length;
+  if(parse_cell_name(cellName.data(), cellName.data() + cellName.size(), &coord) && data->get(coord, &contents, &length))
   {
-    return (*data)[cellName];
+    return std::string(contents, length);
   }
   return "";
 }
 
-/* Function: has_circular_dependency
- * Parameters: check if c1 depends on c2
- * 
- * Return: 1 if there exists a dependency, 0 otherwise
+/* Function: intern
+ * Parameters: coordinates of a cell
+ *
+ * Return: the id of the cell, assigning the next free one (and evaluating its contents) if it has none yet
  */
-int spreadsheet::has_dependency(std::string c1, std::string c2)
+int spreadsheet::intern(cell_coord coord)
 {
-  if((*dependencies).count(c2) != 0)
+  std::map<cell_coord, int>::iterator it = cell_ids.find(coord);
+  if(it != cell_ids.end())
+    return it->second;
+
+  int id = cell_coords.size();
+  id_list none = { NULL, 0, 0 };
+  cell_ids.insert(std::make_pair(coord, id));
+  cell_coords.push_back(coord);
+  dependencies.push_back(none);
+  dependents.push_back(none);
+  visited.push_back(0);
+  formulas.push_back(std::shared_ptr<const formula>());
+  values.push_back(cell_value());
+  evaluate(id);
+  return id;
+}
+
+/* Function: next_epoch
+ * Parameters: none
+ *
+ * Return: the mark of a new search; cells whose visited entry holds it were reached by this search
+ */
+unsigned int spreadsheet::next_epoch()
+{
+  if(++epoch == 0)
+  {
+    // The epoch wrapped; forget every old mark so none can match by accident
+    std::fill(visited.begin(), visited.end(), 0);
+    epoch = 1;
+  }
+  return epoch;
+}
+
+/* Function: has_dependency
+ * Parameters: cell to look for, cells to start from
+ *
+ * Return: 1 if the cell is one of the starting cells or one of them depends on it, 0 otherwise
+ * Note: iterative depth-first search over the forward edges. Every cell is visited
+ *       at most once per call, so the check is O(V+E) even on diamond-shaped graphs.
+ */
+int spreadsheet::has_dependency(int cell, const std::vector<int> & starts)
+{
+  unsigned int mark = next_epoch();
+
+  search.clear();
+  for(std::vector<int>::const_iterator it = starts.begin(); it != starts.end(); it++)
   {
-    for(std::vector<std::string>::iterator it = (*dependencies)[c2].begin(); it != (*dependencies)[c2].end(); it++)
+    if(visited[*it] != mark)
     {
-      if(*it == c1) { return 1; }
-      if(has_dependency(c1, *it)) { return 1; } 
+      visited[*it] = mark;
+      search.push_back(*it);
+    }
+  }
+
+  while(!search.empty())
+  {
+    int current = search.back();
+    search.pop_back();
+    if(current == cell)
+      return 1;
+
+    id_list & next = dependencies[current];
+    for(int i = 0; i < next.count; i++)
+    {
+      if(visited[next.ids[i]] != mark)
+      {
+        visited[next.ids[i]] = mark;
+        search.push_back(next.ids[i]);
+      }
     }
   }
 
   return 0;
 }
 
+/* Function: closes_cycle
+ * Parameters: cells whose edges just changed
+ *
+ * Return: 1 if a cell reachable from them relies on itself, 0 otherwise
+ * Note: iterative depth-first search over the forward edges, shared by all the starting
+ *       cells, so each cell is visited at most once however many start. A cell is marked
+ *       entered while it is on the search's path and left once everything it relies on
+ *       has been searched; reaching an entered cell again means the path loops. A graph
+ *       that had no cycle before only gains one through an edge that changed, so
+ *       searching from the changed cells finds it.
+ */
+int spreadsheet::closes_cycle(const std::vector<int> & starts)
+{
+  unsigned int entered = next_epoch();
+  unsigned int left = next_epoch();
+
+  for(std::vector<int>::const_iterator it = starts.begin(); it != starts.end(); it++)
+  {
+    if(visited[*it] == entered || visited[*it] == left)
+      continue;
+
+    walk.clear();
+    visited[*it] = entered;
+    walk.push_back(std::make_pair(*it, 0));
+    while(!walk.empty())
+    {
+      int current = walk.back().first;
+      id_list & next = dependencies[current];
+      if(walk.back().second < next.count)
+      {
+        int depend = next.ids[walk.back().second++];
+        if(visited[depend] == entered)
+          return 1;
+        if(visited[depend] != left)
+        {
+          visited[depend] = entered;
+          walk.push_back(std::make_pair(depend, 0));
+        }
+      }
+      else
+      {
+        visited[current] = left;
+        walk.pop_back();
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Function: set_dependencies
+ * Parameters: id of the cell, ids of the cells it now relies on (no duplicates)
+ *
+ * Return: void
+ * Note: only the edges of this cell are touched; its old targets drop it
+ *       from their dependents and its new targets gain it.
+ */
+void spreadsheet::set_dependencies(int cell, const std::vector<int> & depends)
+{
+  id_list & old_depends = dependencies[cell];
+  for(int i = 0; i < old_depends.count; i++)
+    dependents[old_depends.ids[i]].remove(cell);
+
+  for(std::vector<int>::const_iterator it = depends.begin(); it != depends.end(); it++)
+    dependents[*it].push_back(cell, arena);
+
+  old_depends.assign(depends.data(), depends.size(), arena);
+}
+
 /* Function: set_cell
  *
  * parameters: the name of the cell and the contents you want associated with it
- * Returns: 0 if there was a circular dependency or 1 otherwise
+ * Returns: 0 if there was a circular dependency, -1 if the name isn't a cell (like A1 or AA10), or 1 otherwise
  */
-int spreadsheet::set_cell(std::string cellName, std::string cellContents)
+int spreadsheet::set_cell(const text_view & cellName, const text_view & cellContents)
 {
+  cell_coord coord;
+  if(!parse_cell_name(cellName.data, cellName.data + cellName.length, &coord))
+    return -1;
+  return apply(coord, cellContents.data, cellContents.length, true);
+}
+
+/* Function: set_cells
+ *
+ * parameters: names and contents of the cells to set, in order (a cell may appear more than once;
+ *             the last contents win), where to store the index of the first bad name
+ * Returns: 0 if the cells together would make a circular dependency, -1 if a name isn't a cell,
+ *          or 1 otherwise
+ * Note: all of the cells are set or none are. They are checked for cycles together, so
+ *       the cells may refer to each other in any order, and one undo puts all of them back.
+ */
+int spreadsheet::set_cells(const std::vector<std::pair<text_view, text_view> > & cells, size_t * bad_cell)
+{
+  batch_coords.clear();
+  batch_contents.clear();
+  for(size_t i = 0; i < cells.size(); i++)
+  {
+    cell_coord coord;
+    const text_view & cellName = cells[i].first;
+    if(!parse_cell_name(cellName.data, cellName.data + cellName.length, &coord))
+    {
+      *bad_cell = i;
+      return -1;
+    }
+    batch_coords.push_back(coord);
+    batch_contents.push_back(cells[i].second);
+  }
+
+  if(!apply_batch(batch_coords, batch_contents, &changes))
+    return 0;
+  undone.clear(arena);
+  return 1;
+}
+
+/* Function: apply
+ *
+ * parameters: coordinates of the cell, its new contents and their length, whether to record the change for undo
+ * Returns: 0 if there was a circular dependency, or 1 otherwise
+ * Note: allocates nothing once the scratch space, arena and formula cache are warm,
+ *       unless the cell is new to the store or the dependency graph
+ */
+int spreadsheet::apply(cell_coord coord, const char * contents, size_t length, bool record)
+{
+  int cell;
+  if(!place(coord, contents, length, true, record, false, &cell))
+    return 0;
+
+  if(cell >= 0)
+    recalculate(&cell, 1);
+  else
+    recalculated.assign(1, coord); //Nothing relies on it, so only its own value changed
+  return 1;
+}
+
+/* Function: apply_batch
+ *
+ * parameters: coordinates of the cells, their new contents, ring to record what they held
+ *             in as one group (NULL to record nothing)
+ * Returns: 0 if the cells together would make a circular dependency (nothing changed), or 1 otherwise
+ * Note: every cell is placed without a check, then one search from the cells in the
+ *       dependency graph looks for a cycle; if there is one, the cells get their old
+ *       contents back (in reverse, so a cell set twice ends up as it began). Otherwise
+ *       what they held is recorded, oldest first, and one pass recalculates the cells
+ *       and everything that relies on any of them. Cells nothing relies on come first
+ *       in what it recalculated, then the rest in dependency order.
+ */
+int spreadsheet::apply_batch(const std::vector<cell_coord> & coords, const std::vector<text_view> & contents, change_ring * record)
+{
+  if(batch_previous.size() < coords.size())
+    batch_previous.resize(coords.size());
+  size_t ids_before = cell_coords.size();
+
+  int cell;
+  for(size_t i = 0; i < coords.size(); i++)
+  {
+    const char * old_contents = "";
+    size_t old_length = 0;
+    data->get(coords[i], &old_contents, &old_length);
+    batch_previous[i].assign(old_contents, old_length);
 
-  std::string originalContents = cellContents;
-  cellName[0] = toupper(cellName[0]);
-  std::vector<std::string> temp_depends;
+    place(coords[i], contents[i].data, contents[i].length, false, false, false, &cell);
+  }
 
+  // A formula placed late may have given a cell placed earlier an id
+  std::vector<cell_coord> edited;
+  batch_roots.clear();
+  for(size_t i = 0; i < coords.size(); i++)
+  {
+    std::map<cell_coord, int>::iterator id = cell_ids.find(coords[i]);
+    if(id != cell_ids.end())
+      batch_roots.push_back(id->second);
+    else
+      edited.push_back(coords[i]); //Nothing relies on it, so recalculate won't list it
+  }
+
+  if(closes_cycle(batch_roots))
+  {
+    for(size_t i = coords.size(); i-- > 0;)
+      place(coords[i], batch_previous[i].data(), batch_previous[i].size(), false, false, false, &cell);
+    //Cells given ids by the batch were evaluated with its contents; none holds a formula now
+    for(size_t id = ids_before; id < cell_coords.size(); id++)
+      evaluate(id);
+    return 0;
+  }
+
+  for(size_t i = 0; record != NULL && i < coords.size(); i++)
+    push_record(*record, coords[i], batch_previous[i].data(), batch_previous[i].size(), i > 0);
+
+  recalculate(batch_roots.data(), batch_roots.size());
+  recalculated.insert(recalculated.begin(), edited.begin(), edited.end());
+  return 1;
+}
+
+/* Function: place
+ *
+ * parameters: coordinates of the cell, its new contents and their length, whether to check
+ *             for a circular dependency, whether to record the change for undo, whether the
+ *             contents are in the open snapshot (and can be referred to), where to store
+ *             the cell's id (-1 if it has none)
+ * Returns: 0 if there was a circular dependency (nothing changed), or 1 otherwise
+ * Note: stores the contents and replaces the cell's edges in the dependency graph;
+ *       nothing is evaluated
+ */
+int spreadsheet::place(cell_coord coord, const char * contents, size_t length, bool check, bool record, bool mapped, int * cell)
+{
   //Erase white space
-  std::string::size_type position = 0;
-  while((position = cellContents.find(" ", position)) != std::string::npos)
+  stripped.clear();
+  for(size_t i = 0; i < length; i++)
   {
-    cellContents.erase(position, 1);
+    if(contents[i] != ' ')
+      stripped += contents[i];
   }
 
   //Check for contents
-  if(cellContents[0] == '=')
+  if(!stripped.empty() && stripped[0] == '=')
   {
-    //Get all instances of cell names
+    //Compile the formula; its references are all instances of cell names
     //Check if would cause circular dependency
     //Set cell contents or don't and return 1 or 0, respectively
-    boost::regex reg("[a-zA-Z][1-9][1-9]?");
-    
-    boost::sregex_token_iterator it(cellContents.begin(), cellContents.end(), reg, 0);
-    boost::sregex_token_iterator end;
+    std::shared_ptr<const formula> compiled = formula::compile(stripped.data() + 1, stripped.size() - 1, formula_key);
 
-    std::string t;
-    for( ; it != end; ++it)
+    const std::vector<cell_coord> & references = compiled->get_references();
+    new_depends.clear();
+    for(std::vector<cell_coord>::const_iterator it = references.begin(); it != references.end(); it++)
     {
-      t = *it;
-      t[0] = toupper(t[0]); //Convert to uppercase
-	
-      temp_depends.push_back(t);
+      new_depends.push_back(intern(*it));
     }
 
-    for(std::vector<std::string>::iterator itt = temp_depends.begin(); itt != temp_depends.end(); itt++)
+    //Circular if the cell is reachable from anything it would rely on
+    *cell = intern(coord);
+    if(check && has_dependency(*cell, new_depends))
+      return 0;
+    
+    if(record)
     {
-      if(*itt == cellName)
-	return 0;
-
-      if(has_dependency(cellName, *itt)) 
-	 return 0;
+      push_change(changes, coord);
+      undone.clear(arena);
     }
-    
-    cellChange c(cellName, (*data)[cellName]);
-    (*data)[cellName] = cellContents;
-    (*dependencies)[cellName] = temp_depends;
-    changes->push(c);
+    if(mapped && stripped.size() == length)
+      data->refer(coord, contents, length); //Saved formulas are already stripped
+    else
+      data->set(coord, stripped.data(), stripped.size());
+    set_dependencies(*cell, new_depends);
+    formulas[*cell] = compiled;
     return 1;
   }
 
   //Case of it not being an equation
   //make cell dependent on nothing
   //Set cell contents and return 1
-  if((*dependencies).count(cellName) != 0)
-    (*dependencies).erase(cellName);
-  
-  cellChange c(cellName, (*data)[cellName]);
-  changes->push(c);
-  (*data)[cellName] = originalContents;
+  if(record)
+  {
+    push_change(changes, coord);
+    undone.clear(arena);
+  }
+  if(mapped)
+    data->refer(coord, contents, length);
+  else
+    data->set(coord, contents, length);
+
+  *cell = -1;
+  std::map<cell_coord, int>::iterator id = cell_ids.find(coord);
+  if(id != cell_ids.end())
+  {
+    *cell = id->second;
+    new_depends.clear();
+    set_dependencies(*cell, new_depends);
+    formulas[*cell].reset();
+  }
 
   return 1;
 }
 
+/* Function: push_change
+ * Parameters: ring to record in, coordinates of the cell about to change
+ *
+ * Return: void
+ * Note: copies the cell's current contents into a new record of its own
+ */
+void spreadsheet::push_change(change_ring & ring, cell_coord coord)
+{
+  const char * contents = "";
+  size_t length = 0;
+  data->get(coord, &contents, &length);
+  push_record(ring, coord, contents, length, false);
+}
+
+/* Function: push_record
+ * Parameters: ring to record in, coordinates of a cell, the contents to record and their
+ *             length, whether the record is reverted together with the one before it
+ *
+ * Return: void
+ * Note: a full undo history spills its oldest records to the journal, or forgets them
+ *       if there is none; redo history just forgets its furthest changes. A group cut
+ *       short that way can only be reverted as far as its records go.
+ */
+void spreadsheet::push_record(change_ring & ring, cell_coord coord, const char * contents, size_t length, bool joined)
+{
+  while(ring.count > 0 && (ring.count >= UNDO_MAX_ENTRIES || ring.bytes + change_ring::cost(length) > UNDO_MAX_BYTES))
+  {
+    if(&ring == &changes && journal != NULL && spill(UNDO_SPILL_BATCH) > 0)
+      continue;
+    ring.pop_oldest(arena);
+    if(ring.count > 0)
+      ring.at(0).joined = false;
+  }
+
+  ring.push(coord, contents, length, joined && ring.count > 0, arena);
+}
+
+/* Function: spill
+ * Parameters: most records to spill
+ *
+ * Return: number of records moved from the undo ring to the journal
+ * Note: the oldest records go, in one write; they are newer than anything already in the journal
+ */
+int spreadsheet::spill(int records)
+{
+  if(journal == NULL)
+    return 0;
+  if(records > changes.count)
+    records = changes.count;
+
+  std::vector<std::pair<std::string, std::string> > spilled;
+  spilled.reserve(records);
+  for(int age = 0; age < records; age++)
+  {
+    cellChange & c = changes.at(age);
+    std::string name = ::cell_name(c.cell);
+    if(c.joined)
+      name.insert(name.begin(), JOINED_RECORD_MARK);
+    spilled.push_back(std::make_pair(name, std::string(c.contents.data(), c.contents.size())));
+  }
+  if(!journal->push(spilled))
+    return 0;
+
+  for(int age = 0; age < records; age++)
+    changes.pop_oldest(arena);
+  return records;
+}
+
+/* Function: recalculate
+ * Parameters: ids of the cells that changed, how many
+ *
+ * Return: void
+ * Note: finds the cells and everything that depends on them with an iterative
+ *       depth-first search over the reverse edges, shared by all of them. A cell
+ *       is finished once all of its dependents are, so the reverse of the finishing
+ *       order evaluates every cell once, after everything it relies on. Nothing
+ *       else is evaluated.
+ */
+void spreadsheet::recalculate(const int * cells, size_t count)
+{
+  unsigned int mark = next_epoch();
+  finished.clear();
+
+  for(size_t i = 0; i < count; i++)
+  {
+    if(visited[cells[i]] == mark)
+      continue;
+    walk.clear();
+    visited[cells[i]] = mark;
+    walk.push_back(std::make_pair(cells[i], 0));
+    while(!walk.empty())
+    {
+      int current = walk.back().first;
+      id_list & next = dependents[current];
+      if(walk.back().second < next.count)
+      {
+        int dependent = next.ids[walk.back().second++];
+        if(visited[dependent] != mark)
+        {
+          visited[dependent] = mark;
+          walk.push_back(std::make_pair(dependent, 0));
+        }
+      }
+      else
+      {
+        finished.push_back(current);
+        walk.pop_back();
+      }
+    }
+  }
+
+  recalculated.clear();
+  for(std::vector<int>::reverse_iterator it = finished.rbegin(); it != finished.rend(); it++)
+  {
+    evaluate(*it);
+    recalculated.push_back(cell_coords[*it]);
+  }
+}
+
+/* Function: parse_number
+ * Parameters: contents of a cell (followed by '\0') and their length, where to store the number
+ *
+ * Return: 1 if the whole contents are a number (surrounding whitespace allowed), 0 otherwise
+ */
+static int parse_number(const char * contents, size_t length, double * number)
+{
+  size_t start = 0;
+  while(start < length && isspace((unsigned char)contents[start]))
+    start++;
+
+  //Only plain decimal numbers; strtod would also take hex, inf and nan
+  size_t digit = start;
+  if(digit < length && (contents[digit] == '+' || contents[digit] == '-'))
+    digit++;
+  if(digit >= length || !(isdigit((unsigned char)contents[digit]) || contents[digit] == '.'))
+    return 0;
+  for(size_t i = digit; i < length; i++)
+  {
+    if(contents[i] == 'x' || contents[i] == 'X' || contents[i] == 'n' || contents[i] == 'N')
+      return 0;
+  }
+
+  const char * begin = contents + start;
+  char * end;
+  double value = strtod(begin, &end);
+  if(end == begin)
+    return 0;
+  while(*end != '\0' && isspace((unsigned char)*end))
+    end++;
+  if(end != contents + length)
+    return 0;
+
+  *number = value;
+  return 1;
+}
+
+/* Function: classify
+ * Parameters: contents of a cell that holds no formula, where to store its value
+ *
+ * Return: void
+ * Note: empty contents are empty, numbers are numbers and anything else is text
+ */
+static void classify(const char * contents, size_t length, int * kind, double * number)
+{
+  *number = 0;
+  if(length == 0)
+    *kind = VALUE_EMPTY;
+  else if(parse_number(contents, length, number))
+    *kind = VALUE_NUMBER;
+  else
+    *kind = VALUE_TEXT;
+}
+
+/* Function: format_value
+ * Parameters: kind of value, why it is an error, its number, the cell's contents
+ *
+ * Return: the value as it is sent to clients; errors read like "#DIV/0!"
+ */
+static std::string format_value(int kind, int error, double number, const char * contents, size_t length)
+{
+  switch(kind)
+  {
+    case VALUE_NUMBER:
+    {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.15g", number);
+      return buffer;
+    }
+    case VALUE_TEXT:
+      return std::string(contents, length);
+    case VALUE_ERROR:
+      if(error == FORMULA_DIV_ZERO)
+        return "#DIV/0!";
+      if(error == FORMULA_BAD_REF)
+        return "#REF!";
+      if(error == FORMULA_BAD_NUMBER)
+        return "#NUM!";
+      return "#FORMULA!";
+  }
+  return "";
+}
+
+/* Function: evaluate
+ * Parameters: id of the cell
+ *
+ * Return: void
+ * Note: every cell the formula relies on must already be evaluated. As in the
+ *       client, a reference to an empty cell, text or an error is an error,
+ *       except that a function's range skips empty cells and text.
+ */
+void spreadsheet::evaluate(int cell)
+{
+  cell_value & value = values[cell];
+  value.error = FORMULA_OK;
+  value.number = 0;
+
+  if(formulas[cell])
+  {
+    value.kind = VALUE_ERROR;
+    if(!formulas[cell]->valid())
+    {
+      value.error = FORMULA_BAD_SYNTAX;
+      return;
+    }
+
+    //Errors spread; cells without a number are left for the formula to judge
+    id_list & depends = dependencies[cell];
+    arguments.clear();
+    for(int i = 0; i < depends.count; i++)
+    {
+      cell_value & argument = values[depends.ids[i]];
+      if(argument.kind == VALUE_ERROR)
+      {
+        value.error = FORMULA_BAD_REF;
+        return;
+      }
+      arguments.push_back(argument.kind == VALUE_NUMBER ? argument.number : NAN);
+    }
+
+    value.error = formulas[cell]->evaluate(arguments, evaluation, &value.number);
+    if(value.error == FORMULA_OK)
+      value.kind = VALUE_NUMBER;
+    return;
+  }
+
+  const char * contents = "";
+  size_t length = 0;
+  data->get(cell_coords[cell], &contents, &length);
+
+  int kind;
+  classify(contents, length, &kind, &value.number);
+  value.kind = kind;
+}
+
+/* Function: get_value
+ *
+ * Parameter: name of cell whose value you want returned
+ * Returns the computed value of the cell: its number, its text, or an error
+ * Note: returns "" if the cell is empty or the name isn't a cell
+ */
+std::string spreadsheet::get_value(std::string cellName)
+{
+  cell_coord coord;
+  if(!parse_cell_name(cellName.data(), cellName.data() + cellName.size(), &coord))
+    return "";
+  return get_value(coord);
+}
+
+/* Function: get_value
+ *
+ * Parameter: coordinates of the cell whose value you want returned
+ * Returns the computed value of the cell. Cells outside the dependency graph
+ * hold no formula, so their value comes straight from their contents.
+ */
+std::string spreadsheet::get_value(cell_coord coord)
+{
+  const char * contents = "";
+  size_t length = 0;
+  data->get(coord, &contents, &length);
+
+  std::map<cell_coord, int>::iterator it = cell_ids.find(coord);
+  if(it != cell_ids.end())
+  {
+    cell_value & value = values[it->second];
+    return format_value(value.kind, value.error, value.number, contents, length);
+  }
+
+  int kind;
+  double number;
+  classify(contents, length, &kind, &number);
+  return format_value(kind, FORMULA_OK, number, contents, length);
+}
+
+/* Function: get_recalculated
+ *
+ * Parameter: vector to store the results
+ * Fills in the name and new value of every cell the last successful edit or undo
+ * evaluated, starting with the edited cell, each after the cells it relies on
+ */
+void spreadsheet::get_recalculated(std::vector<std::pair<std::string, std::string> > & values)
+{
+  values.clear();
+  for(std::vector<cell_coord>::iterator it = recalculated.begin(); it != recalculated.end(); it++)
+    values.push_back(std::make_pair(cell_name(*it), get_value(*it)));
+}
+
 //NOTE: returns integer 1 if it worked or 0 if it didn't
-//Returns the cell name and cell changes so that we know what to send back to the other clients
-int spreadsheet::undo( std::string * cell_name, std::string * cell_change )
+//Returns the cell names and cell changes so that we know what to send back to the other clients
+int spreadsheet::undo( std::vector<std::pair<std::string, std::string> > & changed )
 {
-  if(!changes->empty())
+  return revert(changes, undone, changed);
+}
+
+/* Function: redo
+ *
+ * Parameter: where to store the names and new contents of the cells that changed
+ * Returns 1 if an undone edit was made again, 0 if there was none (or it now causes a circular dependency)
+ * Note: any edit other than undo and redo empties the redo history
+ */
+int spreadsheet::redo( std::vector<std::pair<std::string, std::string> > & changed )
+{
+  return revert(undone, changes, changed);
+}
+
+/* Function: revert
+ *
+ * Parameters: ring to take the newest group of records from, ring to record the cells' current
+ *             contents in, where to store the names and new contents of the cells, in the
+ *             order they were set
+ * Returns 1 if the records were applied, 0 if there were none or they cause a circular dependency
+ * Note: a group is the newest record and every record joined to it, and is applied at once
+ *       like set_cells, newest first, so each cell ends up as it was before the group's edit.
+ *       The undo history falls back on the journal once its ring is empty, even halfway
+ *       through a group. The records are used up either way, as undo always has been.
+ */
+int spreadsheet::revert(change_ring & from, change_ring & to, std::vector<std::pair<std::string, std::string> > & changed)
+{
+  changed.clear();
+  batch_coords.clear();
+
+  bool joined = true;
+  while(joined)
   {
-    cellChange c = changes->top();
-    changes->pop();
-    (*cell_name) = c.cell_name;
-    (*cell_change) = c.cell_change;
-    
-    if(set_cell(c.cell_name, c.cell_change))
+    cell_coord coord;
+    std::string name, contents;
+    if(from.count > 0)
     {
-      changes->pop();
-      return 1;
+      cellChange & c = from.newest();
+      coord = c.cell;
+      joined = c.joined;
+      name = ::cell_name(coord);
+      contents.assign(c.contents.data(), c.contents.size());
+      from.pop_newest(arena);
+    }
+    else if(&from == &changes && journal != NULL && journal->pop(&name, &contents))
+    {
+      joined = !name.empty() && name[0] == JOINED_RECORD_MARK;
+      if(joined)
+        name.erase(0, 1);
+      if(!parse_cell_name(name.data(), name.data() + name.size(), &coord))
+        break;
     }
+    else
+      break;
+
+    changed.push_back(std::make_pair(name, contents));
+    batch_coords.push_back(coord);
   }
 
-  (*cell_name) = "";
-  (*cell_change) = "";
+  if(changed.empty())
+    return 0;
+
+  batch_contents.clear();
+  for(size_t i = 0; i < changed.size(); i++)
+    batch_contents.push_back(text_view(changed[i].second));
+
+  if(apply_batch(batch_coords, batch_contents, &to))
+    return 1;
+
+  changed.clear();
   return 0;
 }
 
+/* Function: load_cell
+ *
+ * Parameters: the name of the cell and its contents
+ * Returns: same as set_cell
+ * Note: nothing is recorded for undo, so loading a saved spreadsheet can't be undone cell by cell
+ */
+int spreadsheet::load_cell(const std::string & cellName, const std::string & cellContents)
+{
+  cell_coord coord;
+  if(!parse_cell_name(cellName.data(), cellName.data() + cellName.size(), &coord))
+    return -1;
+  return apply(coord, cellContents.data(), cellContents.size(), false);
+}
+
+/* Function: load_cells
+ *
+ * Parameters: cells in the order they were saved, whether their contents are in the open
+ *             snapshot (and are referred to instead of copied)
+ * Returns: number of cells set; a cell whose formula would be circular is left
+ *          out as set_cell would leave it
+ * Note: nothing is recorded for undo. Every cell is stored and wired into the
+ *       dependency graph first, without a cycle check or recalculation each;
+ *       then one topological pass over the whole graph evaluates every cell
+ *       after the cells it relies on. A saved spreadsheet has no cycles, but if
+ *       the pass finds some, only the cells on them can have been refused by
+ *       set_cell: those are cleared and set again in order with the usual check.
+ */
+int spreadsheet::load_cells(const std::vector<snapshot_cell> & cells, bool mapped)
+{
+  int set = cells.size();
+  int cell;
+  for(size_t i = 0; i < cells.size(); i++)
+    place(cells[i].coord, cells[i].contents, cells[i].length, false, false, mapped, &cell);
+
+  std::vector<int> waiting;
+  if(!evaluate_all(waiting, false))
+  {
+    std::vector<bool> cyclic;
+    find_cycles(waiting, cyclic);
+
+    new_depends.clear();
+    for(size_t id = 0; id < cyclic.size(); id++)
+    {
+      if(!cyclic[id])
+        continue;
+      set_dependencies(id, new_depends);
+      formulas[id].reset();
+      data->set(cell_coords[id], "", 0);
+    }
+    for(size_t i = 0; i < cells.size(); i++)
+    {
+      std::map<cell_coord, int>::iterator id = cell_ids.find(cells[i].coord);
+      if(id == cell_ids.end() || (size_t)id->second >= cyclic.size() || !cyclic[id->second])
+        continue;
+      if(!place(cells[i].coord, cells[i].contents, cells[i].length, true, false, mapped, &cell))
+        set--;
+    }
+    evaluate_all(waiting, true);
+  }
+
+  recalculated.clear();
+  return set;
+}
+
+/* Function: load_snapshot
+ *
+ * Parameters: snapshot of this spreadsheet, which it takes over; only one can be loaded
+ * Returns: same as load_cells
+ * Note: long contents are left in the snapshot's mapping until their cells are
+ *       next set, so the snapshot stays open as long as the spreadsheet
+ */
+int spreadsheet::load_snapshot(sheet_snapshot * opened)
+{
+  snapshot = opened;
+
+  std::vector<snapshot_cell> cells;
+  snapshot->get_cells(cells);
+  return load_cells(cells, true);
+}
+
+/* Function: evaluate_all
+ *
+ * Parameters: for every cell id, how many of the cells it relies on a previous pass left
+ *             unevaluated (replaced by this pass's counts); whether to evaluate only the
+ *             cells left then, instead of every cell
+ * Returns: true if every cell was evaluated, false if some are on or behind a cycle
+ * Note: Kahn's algorithm: a cell is evaluated once every cell it relies on has been,
+ *       so each is evaluated once, in O(V+E). The cells a pass leaves include
+ *       everything that relies on them, so another pass over just those is enough
+ *       once their cycles are broken.
+ */
+bool spreadsheet::evaluate_all(std::vector<int> & waiting, bool only_waiting)
+{
+  std::vector<bool> included(cell_coords.size(), true);
+  for(size_t cell = 0; only_waiting && cell < included.size(); cell++)
+    included[cell] = cell < waiting.size() && waiting[cell] != 0;
+
+  waiting.assign(cell_coords.size(), 0);
+  search.clear();
+  size_t remaining = 0;
+  for(size_t cell = 0; cell < waiting.size(); cell++)
+  {
+    if(!included[cell])
+      continue;
+    remaining++;
+    id_list & depends = dependencies[cell];
+    for(int i = 0; i < depends.count; i++)
+    {
+      if(included[depends.ids[i]])
+        waiting[cell]++;
+    }
+    if(waiting[cell] == 0)
+      search.push_back(cell);
+  }
+
+  while(!search.empty())
+  {
+    int current = search.back();
+    search.pop_back();
+    evaluate(current);
+    remaining--;
+
+    id_list & next = dependents[current];
+    for(int i = 0; i < next.count; i++)
+    {
+      if(--waiting[next.ids[i]] == 0)
+        search.push_back(next.ids[i]);
+    }
+  }
+  return remaining == 0;
+}
+
+/* Function: find_cycles
+ *
+ * Parameters: what evaluate_all left waiting, where to store for every cell id whether it is kept as possibly on a cycle
+ * Returns: void
+ * Note: of the cells left waiting, those with no waiting dependents are peeled
+ *       off repeatedly; what remains is every cell on a cycle, and at most a few
+ *       between cycles, but none merely behind one
+ */
+void spreadsheet::find_cycles(const std::vector<int> & waiting, std::vector<bool> & cyclic)
+{
+  std::vector<int> blocking(waiting.size(), 0); //Waiting dependents not yet peeled off
+  cyclic.assign(waiting.size(), false);
+  search.clear();
+  for(size_t cell = 0; cell < waiting.size(); cell++)
+  {
+    if(waiting[cell] == 0)
+      continue;
+    cyclic[cell] = true;
+    id_list & next = dependents[cell];
+    for(int i = 0; i < next.count; i++)
+    {
+      if(waiting[next.ids[i]] != 0)
+        blocking[cell]++;
+    }
+    if(blocking[cell] == 0)
+      search.push_back(cell);
+  }
+
+  while(!search.empty())
+  {
+    int current = search.back();
+    search.pop_back();
+    cyclic[current] = false;
+
+    id_list & depends = dependencies[current];
+    for(int i = 0; i < depends.count; i++)
+    {
+      if(cyclic[depends.ids[i]] && --blocking[depends.ids[i]] == 0)
+        search.push_back(depends.ids[i]);
+    }
+  }
+}
+
+/* Function: open_undo_journal
+ *
+ * Parameters: none
+ * Returns: void
+ * Note: from now on undo history that doesn't fit in memory is spilled to
+ *       <name>.axisundo, and history a previous run left there can be undone
+ */
+void spreadsheet::open_undo_journal()
+{
+  if(journal == NULL)
+    journal = new undo_journal(name);
+}
+
+/* Function: spill_undo
+ *
+ * Parameters: none
+ * Returns: number of records moved to the journal (0 without one)
+ * Note: called when the write-ahead log is compacted. The records of the edits the
+ *       log held are on disk from then on, and replaying the log after a restart
+ *       records the edits made since, so the history survives the restart in order.
+ */
+int spreadsheet::spill_undo()
+{
+  return spill(changes.count);
+}
+
 /* Function: num_cells
  * Params: none
  * Return: number of stored cells
@@ -189,7 +1112,68 @@ int spreadsheet::undo( std::string * cell_name, std::string * cell_change )
  */
 int spreadsheet::num_cells()
 {
-  return (*data).size();
+  return data->size();
+}
+
+/* Function: get_arena_stats
+ * Params: stats to fill in
+ * Return: void
+ *
+ * Description: Reports the memory held by this spreadsheet's arena: long contents,
+ *              dependency lists and undo records
+ */
+void spreadsheet::get_arena_stats(arena_stats * stats)
+{
+  arena->get_stats(stats);
+}
+
+/* Function: memory_used
+ * Params: none
+ * Return: estimated bytes held by this spreadsheet: its cells, its arena and the
+ *         per-cell entries of the dependency graph
+ */
+size_t spreadsheet::memory_used()
+{
+  arena_stats stats;
+  arena->get_stats(&stats);
+  size_t per_id = sizeof(cell_coord) + 2 * sizeof(id_list) + sizeof(unsigned int) +
+                  sizeof(std::shared_ptr<const formula>) + sizeof(cell_value) +
+                  4 * sizeof(void*) + sizeof(cell_coord) + sizeof(int); // cell_ids node
+  return sizeof(spreadsheet) + data->memory_used() + stats.reserved + stats.large_bytes + cell_coords.size() * per_id;
+}
+
+/* Function: lock
+ * Params: none
+ * Return: void
+ *
+ * Description: Locks this spreadsheet. Every read or edit of a spreadsheet that
+ *              other threads can reach must happen while holding its lock.
+ */
+void spreadsheet::lock()
+{
+  sheet_lock.lock();
+}
+
+/* Function: unlock
+ * Params: none
+ * Return: void
+ *
+ * Description: Unlocks this spreadsheet
+ */
+void spreadsheet::unlock()
+{
+  sheet_lock.unlock();
+}
+
+/* Function: print_cell
+ * Params: coordinates and contents of a cell, unused context
+ * Return: void
+ */
+static void print_cell(cell_coord coord, const char * contents, size_t length, void *)
+{
+  std::cout << "Cell: " << cell_name(coord) << " Contents: ";
+  std::cout.write(contents, length);
+  std::cout << std::endl;
 }
 
 /* Function: display_contents
@@ -201,21 +1185,164 @@ int spreadsheet::num_cells()
  */
 void spreadsheet::display_contents()
 {
-  for(std::map<std::string, std::string>::const_iterator it = (*data).begin(); it != (*data).end(); it++)
+  data->for_each(print_cell, NULL);
+}
+
+/* Function: push
+ * Params: cell, its contents before the change and their length, whether it is reverted
+ *         with the record before it, arena holding the ring
+ * Return: void
+ *
+ * Description: Moves the records to a block twice the size when the ring is full.
+ *              The caller keeps count below UNDO_MAX_ENTRIES.
+ */
+void spreadsheet::change_ring::push(cell_coord cell, const char * contents, size_t length, bool joined, sheet_arena * arena)
+{
+  if(count == capacity)
   {
-    //std::cout << "Cell: " << it->first << " Contents: " << it->second << std::endl;
+    int grown = capacity == 0 ? 64 : capacity * 2;
+    if(grown > UNDO_MAX_ENTRIES)
+      grown = UNDO_MAX_ENTRIES;
+    cellChange * block = (cellChange *)arena->allocate(grown * sizeof(cellChange));
+    for(int age = 0; age < count; age++)
+      memcpy(&block[age], &at(age), sizeof(cellChange));
+    arena->release(records, capacity * sizeof(cellChange));
+    records = block;
+    capacity = grown;
+    first = 0;
   }
+
+  cellChange & change = records[(first + count) % capacity];
+  change.cell = cell;
+  change.joined = joined;
+  memset(&change.contents, 0, sizeof(cell_text));
+  change.contents.assign(contents, length, arena);
+  count++;
+  bytes += cost(length);
 }
 
-/* Function: cellChange constructor
- * Params: cell name and contents
+/* Function: at
+ * Params: age of the record, 0 being the oldest
+ * Return: the record
+ */
+spreadsheet::cellChange & spreadsheet::change_ring::at(int age)
+{
+  return records[(first + age) % capacity];
+}
+
+/* Function: newest
+ * Params: none
+ * Return: the newest record; the ring must not be empty
+ */
+spreadsheet::cellChange & spreadsheet::change_ring::newest()
+{
+  return at(count - 1);
+}
+
+/* Function: pop_newest
+ * Params: arena holding the ring
+ * Return: void
+ */
+void spreadsheet::change_ring::pop_newest(sheet_arena * arena)
+{
+  cellChange & change = newest();
+  bytes -= cost(change.contents.size());
+  change.contents.release(arena);
+  count--;
+}
+
+/* Function: pop_oldest
+ * Params: arena holding the ring
+ * Return: void
+ */
+void spreadsheet::change_ring::pop_oldest(sheet_arena * arena)
+{
+  cellChange & change = at(0);
+  bytes -= cost(change.contents.size());
+  change.contents.release(arena);
+  first = (first + 1) % capacity;
+  count--;
+}
+
+/* Function: clear
+ * Params: arena holding the ring
  * Return: void
  *
- * Description: constructor for cellChange class, stores name and contents passed in
+ * Description: Drops every record but keeps the block for the next ones
+ */
+void spreadsheet::change_ring::clear(sheet_arena * arena)
+{
+  while(count > 0)
+    pop_newest(arena);
+  first = 0;
+}
+
+/* Function: cost
+ * Params: length of a record's contents
+ * Return: bytes the record holds: itself, plus an arena block for contents too long to keep inline
  */
-spreadsheet::cellChange::cellChange(std::string name, std::string change)
+long long spreadsheet::change_ring::cost(size_t length)
 {
-  this->cell_name = name;
-  this->cell_change = change;
+  return sizeof(cellChange) + (length >= sizeof(cell_text) ? length + 1 : 0);
 }
 
+/* Function: push_back
+ * Params: id to append, arena holding the list
+ * Return: void
+ *
+ * Description: Moves the ids to a block twice the size when the list is full
+ */
+void spreadsheet::id_list::push_back(int id, sheet_arena * arena)
+{
+  if(count == capacity)
+  {
+    int grown = capacity == 0 ? 4 : capacity * 2;
+    int * block = (int *)arena->allocate(grown * sizeof(int));
+    if(count > 0)
+      memcpy(block, ids, count * sizeof(int));
+    arena->release(ids, capacity * sizeof(int));
+    ids = block;
+    capacity = grown;
+  }
+  ids[count++] = id;
+}
+
+/* Function: remove
+ * Params: id to remove
+ * Return: void
+ *
+ * Description: Replaces one copy of the id with the last id, if the list holds it
+ */
+void spreadsheet::id_list::remove(int id)
+{
+  for(int i = 0; i < count; i++)
+  {
+    if(ids[i] == id)
+    {
+      ids[i] = ids[--count];
+      return;
+    }
+  }
+}
+
+/* Function: assign
+ * Params: ids to copy and their count, arena holding the list
+ * Return: void
+ *
+ * Description: Keeps the block if the ids fit, so re-entering a formula doesn't allocate
+ */
+void spreadsheet::id_list::assign(const int * source, int length, sheet_arena * arena)
+{
+  if(length > capacity)
+  {
+    int grown = capacity == 0 ? 4 : capacity;
+    while(grown < length)
+      grown *= 2;
+    arena->release(ids, capacity * sizeof(int));
+    ids = (int *)arena->allocate(grown * sizeof(int));
+    capacity = grown;
+  }
+  if(length > 0)
+    memcpy(ids, source, length * sizeof(int));
+  count = length;
+}
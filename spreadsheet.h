@@ -11,46 +11,183 @@
 #include <string>
 #include <map>
 #include <vector>
-#include <boost/regex.hpp>
-#include <stack>
 #include <iostream>
+#include <mutex>
+#include <memory>
+#include "cell_store.h"
+#include "formula.h"
+#include "metrics.h"
+#include "sheet_arena.h"
+#include "sheet_snapshot.h"
+#include "text_view.h"
+#include "undo_journal.h"
+
+// Undo history limits (override with -D at compile time). Past either, the oldest
+// records are spilled to the undo journal, or dropped if there is none.
+#ifndef UNDO_MAX_ENTRIES
+#define UNDO_MAX_ENTRIES 16384       // Undo records kept in memory per spreadsheet
+#endif
+#ifndef UNDO_MAX_BYTES
+#define UNDO_MAX_BYTES (4 << 20)     // Bytes those records may hold, long contents included
+#endif
+#ifndef UNDO_SPILL_BATCH
+#define UNDO_SPILL_BATCH 1024        // Records spilled to the journal per write when the ring is full
+#endif
+
+// Starts the cell name of a saved record (in a log or undo journal) that was made in
+// one batch with the record before it, and is applied or undone together with it
+#define JOINED_RECORD_MARK '+'
+
+// What kind of value a cell holds
+#define VALUE_EMPTY  0
+#define VALUE_NUMBER 1
+#define VALUE_TEXT   2 // Its contents, as typed
+#define VALUE_ERROR  3 // A formula that can't be evaluated
 
 /* Class: spreadsheet
  *
  * Description: Aggregate DS which stores the names and values of
  *              cells in a spreadsheet. Helper class for spreadsheet_server.
  *              Stores all dependencies to determine circular dependencies.
+ *              Formulas are compiled once when set and evaluated on the
+ *              server; an edit recalculates only the edited cell and the
+ *              cells that depend on it, in dependency order. Cells are
+ *              addressed by packed coordinates and their contents kept in a
+ *              cell_store; only cells that hold or feed a formula get an id
+ *              in the dependency graph. Long contents, dependency lists and
+ *              undo records live in the spreadsheet's own arena, and the
+ *              scratch space of an edit is kept between edits, so editing
+ *              cells in place doesn't touch the heap once the sheet is warm;
+ *              deleting the spreadsheet frees its arena in one go. Undo
+ *              history is bounded by UNDO_MAX_ENTRIES and UNDO_MAX_BYTES;
+ *              with a journal open, what doesn't fit is kept on disk instead
+ *              of being forgotten. Many cells can be set at once, atomically:
+ *              they are checked for cycles together, recalculated in one
+ *              pass and undone as one group.
  *
  * Public Functions:
  *   constructor:       sets name of spreadsheet
  *   destructor:        deletes all stored data from spreadsheet
  *   get_name:          rerurns name of spreadsheet
  *   get_cell:          returns contents of specified cell
+ *   get_value:         returns the computed value of specified cell
+ *   get_recalculated:  returns the cells (and values) recalculated by the last edit
  *   set_cell:          sets contents of specified cell
- *   get_data_map:      returns the data map to store spreadsheet
- *   undo:              undoes last cell change
+ *   set_cells:         sets many cells as one edit, or none of them if that would close a cycle
+ *   for_each_cell:     calls a function for every cell with contents
+ *   get_cells:         copies out the name and contents of every cell with contents
+ *   copy_cells:        copies every cell with contents into one buffer, for a snapshot
+ *   load_cell:         sets contents of a cell without recording it for undo (for loading snapshots)
+ *   load_cells:        sets many cells at once without recording them, checking for cycles once at the end
+ *   load_snapshot:     loads the cells of a mapped binary snapshot, leaving long contents in it
+ *   undo:              undoes last edit (every cell of it, if it set several)
+ *   redo:              redoes the last undone edit, until the next edit
+ *   open_undo_journal: keeps undo history that doesn't fit in memory in <name>.axisundo
+ *   spill_undo:        moves the whole in-memory undo history to the journal
  *   display_contents:  display current spreadsheet -- only for testing
  *   num_cells:         returns the number of stored cells currently 
+ *   get_arena_stats:   reports the memory held by this spreadsheet's arena
+ *   memory_used:       estimates the bytes this spreadsheet holds in all
+ *   lock:              takes this spreadsheet's lock (usable with std::lock_guard)
+ *   unlock:            releases this spreadsheet's lock
  *
  * Private Functions:
- *   has_dependency:    tells if circular dependencies exist
+ *   apply:             sets the contents of a cell, recording the change for undo or not
+ *   apply_batch:       sets the contents of many cells at once, recording them as one group or not
+ *   place:             stores a cell's contents and edges without evaluating anything
+ *   evaluate_all:      evaluates every cell in dependency order
+ *   find_cycles:       marks the cells evaluate_all couldn't reach that may be on a cycle
+ *   push_change:       records the current contents of a cell in a change_ring, making room first
+ *   push_record:       records given contents of a cell in a change_ring, making room first
+ *   spill:             writes the oldest undo records to the journal and drops them
+ *   revert:            applies the newest group of records of one ring, recording the cells' contents in the other
+ *   intern:            returns the id of a cell, assigning one if new
+ *   has_dependency:    tells if a cell is reachable from a set of cells
+ *   closes_cycle:      tells if a cycle can be reached from a set of cells
+ *   set_dependencies:  replaces the outgoing edges of one cell
+ *   next_epoch:        starts a new search over the graph
+ *   recalculate:       evaluates some cells and everything that depends on them
+ *   evaluate:          computes the value of one cell from its contents
  */
 class spreadsheet
 {
   /* Class: cellChange
    *
-   * Description: Aggregate to store the name and contents of a cell
-   *              that has been changed. Stored on a stack for 'undo'
+   * Description: Aggregate to store the coordinates and previous contents of
+   *              a cell that has been changed. Stored in change_rings for 'undo' and 'redo'
+   */
+  class cellChange
+  {
+  public:
+    cell_coord cell;
+    cell_text contents;  //Kept in the spreadsheet's arena
+    bool joined;         //Made in one edit with the record before it, and reverted with it
+  };
+
+  /* Class: change_ring
+   *
+   * Description: History of cellChanges, oldest to newest, in an arena block used
+   *              as a ring. The block doubles as it fills, up to UNDO_MAX_ENTRIES
+   *              records. Counts the bytes its records hold so the spreadsheet
+   *              can keep it under UNDO_MAX_BYTES.
    *
    * Public Functions:
-   *   constructor: sets the name and contents to be stored
+   *   push:        appends a record as the newest
+   *   at:          returns a record by age (0 is the oldest)
+   *   newest:      returns the newest record
+   *   pop_newest:  drops the newest record
+   *   pop_oldest:  drops the oldest record
+   *   clear:       drops every record
+   *   cost:        returns the bytes a record with contents of a given length holds
    */
-  class cellChange
+  class change_ring
   {
   public:
-    cellChange(std::string name, std::string change);
-    std::string cell_name;
-    std::string cell_change;
+    void push(cell_coord cell, const char * contents, size_t length, bool joined, sheet_arena * arena);
+    cellChange & at(int age);
+    cellChange & newest();
+    void pop_newest(sheet_arena * arena);
+    void pop_oldest(sheet_arena * arena);
+    void clear(sheet_arena * arena);
+    static long long cost(size_t length);
+    cellChange * records;
+    int capacity;
+    int first;        //Slot of the oldest record
+    int count;
+    long long bytes;  //Sum of cost() over the records
+  };
+
+  /* Class: id_list
+   *
+   * Description: Ids of cells, kept in one arena block that doubles as it fills
+   *
+   * Public Functions:
+   *   push_back:  appends an id
+   *   remove:     removes one copy of an id, not keeping order
+   *   assign:     replaces the ids
+   */
+  class id_list
+  {
+  public:
+    void push_back(int id, sheet_arena * arena);
+    void remove(int id);
+    void assign(const int * source, int length, sheet_arena * arena);
+    int * ids;
+    int count;
+    int capacity;
+  };
+
+  /* Class: cell_value
+   *
+   * Description: Computed value of a cell. Text values aren't copied;
+   *              they are the cell's contents.
+   */
+  class cell_value
+  {
+  public:
+    char kind;      //One of the VALUE_* kinds
+    char error;     //Why a VALUE_ERROR has no value (FORMULA_* reason)
+    double number;  //The value of a VALUE_NUMBER
   };
 
  public:
@@ -58,18 +195,80 @@ class spreadsheet
   ~spreadsheet();
   std::string get_name();        //Getter for the string name
   std::string get_cell(std::string cellName);                    //Getter for contents of cell
-  int set_cell(std::string cellName, std::string cellContents); //Setter for contents of cell
-  std::map<std::string, std::string>* get_data_map();
-  int undo(std::string * cell_name, std::string * cell_change);
+  std::string get_value(std::string cellName);                   //Getter for computed value of cell
+  std::string get_value(cell_coord coord);
+  void get_recalculated(std::vector<std::pair<std::string, std::string> > & values);
+  int set_cell(const text_view & cellName, const text_view & cellContents); //Setter for contents of cell
+  int set_cells(const std::vector<std::pair<text_view, text_view> > & cells, size_t * bad_cell);
+  void for_each_cell(cell_store::cell_visitor visit, void * context);
+  void get_cells(std::vector<std::pair<std::string, std::string> > & cells);
+  void copy_cells(std::string & bytes, std::vector<snapshot_cell> & cells);
+  int load_cell(const std::string & cellName, const std::string & cellContents);
+  int load_cells(const std::vector<snapshot_cell> & cells, bool mapped);
+  int load_snapshot(sheet_snapshot * opened);
+  int undo(std::vector<std::pair<std::string, std::string> > & changed);
+  int redo(std::vector<std::pair<std::string, std::string> > & changed);
+  void open_undo_journal();
+  int spill_undo();
   void display_contents(); //Note: just for testing
   int num_cells();
+  void get_arena_stats(arena_stats * stats);
+  size_t memory_used();
+  void lock();   //Serializes edits to this spreadsheet only
+  void unlock();
 
  private:
-  int has_dependency (std::string c1, std::string c2);
+  int apply(cell_coord coord, const char * contents, size_t length, bool record);
+  int apply_batch(const std::vector<cell_coord> & coords, const std::vector<text_view> & contents, change_ring * record);
+  int place(cell_coord coord, const char * contents, size_t length, bool check, bool record, bool mapped, int * cell);
+  bool evaluate_all(std::vector<int> & waiting, bool only_waiting);
+  void find_cycles(const std::vector<int> & waiting, std::vector<bool> & cyclic);
+  void push_change(change_ring & ring, cell_coord coord);
+  void push_record(change_ring & ring, cell_coord coord, const char * contents, size_t length, bool joined);
+  int spill(int records);
+  int revert(change_ring & from, change_ring & to, std::vector<std::pair<std::string, std::string> > & changed);
+  int intern(cell_coord coord);
+  int has_dependency(int cell, const std::vector<int> & starts);
+  int closes_cycle(const std::vector<int> & starts);
+  void set_dependencies(int cell, const std::vector<int> & depends);
+  unsigned int next_epoch();
+  void recalculate(const int * cells, size_t count);
+  void evaluate(int cell);
   std::string name; //Name of spreadsheet
-  mutable std::map<std::string, std::string>* data; //String for cell names corresponding to their cell contents
-  std::map<std::string, std::vector<std::string> >* dependencies; //cell names to list of cell names that it relies on
-  std::stack<cellChange>* changes;
+  sheet_arena* arena; //Memory of long contents, dependency lists and undo records
+  cell_store* data; //Contents of every cell, keyed by coordinates
+
+  // Dependency graph over interned cell ids. Ids are never reused, so a cell
+  // keeps its id (and its dependents) after it is cleared.
+  std::map<cell_coord, int> cell_ids;            //cell coordinates to its id
+  std::vector<cell_coord> cell_coords;           //id to cell coordinates
+  std::vector<id_list> dependencies;             //id to ids of the cells it relies on
+  std::vector<id_list> dependents;               //id to ids of the cells that rely on it
+  std::vector<unsigned int> visited;             //id to the epoch of the search that last reached it
+  unsigned int epoch;                            //Bumped by every search so visited never needs clearing
+
+  std::vector<std::shared_ptr<const formula> > formulas; //id to compiled formula (shared through formula::compile), null unless the cell holds one
+  std::vector<cell_value> values;                //id to computed value
+  std::vector<cell_coord> recalculated;          //cells evaluated by the last edit, in the order they were
+  change_ring changes;                           //Undo history still in memory, newest last
+  change_ring undone;                            //Changes undo has reverted, for redo; emptied by the next edit
+  undo_journal* journal;                         //Older undo history on disk, null unless opened
+  sheet_snapshot* snapshot;                      //Snapshot the sheet was loaded from, holding long contents not set since; null if none
+
+  // Scratch space of an edit, kept so its capacity is reused
+  std::string stripped;                          //Contents without spaces
+  std::string formula_key;                       //Normalized formula text for formula::compile
+  std::vector<int> new_depends;                  //Ids a new formula relies on
+  std::vector<int> search;                       //Stack of has_dependency
+  std::vector<std::pair<int, int> > walk;        //Stack of recalculate: cell, next dependent to look at
+  std::vector<int> finished;                     //Cells in the order recalculate finished them
+  std::vector<double> arguments;                 //Values of a formula's references
+  std::vector<double> evaluation;                //Stack of formula::evaluate
+  std::vector<cell_coord> batch_coords;          //Cells of a batch, in order
+  std::vector<text_view> batch_contents;         //Their new contents
+  std::vector<std::string> batch_previous;       //What they held before, to record or roll back
+  std::vector<int> batch_roots;                  //Ids of the batch's cells, to check and recalculate from
+  instrumented_mutex sheet_lock; //Held by the server while reading or editing this spreadsheet; waits and holds are timed
 };
 
 #endif
@@ -6,65 +6,158 @@
  */
 
 /*
- * Description: Creates a server which pairs sockets, launches a thread for
- *   each socket paired, waits for messages from  each socket, and provides a convenient function for
+ * Description: Creates a server which pairs sockets on a pool of epoll reactors
+ *   (one per core), waits for messages from each socket, and provides a convenient function for
  *   communicating with clients via sockets.
  */
 
  
-#include <arpa/inet.h> // inet_ntoa
-#include <algorithm> // remove()
-#include <boost/asio.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm> // sort(), count(), min(), max()
+#include <atomic>
+#include <chrono>
+#include <csignal> // SIGTERM handling
+#include <fcntl.h> // fcntl() to make the listening socket non-blocking
 #include <fstream> // File I/O
-#include <iostream> // console I/O
+#include <malloc.h> // malloc_trim()
 #include <map>
 #include <mutex>
+#include <set>
 #include <netdb.h> // addrinfo/getaddrinfo
 #include <netinet/in.h> // Unnecessary?
-#include <pthread.h>
 #include <sstream>
-#include <stdio.h> // perror error message printing
+#include <stdio.h> // fopen
 #include <string> // std::strings
 #include <string.h> // memset(), strlen
 #include <sys/socket.h> // Unnecessary?
 #include <thread>
 #include <unistd.h>
 #include <vector>
+#include "cell_ref.h"
+#include "client_command.h"
+#include "flusher.h"
+#include "logger.h"
+#include "metrics.h"
+#include "reactor.h"
+#include "sheet_log.h"
 #include "spreadsheet.h"
 
 
-#define BACKLOG 10  // Max number of queued users waiting to connect
-#define INCOMING_BUFFER_SIZE 500 // Used in handle() to receive messages from sockets
+#ifndef BACKLOG
+#define BACKLOG 4096 // Max number of queued users waiting to connect (the kernel caps it at somaxconn)
+#endif
+
+// Write-ahead log settings (override with -D at compile time)
+#ifndef WAL_FSYNC_POLICY
+#define WAL_FSYNC_POLICY FSYNC_GROUP // FSYNC_NEVER, FSYNC_GROUP or FSYNC_ALWAYS
+#endif
+#ifndef WAL_GROUP_SIZE
+#define WAL_GROUP_SIZE 64            // Records per fsync under FSYNC_GROUP
+#endif
+#ifndef WAL_GROUP_INTERVAL_MS
+#define WAL_GROUP_INTERVAL_MS 100    // Longest a record waits for its fsync under FSYNC_GROUP
+#endif
+#ifndef WAL_COMPACT_AFTER
+#define WAL_COMPACT_AFTER 10000      // Log records before the snapshot is rewritten
+#endif
+#ifndef FLUSH_INTERVAL_MS
+#define FLUSH_INTERVAL_MS 50         // How often the flusher writes queued edits to the logs
+#endif
+#ifndef SHEET_IDLE_MS
+#define SHEET_IDLE_MS 300000         // A loaded spreadsheet nobody has been connected to for this long is unloaded
+#endif
+#ifndef SHEET_MEMORY_BUDGET
+#define SHEET_MEMORY_BUDGET (1LL << 30) // Past this many bytes of loaded spreadsheets, the least recently used unused ones are unloaded early (0: no budget)
+#endif
+#ifndef EVICT_INTERVAL_MS
+#define EVICT_INTERVAL_MS 1000       // How often loaded spreadsheets are checked for unloading
+#endif
+#ifndef RECOVERY_THREADS
+#define RECOVERY_THREADS 4           // Threads loading saved spreadsheets in the background at startup, up to SHEET_MEMORY_BUDGET (0: load each on its first connect only)
+#endif
+#ifndef UNDO_JOURNAL
+#define UNDO_JOURNAL 0               // 1 keeps undo history past UNDO_MAX_ENTRIES/UNDO_MAX_BYTES, and across restarts, in <name>.axisundo
+#endif
 
 
 // Holds all registered users.
 std::map<std::string,bool> user_list;
 
-// Holds all spreadsheets.
+// Holds all loaded spreadsheets. A spreadsheet is loaded on its first connect
+// and unloaded again once nobody has used it for a while.
 std::map<std::string, spreadsheet*> spreadsheets;
 
+// Names of every spreadsheet ever created (the spreadsheets.axis list),
+// loaded or not.
+std::set<std::string> spreadsheet_catalog;
+
+// Number of users connected to each loaded spreadsheet (the entries of
+// user_spreadsheet naming it), and since when it has had none. A spreadsheet
+// is only unloaded while its count is 0. Both guarded by registry_lock.
+std::map<std::string, int> spreadsheet_refs;
+std::map<std::string, long long> spreadsheet_idle_since;
+
+// Holds the write-ahead log of every spreadsheet, keyed by spreadsheet name.
+// The map is guarded by registry_lock; each log by its spreadsheet's lock.
+std::map<std::string, sheet_log*> sheet_logs;
+
+// Writes edits to the logs in the background.
+flusher * persistence;
+
 //Map user ID to spreadsheet name
 std::map<int, std::string> user_spreadsheet;
 
 //Map spreadsheet name to all connected users (Theses spreadsheets are open)
+//The map itself is guarded by registry_lock, but each vector of users is
+//guarded by the lock of the spreadsheet it belongs to.
 std::map<std::string, std::vector<int> > spreadsheet_user;
 
-// Locks shared resources between threads.
-std::mutex godlock;
+//Map spreadsheet name to the connected users that asked for computed values
+//with the "values" command. Guarded the same way as spreadsheet_user.
+std::map<std::string, std::vector<int> > spreadsheet_value_user;
+
+// Saved spreadsheets for the recovery threads to load, and the index of the
+// next one to take. Setting the index past the end stops them.
+std::vector<std::string> recovery_names;
+std::atomic<unsigned int> recovery_next(0);
+
+// Estimated bytes of the spreadsheets the recovery threads have loaded.
+std::atomic<long long> recovery_bytes(0);
+
+// Guards the registries above (user_list, spreadsheets, the catalog, the
+// reference counts, user_spreadsheet and the spreadsheet_user map) and the
+// .axis list files. Held only for lookups;
+// edits to a spreadsheet run under that spreadsheet's own lock instead, so
+// separate spreadsheets are edited in parallel. Lock order: registry_lock
+// is never acquired while holding a spreadsheet's lock. Waits and holds are timed.
+instrumented_mutex registry_lock(HISTOGRAM_REGISTRY_LOCK_WAIT, HISTOGRAM_REGISTRY_LOCK_HOLD);
 
 
 // Used to send a string through a socket.
 int send_message(int socket_id, std::string string_to_send);
 
-// Splits messages into space-separated tokens.
-void split_message(std::string message, std::vector<std::string> & ret);
+// Used to send a shared message through a socket without copying it.
+int send_message(int socket_id, const shared_message & message);
 
 // Registers a new user, or sends an error to the requesting client.
 void register_user(int user_socket_ID, std::string user_name);
 
-//Save the current spreadsheets contents
-void save_open_spreadsheets(std::string);
+//Create an empty spreadsheet
+spreadsheet * open_spreadsheet(std::string);
+
+//Find a loaded spreadsheet, or register a new one to be loaded
+spreadsheet * find_spreadsheet(std::string, bool * created, bool * saved);
+
+//Load saved spreadsheets in the background, run by each recovery thread
+void recover_spreadsheets();
+
+//Load a saved spreadsheet from its snapshot and log, timing it
+void load_spreadsheet(spreadsheet * s);
+
+//Open a spreadsheet's write-ahead log
+sheet_log * open_log(std::string);
+
+//Save a cell change to the spreadsheet's log
+void save_changes(spreadsheet *, sheet_log *, std::vector<std::pair<std::string, std::string> > &);
 
 //Save the current spreadsheets contents
 void save_spreadsheet_names(std::string);
@@ -72,14 +165,68 @@ void save_spreadsheet_names(std::string);
 // Handles a client's connection/spreadsheet loading request.
 void connect_requested(int user_socket_ID, std::string user_name, std::string spreadsheet_requested);
 
-//Change the incoming cells contents
-void change_cell(int user_socket_id, std::string cell_name, std::string new_cell_contents);
+/* Class: edit_batch
+ *
+ * Description: What a batch of edits to one spreadsheet has to send and save once
+ *              they are all applied
+ */
+class edit_batch
+{
+ public:
+  std::shared_ptr<std::string> cells;     //"cell" commands for every user of the spreadsheet, in order
+  std::vector<std::string> recalculated;  //Cells whose values changed, each once, in the order first recalculated
+  std::set<std::string> seen;             //The same cells, to look them up
+  std::vector<std::pair<std::string, std::string> > changes; //For the log
+};
+
+//True for the commands that edit a spreadsheet: cell, cells, undo and redo
+bool is_edit(int kind);
+
+//Apply the edits at the front of a user's lines as one batch
+size_t apply_edits(int socket_id, const text_view * lines, size_t count, std::string & scratch);
+
+//Apply one edit (of one cell or many) to a spreadsheet, adding what changed to a batch
+void apply_edit(int socket_id, spreadsheet * s, const client_command & command, edit_batch & batch,
+                const std::vector<int> & users, const std::vector<int> & value_users);
+
+//Serialize a spreadsheet for a connecting client
+void serialize_spreadsheet(spreadsheet * s, std::vector<std::string> & buffers);
+
+//Append one command about a cell to pooled buffers
+void append_command(std::vector<std::string> & buffers, const char * command, cell_coord coord, const char * argument, size_t length);
+
+//Cell visitors that serialize contents and values
+void serialize_cell(cell_coord coord, const char * contents, size_t length, void * context);
+void serialize_value(cell_coord coord, const char * contents, size_t length, void * context);
+
+/* Class: value_serializer
+ *
+ * Description: What serialize_value() needs to append a cell's value
+ */
+class value_serializer
+{
+ public:
+  spreadsheet * s;
+  std::vector<std::string> * buffers;
+};
+
+//Add a cell changed by an applied edit to a batch
+void add_change(edit_batch & batch, const text_view & cellName, const text_view & cellContents, bool joined);
+
+//Add the cells an applied edit recalculated to a batch
+void add_recalculated(edit_batch & batch, spreadsheet * s);
+
+//Split the payload of a cells command into cell names and contents
+bool parse_cells(const text_view & payload, std::string & names, std::vector<std::pair<text_view, text_view> > & cells);
 
-//Send connect command
-void send_connect(const int socket_id, const int count);
+//Send a batch's cell changes to every user of a spreadsheet, and its values to the users that asked for them
+void broadcast_batch(edit_batch & batch, spreadsheet * s, const std::vector<int> & users, const std::vector<int> & value_users);
 
-//Send cell changes
-void send_cell(const int socket_id, const std::string cellName, const std::string cellContents);
+//Time (and sometimes log) a handled command
+void command_handled(int socket_id, spreadsheet * s, int kind, long long elapsed_ns);
+
+//Start sending computed values to a user
+void subscribe_values(int socket_id);
 
 //Send error
 void send_error(int socket_id, int error_id, std::string context);
@@ -87,32 +234,143 @@ void send_error(int socket_id, int error_id, std::string context);
 //Remove a user from previous spreadsheets
 void remove_user(int socket_id);
 
+//Unload spreadsheets nobody is using, run periodically by the flusher
+void evict_idle_spreadsheets();
+
+/* Class: eviction_candidate
+ *
+ * Description: A loaded spreadsheet that no user is connected to, as seen by
+ *              evict_idle_spreadsheets()
+ */
+class eviction_candidate
+{
+ public:
+  std::string name;
+  spreadsheet * s;
+  sheet_log * log;
+  long long idle_since; //Milliseconds; unloading is called off if this changes
+  long long bytes;      //Estimated memory held
+};
+
+//Unload one spreadsheet if it is still unused
+int unload_spreadsheet(const eviction_candidate & candidate);
 
-/* Function: send_connect
- * Params: user ID, number of cells to send
+//Milliseconds on a monotonic clock
+long long now_ms();
+
+//Microseconds on a monotonic clock
+long long now_us();
+
+//Name of the spreadsheet a user is connected to, or "" if none
+std::string user_sheet_name(int socket_id);
+
+//Appends the server's gauges to a metrics scrape
+void collect_metrics(std::string & out);
+
+
+/* Function: add_change
+ * Params: batch, name of a cell an applied edit changed, its new contents, whether the
+ *         edit changed the cell added before it too
  * Return: void
  *
- * Description: Sends specified client the "connected" command
+ * Description: Appends the "cell" command of the change to the batch's message and queues
+ *              the change for the log, both under the cell's canonical name ("a01" is sent
+ *              and logged as "A1"), as the snapshot sent on connect and recovery name it. In
+ *              the log, every cell of an edit after its first is marked as joined to the one
+ *              before, so the edit is replayed as one.
  */
-void send_connect(const int socket_id, const int count)
+void add_change(edit_batch & batch, const text_view & cellName, const text_view & cellContents, bool joined)
 {
-    std::string message = "connected ";
-    std::stringstream ss;
-    ss << count;
-    message += ss.str();
+    // The edit was applied, so the name parses
+    char name[CELL_NAME_MAX];
+    cell_coord coord;
+    text_view canonical = cellName;
+    if (parse_cell_name(cellName.data, cellName.data + cellName.length, &coord))
+        canonical = text_view(name, format_cell_name(coord, name));
+    
+    if (!batch.cells)
+        batch.cells = std::make_shared<std::string>();
+    
+    std::string & message = *batch.cells;
+    message.reserve(message.size() + canonical.length + cellContents.length + 7); // "cell " + ' ' + '\n'
+    message += "cell ";
+    message.append(canonical.data, canonical.length);
+    message += ' ';
+    message.append(cellContents.data, cellContents.length);
     message += '\n';
-    send_message(socket_id, message);
+    
+    batch.changes.push_back(std::make_pair(std::string(), cellContents.str()));
+    std::string & logged_name = batch.changes.back().first;
+    if (joined)
+        logged_name += JOINED_RECORD_MARK;
+    logged_name.append(canonical.data, canonical.length);
+}
+
+/* Function: add_recalculated
+ * Params: batch, spreadsheet just edited (its lock must be held)
+ * Return: void
+ *
+ * Description: Notes every cell the last edit recalculated: the edited cells first, then
+ *              their dependents in dependency order. A cell recalculated by several edits
+ *              of the batch is only noted the first time; its value is read when the batch
+ *              is sent, so each user gets its latest value once.
+ */
+void add_recalculated(edit_batch & batch, spreadsheet * s)
+{
+    std::vector<std::pair<std::string, std::string> > values;
+    s->get_recalculated(values);
+    std::vector<std::pair<std::string, std::string> >::iterator itValues;
+    for(itValues = values.begin(); itValues != values.end(); itValues++)
+    {
+        if (batch.seen.insert(itValues->first).second)
+            batch.recalculated.push_back(itValues->first);
+    }
 }
 
-/* Function: send_cell
- * Params: user ID, name of cell, new contents
+/* Function: broadcast_batch
+ * Params: batch, spreadsheet it edited (its lock must be held), its users, those that asked for values
  * Return: void
  *
- * Description: Sends specified client the "cell" command, indicating they need to update a cell
+ * Description: Sends every user the batch's "cell" commands as one message, then sends the
+ *              users that asked for values one message with a "value" command for each cell
+ *              the batch recalculated. Each message is built once into a shared buffer that
+ *              every client's queue references, so a batch costs the same few allocations no
+ *              matter how many users there are. Leaves the batch's messages empty, ready for more.
  */
-void send_cell(const int socket_id, const std::string cellName, const std::string cellContents)
+void broadcast_batch(edit_batch & batch, spreadsheet * s, const std::vector<int> & users, const std::vector<int> & value_users)
 {
-    send_message(socket_id, std::string("cell " + cellName + " " + cellContents + '\n'));
+    if (!batch.cells)
+        return;
+    
+    shared_message shared = batch.cells;
+    batch.cells.reset();
+    std::vector<int>::const_iterator it;
+    for(it = users.begin(); it != users.end(); it++)
+    {
+        send_message(*it, shared);
+    }
+    
+    if (batch.recalculated.empty())
+        return;
+    
+    std::shared_ptr<std::string> message = std::make_shared<std::string>();
+    std::vector<std::string>::iterator itCells;
+    for(itCells = batch.recalculated.begin(); itCells != batch.recalculated.end(); itCells++)
+    {
+        *message += "value ";
+        *message += *itCells;
+        *message += ' ';
+        *message += s->get_value(*itCells);
+        *message += '\n';
+    }
+    batch.recalculated.clear();
+    batch.seen.clear();
+    
+    shared = message;
+    for(it = value_users.begin(); it != value_users.end(); it++)
+    {
+        send_message(*it, shared);
+    }
 }
 
 /* Function: send_error
@@ -129,19 +387,26 @@ void send_error(int socket_id, int error_id, std::string context)
 }
 
 /* Function: user_to_spreadsheet
- * Params: user ID, pointer to a pointer of a spreadsheet
+ * Params: user ID, pointers to pointers of a spreadsheet, its users, its users that want values and its log
  * Return: 0 if failed, 1 if succeeded
  *
- * Description: Finds the spreadsheet associated with the user and changes pointer to point to it
+ * Description: Finds the spreadsheet associated with the user and changes pointer to point to it,
+ *              along with the lists of users connected to it and its log. Takes the registry_lock;
+ *              the lists of users and the log may only be used while holding the spreadsheet's lock.
  */
-int user_to_spreadsheet(int user, spreadsheet **s)
+int user_to_spreadsheet(int user, spreadsheet **s, std::vector<int> **users, std::vector<int> **value_users, sheet_log **log)
 {
+    std::lock_guard<instrumented_mutex> guard(registry_lock);
+    
     if(user_spreadsheet.count(user) != 0)
     {
         std::string spreadsheet_name = user_spreadsheet[user];
         if(spreadsheets.count(spreadsheet_name) != 0)
         {
             (*s) = spreadsheets[spreadsheet_name];
+            (*users) = &spreadsheet_user[spreadsheet_name];
+            (*value_users) = &spreadsheet_value_user[spreadsheet_name];
+            (*log) = sheet_logs[spreadsheet_name];
             return 1;
         }
     }
@@ -149,7 +414,6 @@ int user_to_spreadsheet(int user, spreadsheet **s)
     return 0;
 }
 
-
 /* Function: register_user
  * Params: user ID, new name
  * Return: void
@@ -159,6 +423,8 @@ int user_to_spreadsheet(int user, spreadsheet **s)
  */
 void register_user(int user_socket_ID, std::string user_name)
 {
+  std::lock_guard<instrumented_mutex> guard(registry_lock);
+
   if(user_spreadsheet.count(user_socket_ID) > 0)
   {
     if(user_list.count(user_name) == 0)
@@ -189,19 +455,84 @@ void register_user(int user_socket_ID, std::string user_name)
  * Return: void
  *
  * Description: Gets rid of a user from all data structures. This is primarily
- *              for users switching spreadsheets
+ *              for users switching spreadsheets. The user still counts toward
+ *              its spreadsheet's references until it is out of its lists, so
+ *              the spreadsheet can't be unloaded from under it.
  */
 void remove_user(int socket_id)
 {
-  if(user_spreadsheet.count(socket_id) > 0)
+  spreadsheet * s = NULL;
+  std::vector<int> * users = NULL;
+  std::vector<int> * value_users = NULL;
+  std::string spreadsheet_name;
+
   {
-    std::string spreadsheet = user_spreadsheet[socket_id];
-    user_spreadsheet.erase(socket_id);
+    std::lock_guard<instrumented_mutex> guard(registry_lock);
+    if(user_spreadsheet.count(socket_id) == 0)
+      return;
 
-    std::vector<int>::iterator it;
-    it = find(spreadsheet_user[spreadsheet].begin(), spreadsheet_user[spreadsheet].end(), socket_id);
-    spreadsheet_user[spreadsheet].erase(it);
+    spreadsheet_name = user_spreadsheet[socket_id];
+    s = spreadsheets[spreadsheet_name];
+    users = &spreadsheet_user[spreadsheet_name];
+    value_users = &spreadsheet_value_user[spreadsheet_name];
   }
+
+  {
+    std::lock_guard<spreadsheet> guard(*s);
+    std::vector<int>::iterator it = find(users->begin(), users->end(), socket_id);
+    if(it != users->end())
+      users->erase(it);
+    
+    it = find(value_users->begin(), value_users->end(), socket_id);
+    if(it != value_users->end())
+      value_users->erase(it);
+  }
+
+  std::lock_guard<instrumented_mutex> guard(registry_lock);
+  user_spreadsheet.erase(socket_id);
+  if(--spreadsheet_refs[spreadsheet_name] == 0)
+    spreadsheet_idle_since[spreadsheet_name] = now_ms();
+}
+
+/* Function: subscribe_values
+ * Params: user ID
+ * Return: void
+ *
+ * Description: Called when a client sends "values". From now until it leaves its spreadsheet
+ *              the client gets a "value" command for every cell an edit recalculates. The
+ *              current value of every cell is sent right away, under the spreadsheet's lock
+ *              so no edit can slip in between.
+ */
+void subscribe_values(int socket_id)
+{
+    spreadsheet *s;
+    std::vector<int> *users;
+    std::vector<int> *value_users;
+    sheet_log *log;
+    if(!user_to_spreadsheet(socket_id, &s, &users, &value_users, &log))
+    {
+        // Failed to match user to a spreadsheet. Send error 3.
+        send_error(socket_id, 3, "User not logged in.");
+        return;
+    }
+    
+    {
+        std::lock_guard<spreadsheet> guard(*s);
+        if(find(value_users->begin(), value_users->end(), socket_id) != value_users->end())
+            return;
+        value_users->push_back(socket_id);
+        
+        std::vector<std::string> buffers;
+        buffers.push_back(reactor::take_buffer());
+        
+        value_serializer serializer;
+        serializer.s = s;
+        serializer.buffers = &buffers;
+        s->for_each_cell(serialize_value, &serializer);
+        reactor::queue(socket_id, buffers);
+    }
+    
+    reactor::flush(socket_id);
 }
 
 /* Function: connect_requested
@@ -210,68 +541,137 @@ void remove_user(int socket_id)
  *
  * Description: Called when a client tries to connect to a spreadsheet. If all information 
  *              works out, they will be sent the "connected" command. Otherwise they'll get error(s)
+ *              The user joins the spreadsheet's users and receives its cells under the
+ *              spreadsheet's lock, so no edit can slip between the two.
  */
 void connect_requested(int user_socket_ID, std::string user_name, std::string spreadsheet_requested)
 {
-    // If the username has been registered...
-    if (user_list.find(user_name) != user_list.end())
+    long long start_us = now_us();
     {
-        remove_user(user_socket_ID);
+        std::lock_guard<instrumented_mutex> guard(registry_lock);
         
-	//If the spreadsheet exists
-        if(spreadsheets.count(spreadsheet_requested) == 1)
-        {
-            //associate the socket with the spreadsheet
-            user_spreadsheet[user_socket_ID] = spreadsheet_requested;
-            
-            //If its already open
-            if(spreadsheet_user.count(spreadsheet_requested) == 1)
-            {
-	      std::vector<int> users = spreadsheet_user[spreadsheet_requested]; 
-	      users.push_back(user_socket_ID);
-	      spreadsheet_user[spreadsheet_requested] = users;
-            }
-            //Add it to the opened
-            else
-            {
-                std::vector<int> temp;
-                temp.push_back(user_socket_ID);
-                spreadsheet_user[spreadsheet_requested] = temp;
-            }
-	    
-            send_connect(user_socket_ID, spreadsheets[spreadsheet_requested]->num_cells());
-
-            if(spreadsheets[spreadsheet_requested]->num_cells() > 0)
-            {
-                //Send the cells
-                std::map<std::string, std::string>::iterator itCells = spreadsheets[spreadsheet_requested]->get_data_map()->begin();
-                for( ; itCells != spreadsheets[spreadsheet_requested]->get_data_map()->end(); ++itCells)
-                {
-                    //TODO:Fix this
-                    send_cell(user_socket_ID, itCells->first, itCells->second);
-                }   
-            }          
-        }
-        //Otherwise, create the spreadsheet
-        else
+        // If the username hasn't been registered, respond with error 4
+        if (user_list.find(user_name) == user_list.end())
         {
-            
-            spreadsheet * s = new spreadsheet(spreadsheet_requested);
-	    send_connect(user_socket_ID, s->num_cells());
-            spreadsheets.insert(std::pair<std::string, spreadsheet*>(spreadsheet_requested, s));
-            
-            std::vector<int> temp;
-            temp.push_back(user_socket_ID);
-            spreadsheet_user.insert(std::pair<std::string, std::vector<int> >(spreadsheet_requested, temp));
-            user_spreadsheet.insert(std::pair<int, std::string>(user_socket_ID, spreadsheet_requested));
-	    save_spreadsheet_names(spreadsheet_requested);
+            send_error(user_socket_ID, 4, user_name);
+            return;
         }
     }
-    // Otherwise, respond with error 4
-    else
-        send_error(user_socket_ID, 4, user_name);
+    
+    remove_user(user_socket_ID);
+    
+    spreadsheet * s;
+    std::vector<int> * users;
+    bool created;
+    bool saved;
+    {
+        std::lock_guard<instrumented_mutex> guard(registry_lock);
+        
+        //If the spreadsheet isn't loaded it is created, locked, and loaded below
+        s = find_spreadsheet(spreadsheet_requested, &created, &saved);
+        
+        //associate the socket with the spreadsheet
+        user_spreadsheet[user_socket_ID] = spreadsheet_requested;
+        spreadsheet_refs[spreadsheet_requested]++;
+        users = &spreadsheet_user[spreadsheet_requested];
+    }
+    
+    // A spreadsheet a recovery thread or another user is loading is locked until it is done
+    if(!created)
+        s->lock();
+    else if(saved)
+        load_spreadsheet(s);
+    
+    {
+        std::lock_guard<spreadsheet> guard(*s, std::adopt_lock);
+        users->push_back(user_socket_ID);
+        
+        // Fix the "connected" command and the cells in the user's stream while no edit can interleave
+        std::vector<std::string> buffers;
+        serialize_spreadsheet(s, buffers);
+        reactor::queue(user_socket_ID, buffers);
+    }
+    
+    // Write them in bulk after the spreadsheet is unlocked
+    reactor::flush(user_socket_ID);
+    
+    log_fields fields;
+    fields.socket = user_socket_ID;
+    fields.sheet = spreadsheet_requested;
+    fields.command = text_view("connect", 7);
+    fields.latency_us = now_us() - start_us;
+    logger::log(LOG_INFO, fields, created && saved ? "user connected, spreadsheet loaded" : "user connected");
 }//End connect_requested()
 
+/* Function: serialize_spreadsheet
+ * Params: spreadsheet to send (its lock must be held), vector to store the buffers
+ * Return: void
+ *
+ * Description: Serializes the "connected" command followed by a "cell" command for
+ *              every cell into large pooled buffers, so a whole spreadsheet goes out
+ *              in a handful of writev() calls instead of one send() per cell.
+ */
+void serialize_spreadsheet(spreadsheet * s, std::vector<std::string> & buffers)
+{
+    std::ostringstream stream;
+    stream << "connected " << s->num_cells() << '\n';
+    
+    buffers.push_back(reactor::take_buffer());
+    buffers.back() += stream.str();
+    
+    s->for_each_cell(serialize_cell, &buffers);
+}
+
+/* Function: append_command
+ * Params: pooled buffers, command, cell coordinates, argument and its length
+ * Return: void
+ *
+ * Description: Appends "<command> <cell name> <argument>\n" to the last buffer,
+ *              taking a new pooled buffer when the last one is full.
+ */
+void append_command(std::vector<std::string> & buffers, const char * command, cell_coord coord, const char * argument, size_t length)
+{
+    char name[CELL_NAME_MAX];
+    size_t name_length = format_cell_name(coord, name);
+    size_t command_length = strlen(command);
+    
+    size_t needed = command_length + name_length + length + 3; // ' ' + ' ' + '\n'
+    if(buffers.back().size() + needed > buffers.back().capacity())
+        buffers.push_back(reactor::take_buffer());
+    
+    std::string & buffer = buffers.back();
+    buffer.append(command, command_length);
+    buffer += ' ';
+    buffer.append(name, name_length);
+    buffer += ' ';
+    buffer.append(argument, length);
+    buffer += '\n';
+}
+
+/* Function: serialize_cell
+ * Params: cell coordinates and contents, buffers to append to
+ * Return: void
+ *
+ * Description: Cell visitor for serialize_spreadsheet(); appends the cell's "cell" command
+ */
+void serialize_cell(cell_coord coord, const char * contents, size_t length, void * context)
+{
+    append_command(*(std::vector<std::string> *)context, "cell", coord, contents, length);
+}
+
+/* Function: serialize_value
+ * Params: cell coordinates, its contents (unused), value_serializer to append with
+ * Return: void
+ *
+ * Description: Cell visitor for subscribe_values(); appends the cell's "value" command
+ */
+void serialize_value(cell_coord coord, const char *, size_t, void * context)
+{
+    value_serializer * serializer = (value_serializer *)context;
+    std::string value = serializer->s->get_value(coord);
+    append_command(*serializer->buffers, "value", coord, value.data(), value.size());
+}
+
 /* Function: save_spreadsheet_names
  * Params: name of spreadsheet to be saved
  * Return: void
@@ -286,347 +686,692 @@ void save_spreadsheet_names(std::string spreadsheet_name)
     ss_names.close();
 }
 
-/* Function: save_open_spreadsheets
- * Params: name of spreadsheet to be saved
- * Return: void
+/* Function: open_spreadsheet
+ * Params: name of spreadsheet
+ * Return: a new, empty spreadsheet, with its undo journal open if UNDO_JOURNAL is set
+ */
+spreadsheet * open_spreadsheet(std::string spreadsheet_name)
+{
+    spreadsheet * s = new spreadsheet(spreadsheet_name);
+    if (UNDO_JOURNAL)
+        s->open_undo_journal();
+    return s;
+}
+
+/* Function: find_spreadsheet
+ * Params: name of spreadsheet, where to store whether it was created and whether it was saved
+ * Return: the spreadsheet
  *
- * Description: Saves the contents of specified spreadsheet
+ * Description: Must be called with registry_lock held. If the spreadsheet isn't loaded, it
+ *              is created, registered with its log, and added to the catalog if it is new.
+ *              A created spreadsheet is returned locked, before anyone else can find it, so
+ *              others wait for the caller to load it (when saved) and unlock it instead of
+ *              seeing it half done.
  */
-void save_open_spreadsheets(std::string spreadsheet_name)
+spreadsheet * find_spreadsheet(std::string spreadsheet_name, bool * created, bool * saved)
 {
-    //Create the file name
-    std::string file_name = spreadsheet_name;
-    file_name += ".axissheet";
-    std::ofstream ss;
-    //Open the file
-    ss.open(file_name.c_str());
+    std::map<std::string, spreadsheet*>::iterator it = spreadsheets.find(spreadsheet_name);
+    *created = it == spreadsheets.end();
+    *saved = true;
+    if (!*created)
+        return it->second;
     
-    std::map<std::string, std::string>::iterator itCells;
-    for(itCells = spreadsheets[spreadsheet_name]->get_data_map()->begin(); itCells != spreadsheets[spreadsheet_name]->get_data_map()->end(); itCells++)
-        
+    spreadsheet * s = open_spreadsheet(spreadsheet_name);
+    s->lock();
+    spreadsheets.insert(std::pair<std::string, spreadsheet*>(spreadsheet_name, s));
+    sheet_logs[spreadsheet_name] = open_log(spreadsheet_name);
+    
+    *saved = spreadsheet_catalog.count(spreadsheet_name) != 0;
+    if (!*saved)
     {
-        ss << itCells->first << "="<< itCells->second<< std::endl;
+        spreadsheet_catalog.insert(spreadsheet_name);
+        save_spreadsheet_names(spreadsheet_name);
     }
-    
-    ss.close();
+    return s;
 }
 
-/* Function: change_cell
- * Params: user ID, cell name, new cell contents
+/* Function: recover_spreadsheets
+ * Params: none
  * Return: void
  *
- * Description: Checks for circular dependencies (returns error if there are any), then
- *              internally changes spreadsheets and sends off cell change to associated clients
+ * Description: Run by each of the RECOVERY_THREADS threads started with the server. Takes
+ *              saved spreadsheets from recovery_names one at a time and loads those nobody
+ *              has loaded yet, in parallel with the other threads and with clients, who are
+ *              served meanwhile. A client connecting to a spreadsheet being loaded waits
+ *              for it. Stops when every name is taken or the spreadsheets loaded so far are
+ *              estimated to hold SHEET_MEMORY_BUDGET bytes; the rest load on first connect.
+ *              What nobody uses is unloaded again after SHEET_IDLE_MS.
  */
-void change_cell(int user_socket_id, std::string cell_name, std::string new_cell_contents)
+void recover_spreadsheets()
 {
-    std::map<int,std::string>::iterator it;
-
-    spreadsheet *s;
-    if(user_to_spreadsheet(user_socket_id, &s))
+    while (SHEET_MEMORY_BUDGET <= 0 || recovery_bytes < SHEET_MEMORY_BUDGET)
     {
-        if(s->set_cell(cell_name, new_cell_contents))
-        {
-            std::vector<int> users = spreadsheet_user[s->get_name()];
-            std::vector<int>::iterator it;
-            for(it = users.begin(); it != users.end(); it++)
-            {
-                send_cell(*it, cell_name, new_cell_contents);
-            }
-            save_open_spreadsheets(s->get_name());
-        }
-        else
+        unsigned int next = recovery_next++;
+        if (next >= recovery_names.size())
+            return;
+        
+        spreadsheet * s;
+        bool created;
+        bool saved;
         {
-            send_error(user_socket_id, 2, "Circular Dependency");
+            std::lock_guard<instrumented_mutex> guard(registry_lock);
+            s = find_spreadsheet(recovery_names[next], &created, &saved);
+            if (created)
+                spreadsheet_idle_since[recovery_names[next]] = now_ms();
         }
-    }
-    else
-    {
-        // Failed to match user to aa spreadsheet. Send error 3.
-        send_error(user_socket_id, 3, "User not logged in.");
+        if (!created)
+            continue;
+        
+        std::lock_guard<spreadsheet> guard(*s, std::adopt_lock);
+        load_spreadsheet(s);
+        recovery_bytes += s->memory_used();
     }
 }
 
-/* Function: undo
- * Params: user ID
+/* Function: load_spreadsheet
+ * Params: spreadsheet (its lock must be held)
  * Return: void
  *
- * Description: Called when a client wants to undo last action in spreadsheet 
+ * Description: Loads the snapshot and replays the log over it, recording how long that took
  */
-void undo(int socket_id)
+void load_spreadsheet(spreadsheet * s)
 {
-    //Find the spreadsheet
-    //Call undo on spreadsheet
-    //Send the cell change to all other users on the spreadsheet
-    spreadsheet *s;
-    if(user_to_spreadsheet(socket_id, &s))
+    long long start_ns = metrics::now_ns();
+    sheet_log::recover(s);
+    metrics::record(HISTOGRAM_SHEET_LOAD, metrics::now_ns() - start_ns);
+}
+
+/* Function: least_recently_used
+ * Params: two eviction candidates
+ * Return: true if the first has been unused for longer
+ */
+bool least_recently_used(const eviction_candidate & a, const eviction_candidate & b)
+{
+    return a.idle_since < b.idle_since;
+}
+
+/* Function: evict_idle_spreadsheets
+ * Params: none
+ * Return: void
+ *
+ * Description: Runs on the flusher's thread every EVICT_INTERVAL_MS, between flushes.
+ *              Unloads every spreadsheet nobody has been connected to for SHEET_IDLE_MS,
+ *              then, while the loaded spreadsheets are estimated to hold more than
+ *              SHEET_MEMORY_BUDGET bytes, the least recently used of the others that
+ *              nobody is connected to. Nothing else unloads spreadsheets, so the
+ *              pointers taken here stay valid for the whole pass.
+ */
+void evict_idle_spreadsheets()
+{
+    std::vector<eviction_candidate> candidates;
+    std::vector<spreadsheet*> loaded;
     {
-        std::string cell, contents;
-        if(s->undo(&cell, &contents))
+        std::lock_guard<instrumented_mutex> guard(registry_lock);
+        std::map<std::string, spreadsheet*>::iterator it;
+        for (it = spreadsheets.begin(); it != spreadsheets.end(); it++)
         {
-            std::vector<int> users = spreadsheet_user[s->get_name()];
-            std::vector<int>::iterator it;
+            loaded.push_back(it->second);
+            if (spreadsheet_refs[it->first] != 0)
+                continue;
             
-            for(it = users.begin(); it != users.end(); it++)
-            {
-                send_cell(*it, cell, contents);
-            }
-            save_open_spreadsheets(s->get_name());
+            eviction_candidate candidate;
+            candidate.name = it->first;
+            candidate.s = it->second;
+            candidate.log = sheet_logs[it->first];
+            candidate.idle_since = spreadsheet_idle_since[it->first];
+            candidate.bytes = 0;
+            candidates.push_back(candidate);
         }
     }
-    else
+    
+    if (candidates.empty())
+        return;
+    
+    // Only a budget needs the size of every loaded spreadsheet
+    long long loaded_bytes = 0;
+    if (SHEET_MEMORY_BUDGET > 0)
     {
-        // Failed to match user to aa spreadsheet. Send error 3.
-        send_error(socket_id, 3, "User not logged in.");
+        std::map<spreadsheet*, long long> bytes;
+        for (unsigned int i = 0; i < loaded.size(); i++)
+        {
+            std::lock_guard<spreadsheet> guard(*loaded[i]);
+            bytes[loaded[i]] = loaded[i]->memory_used();
+            loaded_bytes += bytes[loaded[i]];
+        }
+        for (unsigned int i = 0; i < candidates.size(); i++)
+            candidates[i].bytes = bytes[candidates[i].s];
+    }
+    
+    // Least recently used first
+    std::sort(candidates.begin(), candidates.end(), least_recently_used);
+    
+    long long now = now_ms();
+    int unloaded = 0;
+    for (unsigned int i = 0; i < candidates.size(); i++)
+    {
+        bool idle = now - candidates[i].idle_since >= SHEET_IDLE_MS;
+        bool over_budget = SHEET_MEMORY_BUDGET > 0 && loaded_bytes > SHEET_MEMORY_BUDGET;
+        if (!idle && !over_budget)
+            break;
+        
+        if (unload_spreadsheet(candidates[i]))
+        {
+            loaded_bytes -= candidates[i].bytes;
+            unloaded++;
+        }
     }
+    
+    // Spreadsheets are built on the reactors' threads, so their memory sits in those
+    // threads' malloc arenas; hand what was freed back to the OS
+    if (unloaded > 0)
+        malloc_trim(0);
 }
 
-/* Function: send_message
- * Params: user ID, message to be sent
- * Return: 1 if succeeded, 0 otherwise
+/* Function: unload_spreadsheet
+ * Params: spreadsheet nobody was connected to
+ * Return: 1 if it was unloaded, 0 if it is in use again or still has edits to write
  *
- * Description: Sends the specified client the specified message.
- *              Terminate message with \n
+ * Description: Compacts the spreadsheet's log (spilling its undo history to its journal)
+ *              so loading it again only reads a snapshot, then drops it from the
+ *              registries and frees it (syncing its log through the flusher), unless
+ *              someone connected to it meanwhile. Without an undo journal its undo
+ *              history goes with it, as it would on a restart.
  */
-int send_message(int socket_id, std::string string_to_send)
+int unload_spreadsheet(const eviction_candidate & candidate)
 {
-    // If socket_id is 0, we don't want to send the message.
-    //   (It's the server sending an error to itself as though it's a client)
-    if (socket_id == 0)
-        return 1;
-    
-    // Send the message across the socket.
-    const char * message = string_to_send.c_str();
-    int length = strlen(message);
-    ssize_t bytes_sent = send(socket_id, message, length, 0);
+    // Edits still queued in the flusher have to reach the log first; try again next pass
+    if (persistence->is_dirty(candidate.s))
+        return 0;
     
-    // Return a nonzero value if we didn't send the whole message.
-    if (bytes_sent != length){
-        return 1;
+    std::string snapshot_bytes;
+    std::vector<snapshot_cell> snapshot;
+    {
+        std::lock_guard<spreadsheet> guard(*candidate.s);
+        if (candidate.log->size() > 0)
+            candidate.s->copy_cells(snapshot_bytes, snapshot);
+        candidate.s->spill_undo();
     }
+    if (candidate.log->size() > 0 && !candidate.log->compact(snapshot))
+        return 0;
     
-    // Return 0 to signal success.
-    return 0;
+    {
+        std::lock_guard<instrumented_mutex> guard(registry_lock);
+        if (spreadsheet_refs[candidate.name] != 0 || spreadsheet_idle_since[candidate.name] != candidate.idle_since ||
+            persistence->is_dirty(candidate.s))
+            return 0;
+        
+        spreadsheets.erase(candidate.name);
+        sheet_logs.erase(candidate.name);
+        spreadsheet_user.erase(candidate.name);
+        spreadsheet_value_user.erase(candidate.name);
+        spreadsheet_refs.erase(candidate.name);
+        spreadsheet_idle_since.erase(candidate.name);
+    }
     
-} // end send_message()
+    // The flusher may still be waiting to sync the log; this runs on its thread
+    persistence->forget(candidate.log);
+    delete candidate.log;
+    delete candidate.s;
+    return 1;
+}
 
-/* Function: messaeg_received
- * Params: user ID, message received
+/* Function: now_ms
+ * Params: none
+ * Return: milliseconds on a monotonic clock
+ */
+long long now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: now_us
+ * Params: none
+ * Return: microseconds on a monotonic clock
+ */
+long long now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Function: user_sheet_name
+ * Params: user ID
+ * Return: name of the spreadsheet the user is connected to, or "" if none
+ *
+ * Description: Takes the registry_lock, so it's only used for logging, which is rare
+ */
+std::string user_sheet_name(int socket_id)
+{
+    std::lock_guard<instrumented_mutex> guard(registry_lock);
+    std::map<int, std::string>::iterator it = user_spreadsheet.find(socket_id);
+    return it == user_spreadsheet.end() ? std::string() : it->second;
+}
+
+/* Function: collect_metrics
+ * Params: scrape to append to
  * Return: void
  *
- * Description: Splits up the message received and determines what functions
- *              to call accordingly
+ * Description: Called by the metrics thread for every scrape and dump. Adds the
+ *              gauges only the server knows: clients and their output queues,
+ *              loaded spreadsheets, the flusher's backlog and dropped log records.
  */
-void message_received(int socket_id, std::string & line_received)
+void collect_metrics(std::string & out)
 {
-    // THIS IS PLACEHOLDER CODE. TO BE REPLACED.
-    // Prints the message to the server console
-    std::cout << "Line received: " << line_received << std::endl;
+    std::vector<client_stats> clients;
+    reactor::get_client_stats(clients);
+    long long queued_bytes = 0, queued_messages = 0, paused = 0;
+    for (unsigned int i = 0; i < clients.size(); i++)
+    {
+        queued_bytes += clients[i].queued_bytes;
+        queued_messages += clients[i].queued_messages;
+        paused += clients[i].paused ? 1 : 0;
+    }
     
-    std::vector<std::string> command;
-    split_message(line_received, command);
-
-    // Call the appropriate functions for the received command.
-    if (command.at(0) == "connect")
+    size_t loaded;
     {
-        if (command.size() > 2)
-        {
-            std::string spreadsheet_name = "";
-            std::vector<std::string>::iterator it = command.begin();
-            it += 2;
+        std::lock_guard<instrumented_mutex> guard(registry_lock);
+        loaded = spreadsheets.size();
+    }
+    
+    flusher_stats stats;
+    persistence->get_stats(&stats);
+    
+    metrics::append_value(out, "spreadsheet_clients", "gauge", "Connected clients", clients.size());
+    metrics::append_value(out, "spreadsheet_paused_clients", "gauge", "Clients not read from until their output queue drains", paused);
+    metrics::append_value(out, "spreadsheet_outbound_queued_bytes", "gauge", "Bytes waiting to be written to clients", queued_bytes);
+    metrics::append_value(out, "spreadsheet_outbound_queued_messages", "gauge", "Messages waiting to be written to clients", queued_messages);
+    metrics::append_value(out, "spreadsheet_evicted_clients_total", "counter", "Slow clients disconnected", reactor::get_evictions());
+    metrics::append_value(out, "spreadsheet_loaded_sheets", "gauge", "Spreadsheets in memory", loaded);
+    metrics::append_value(out, "spreadsheet_flush_pending_records", "gauge", "Edits waiting for the next flush", stats.pending_records);
+    metrics::append_value(out, "spreadsheet_flush_dirty_sheets", "gauge", "Spreadsheets with edits waiting for the next flush", stats.dirty_sheets);
+    metrics::append_value(out, "spreadsheet_flush_oldest_pending_seconds", "gauge", "Age of the oldest edit waiting for a flush", stats.oldest_pending_ms / 1000.0);
+    metrics::append_value(out, "spreadsheet_log_dropped_records_total", "counter", "Log records dropped because the log queue was full", logger::dropped());
+}
 
-            // Continue adding all tokens until the end of the line to the final parameter
-            for( ; it != command.end(); it++)
-            {
-                spreadsheet_name += *it + " ";
-            }
+/* Function: open_log
+ * Params: name of spreadsheet
+ * Return: the spreadsheet's write-ahead log, configured by the WAL_* settings
+ */
+sheet_log * open_log(std::string spreadsheet_name)
+{
+    return new sheet_log(spreadsheet_name, WAL_FSYNC_POLICY, WAL_GROUP_SIZE, WAL_GROUP_INTERVAL_MS, WAL_COMPACT_AFTER);
+}
+
+/* Function: save_changes
+ * Params: spreadsheet that changed and its log (its lock must be held), the changes (emptied)
+ * Return: void
+ *
+ * Description: Marks the spreadsheet dirty and queues the changes; the flusher appends them
+ *              to the spreadsheet's log off the request path and compacts the log when needed.
+ */
+void save_changes(spreadsheet * s, sheet_log * log, std::vector<std::pair<std::string, std::string> > & changes)
+{
+    persistence->mark_dirty(s, log, changes);
+}
 
-            // Remove the trailing space from the final token (if there is one)
-            if (spreadsheet_name[spreadsheet_name.size()-1] == ' ')
-                spreadsheet_name = spreadsheet_name.substr(0, spreadsheet_name.size()-1);
+/* Function: is_edit
+ * Params: COMMAND_* kind
+ * Return: true for the commands that edit a spreadsheet: cell, cells, undo and redo
+ */
+bool is_edit(int kind)
+{
+    return kind == COMMAND_CELL || kind == COMMAND_CELLS || kind == COMMAND_UNDO || kind == COMMAND_REDO;
+}
 
-            connect_requested(socket_id, command.at(1), spreadsheet_name);
+/* Function: apply_edits
+ * Params: user ID, lines received from the user, how many, scratch string to parse them with
+ * Return: how many lines were applied, from the first; 0 if the first isn't an edit or the
+ *         user isn't connected to a spreadsheet
+ *
+ * Description: Applies the cell, cells, undo and redo commands at the front of the lines to the user's
+ *              spreadsheet as one batch, under one acquisition of its lock, up to the first
+ *              command of another kind. Once the batch is applied every user of the spreadsheet
+ *              gets all its cell changes in one message, the users that asked for values get
+ *              the values it recalculated in another, and its changes are queued for the log
+ *              together, so a client pasting many cells costs one lock, one broadcast and one
+ *              log record per read instead of one per cell. An edit that is refused sends the
+ *              batch so far before its error, so every client still sees the replies to a
+ *              user's commands in the order they were sent.
+ */
+size_t apply_edits(int socket_id, const text_view * lines, size_t count, std::string & scratch)
+{
+    client_command command;
+    parse_command(lines[0], scratch, &command);
+    if (!is_edit(command.kind))
+        return 0;
+    
+    spreadsheet *s;
+    std::vector<int> *users;
+    std::vector<int> *value_users;
+    sheet_log *log;
+    long long start_ns = metrics::now_ns();
+    if(!user_to_spreadsheet(socket_id, &s, &users, &value_users, &log))
+        return 0;
+    
+    std::lock_guard<spreadsheet> guard(*s);
+    edit_batch batch;
+    size_t applied = 0;
+    while (1)
+    {
+        int kind = command.kind;
+        apply_edit(socket_id, s, command, batch, *users, *value_users);
+        applied++;
+        
+        // The next line is parsed now, so the last edit's time includes sending the batch.
+        bool more = applied < count;
+        if (more)
+        {
+            parse_command(lines[applied], scratch, &command);
+            more = is_edit(command.kind);
         }
-        else
+        if (!more)
         {
-            // Too few parameters. Send error 2.
-            send_error(socket_id, 2, "Invalid parameters in command: " + line_received);
+            broadcast_batch(batch, s, *users, *value_users);
+            save_changes(s, log, batch.changes);
         }
+        
+        long long end_ns = metrics::now_ns();
+        command_handled(socket_id, s, kind, end_ns - start_ns);
+        if (!more)
+            return applied;
+        start_ns = end_ns;
     }
-    else if (command.at(0) == "register")
+}
+
+/* Function: apply_edit
+ * Params: user ID, user's spreadsheet (its lock must be held), parsed cell, cells, undo or redo
+ *         command, batch to add the changes to, users of the spreadsheet, those that asked for values
+ * Return: void
+ *
+ * Description: Checks the cell names and for circular dependencies (sends the batch so far and
+ *              then an error if any is bad), then changes the cells, or undoes or redoes the
+ *              spreadsheet's last edit, and adds the changes to the batch. The cells of a cells
+ *              command are set as one edit: all or none of them, with one cycle check, and one
+ *              undo puts them all back.
+ */
+void apply_edit(int socket_id, spreadsheet * s, const client_command & command, edit_batch & batch,
+                const std::vector<int> & users, const std::vector<int> & value_users)
+{
+    // Reused by every cells command this reactor thread applies, so their capacity is kept.
+    static thread_local std::string names;
+    static thread_local std::vector<std::pair<text_view, text_view> > cells;
+    
+    int result;
+    size_t bad_cell = 0;
+    if (command.kind == COMMAND_CELL)
     {
-        if (command.size() == 2)
-            register_user(socket_id, command.at(1));
-        else
-        {
-            // Invalid parameters. Send error 2.
-            send_error(socket_id, 2, "Invalid parameters in command: " + line_received);
-        }
+        result = s->set_cell(command.name, command.argument);
+        if(result == 1)
+            add_change(batch, command.name, command.argument, false);
     }
-    else if (command.at(0) == "cell")
+    else if (command.kind == COMMAND_CELLS)
     {
-        if (command.size() > 2)
+        if (!parse_cells(command.argument, names, cells))
         {
-            std::string cell_name, cell_contents = "";
-            std::vector<std::string>::iterator it = command.begin();
-            it++;
-            cell_name = *it;
-            it++;
-            
-            // Continue adding all tokens until the end of the line to the final parameter
-            for( ; it != command.end(); it++)
-            {
-                cell_contents += *it + " ";
-            }
-            
-            // Remove the trailing space from the final token (if there is one)
-            if (cell_contents[cell_contents.size()-1] == ' ')
-                cell_contents = cell_contents.substr(0, cell_contents.size()-1);
-            
-            change_cell(socket_id, cell_name, cell_contents);
+            broadcast_batch(batch, s, users, value_users);
+            send_error(socket_id, 2, "Invalid parameters in command: cells");
+            return;
         }
-        else
+        
+        result = s->set_cells(cells, &bad_cell);
+        for(size_t i = 0; result == 1 && i < cells.size(); i++)
+            add_change(batch, cells[i].first, cells[i].second, i > 0);
+    }
+    else
+    {
+        std::vector<std::pair<std::string, std::string> > changed;
+        if(!(command.kind == COMMAND_REDO ? s->redo(changed) : s->undo(changed)))
+            return;
+        for(size_t i = 0; i < changed.size(); i++)
+            add_change(batch, changed[i].first, changed[i].second, i > 0);
+        result = 1;
+    }
+    
+    if(result == 1)
+    {
+        if (!value_users.empty())
+            add_recalculated(batch, s);
+        return;
+    }
+    
+    broadcast_batch(batch, s, users, value_users);
+    if(result == -1)
+        send_error(socket_id, 2, "Invalid cell name: " + (command.kind == COMMAND_CELL ? command.name : cells[bad_cell].first).str());
+    else
+        send_error(socket_id, 2, "Circular Dependency");
+}
+
+/* Function: parse_cells
+ * Params: payload of a cells command, string to keep generated cell names in, where to store
+ *         the views of each cell's name and contents, in order
+ * Return: false if the payload is malformed
+ *
+ * Description: The payload is either "<name> <contents>" pairs separated by tabs, or a range
+ *              "<first>:<last>" then a space and the contents of every cell of the range, row
+ *              by row, separated by tabs, as spreadsheets copy a block (rows ending in a tab
+ *              instead of a newline). A range must get exactly one contents for each of its
+ *              cells; its names are written to names, which must not change while the views
+ *              are used. Names are checked when the cells are set.
+ */
+bool parse_cells(const text_view & payload, std::string & names, std::vector<std::pair<text_view, text_view> > & cells)
+{
+    cells.clear();
+    const char * end = payload.data + payload.length;
+    const char * first_space = (const char *)memchr(payload.data, ' ', payload.length);
+    if (first_space == NULL)
+        return false;
+    
+    const char * colon = (const char *)memchr(payload.data, ':', first_space - payload.data);
+    if (colon == NULL)
+    {
+        // Pairs: each field is a name, a space and contents
+        const char * field = payload.data;
+        while (1)
         {
-            // Invalid parameters. Send error 2.
-            send_error(socket_id, 2, "Invalid parameters in command: " + line_received);
+            const char * tab = (const char *)memchr(field, '\t', end - field);
+            const char * field_end = tab != NULL ? tab : end;
+            const char * space = (const char *)memchr(field, ' ', field_end - field);
+            if (space == NULL)
+                return false;
+            cells.push_back(std::make_pair(text_view(field, space - field), text_view(space + 1, field_end - space - 1)));
+            if (tab == NULL)
+                return true;
+            field = tab + 1;
         }
     }
-    else if (command.at(0) == "undo")
+    
+    // Range: the corners, in either order, then one field per cell
+    cell_coord from, to;
+    if (!parse_cell_name(payload.data, colon, &from) || !parse_cell_name(colon + 1, first_space, &to))
+        return false;
+    unsigned int left = std::min(coord_column(from), coord_column(to));
+    unsigned int right = std::max(coord_column(from), coord_column(to));
+    unsigned int top = std::min(coord_row(from), coord_row(to));
+    unsigned int bottom = std::max(coord_row(from), coord_row(to));
+    
+    size_t fields = 1 + std::count(first_space + 1, end, '\t');
+    if ((unsigned long long)(right - left + 1) * (bottom - top + 1) != fields)
+        return false;
+    
+    // Every name is written before any is viewed, so growing the string moves nothing seen
+    names.clear();
+    std::vector<size_t> name_ends;
+    name_ends.reserve(fields);
+    char name[CELL_NAME_MAX];
+    for (unsigned int row = top; row <= bottom; row++)
     {
-        std::cout << "In undo else-if" << std::endl;
-        undo(socket_id);
+        for (unsigned int column = left; column <= right; column++)
+        {
+            names.append(name, format_cell_name(make_coord(column, row), name));
+            name_ends.push_back(names.size());
+        }
     }
-    else
+    
+    const char * field = first_space + 1;
+    size_t name_start = 0;
+    for (size_t i = 0; i < fields; i++)
     {
-        // Invalid parameters. Send error 2.
-        send_error(socket_id, 2, "Invalid parameters in command: " + line_received);
+        const char * tab = (const char *)memchr(field, '\t', end - field);
+        const char * field_end = tab != NULL ? tab : end;
+        cells.push_back(std::make_pair(text_view(names.data() + name_start, name_ends[i] - name_start),
+                                       text_view(field, field_end - field)));
+        name_start = name_ends[i];
+        field = field_end + 1;
     }
-}// End message_received()
+    return true;
+}
 
-/* Function: split_message
- * Params: message to split, vector to store results
+/* Function: command_handled
+ * Params: user ID, their spreadsheet (its lock must be held) or NULL if none is at hand,
+ *         COMMAND_* kind, how long handling it took
  * Return: void
- * Source: http://stackoverflow.com/questions/5888022/split-string-by-single-spaces
  *
- * Description: Splits up a message by spaces. Helper function to help determine how to
- *              respond to an incoming message
+ * Description: Records the command's latency. Only a sample is logged, so logging costs next
+ *              to nothing under load.
  */
-void split_message(std::string message, std::vector<std::string> & ret)
-{   
-    // Strip any carriage returns off of our message.
-    message.erase( remove(message.begin(), message.end(), '\r'), message.end() );
-    message.erase( remove(message.begin(), message.end(), '\n'), message.end() );
-    
-    // Add the tokens one by one, space-separated
-    ret.clear();
-    int pos = message.find(' ');
-    int pos_init = 0;
-    int hit_space = 0;
+void command_handled(int socket_id, spreadsheet * s, int kind, long long elapsed_ns)
+{
+    metrics::record(HISTOGRAM_COMMAND + kind, elapsed_ns);
     
-    while(pos != std::string::npos)
+    if (logger::enabled(LOG_INFO) && logger::sample())
     {
-        hit_space = 1;
-        ret.push_back(message.substr(pos_init, pos - pos_init));
-        pos_init = pos + 1;
-        pos = message.find(' ', pos_init);
+        const char * name = command_name(kind);
+        std::string sheet = s != NULL ? s->get_name() : user_sheet_name(socket_id);
+        log_fields fields;
+        fields.socket = socket_id;
+        fields.sheet = sheet;
+        fields.command = text_view(name, strlen(name));
+        fields.latency_us = elapsed_ns / 1000;
+        logger::log(LOG_INFO, fields, "command handled (1 in %d logged)", LOG_SAMPLE_EVERY);
     }
+}
+
+/* Function: send_message
+ * Params: user ID, message to be sent
+ * Return: 0 if succeeded, 1 otherwise
+ *
+ * Description: Sends the specified client the specified message.
+ *              Terminate message with \n. Whatever the socket can't take
+ *              immediately is queued and written by the socket's reactor.
+ */
+int send_message(int socket_id, std::string string_to_send)
+{
+    // If socket_id is 0, we don't want to send the message.
+    //   (It's the server sending an error to itself as though it's a client)
+    if (socket_id == 0)
+        return 0;
     
-    // Add the last token missed by the above loop
-    ret.push_back(message.substr(pos_init, message.size() - pos_init));
+    return reactor::send(socket_id, string_to_send);
     
-}// End split_message()
+} // end send_message()
 
+/* Function: send_message
+ * Params: user ID, shared message to be sent
+ * Return: 0 if succeeded, 1 otherwise
+ *
+ * Description: Same as above for a message that is sent to several clients;
+ *              whatever can't be sent right away is queued by reference.
+ */
+int send_message(int socket_id, const shared_message & message)
+{
+    if (socket_id == 0)
+        return 0;
+    
+    return reactor::send(socket_id, message);
+}
 
-// Called when a client disconnects.
-// Removes them from any spreadsheets they were editing and closes the socket.
-void client_disconnected(int socket_id)
+/* Function: messaeg_received
+ * Params: user ID, view of the line received (into the reactor's buffer, without its '\n'),
+ *         scratch string to parse it with
+ * Return: void
+ *
+ * Description: Parses a message other than an edit and determines what functions
+ *              to call accordingly. Edits are applied by apply_edits(), and only
+ *              reach here when the user isn't connected to a spreadsheet.
+ */
+void message_received(int socket_id, const text_view & line, std::string & scratch)
 {
-    // THIS IS PLACEHOLDER CODE. TO BE HANDLED LATER.
-    std::cout << "A client has disconnected." << std::endl;
+    long long start_ns = metrics::now_ns();
     
-    // Remove the user's spreadsheet associations.
+    client_command command;
+    parse_command(line, scratch, &command);
+
+    // Call the appropriate functions for the received command.
+    switch (command.kind)
+    {
+    case COMMAND_CONNECT:
+        connect_requested(socket_id, command.name.str(), command.argument.str());
+        break;
+    case COMMAND_REGISTER:
+        register_user(socket_id, command.name.str());
+        break;
+    case COMMAND_CELL:
+    case COMMAND_CELLS:
+    case COMMAND_UNDO:
+    case COMMAND_REDO:
+        // Failed to match user to a spreadsheet. Send error 3.
+        send_error(socket_id, 3, "User not logged in.");
+        break;
+    case COMMAND_VALUES:
+        subscribe_values(socket_id);
+        break;
+    default:
+        // Unknown command, or invalid parameters. Send error 2.
+        send_error(socket_id, 2, "Invalid parameters in command: " + line.str());
+        break;
+    }
     
-    // Close the socket
-    close(socket_id);
-}// End client_disconnected()
+    command_handled(socket_id, NULL, command.kind, metrics::now_ns() - start_ns);
+}// End message_received()
 
-/* Function: handle
- * Params: socket
- * Return: handle pointer
+/* Function: lines_received
+ * Params: user ID, views of the lines framed from one read (into the reactor's buffer,
+ *         without their '\n'), how many
+ * Return: void
  *
- * Description: Fired when a new socket connects. Invoked in a new thread as soon as socket is paired
+ * Description: Handles a client's lines in order: each run of edits is applied as one
+ *              batch, and every other command on its own. The arguments reach cell edits
+ *              as views of the lines; nothing is copied on the way.
  */
-void *handle(void *pnewsock)
+void lines_received(int socket_id, const text_view * lines, size_t count)
 {
-    int newsock = *(int*)pnewsock; // Cast to string identifier of the socket
-    
-    // This string will be populated with what we receive from the socket, and full lines
-    //   (terminated by '\n' characters) will be removed from the front as they arrive.
-    std::string received_so_far = "";
+    // Reused by every line this reactor thread parses, so its capacity is kept.
+    static thread_local std::string scratch;
     
-    // Infinitely check for complete lines and continue receiving data.
-    // Note that this does NOT occur on the main thread.
-    // Each socket has its own thread for this purpose.
-    while(1)
+    size_t i = 0;
+    while (i < count)
     {
-        // Receive more data from the socket:
-        // Create the buffer we'll populate with the received messages.
-        char incoming_data_buffer[INCOMING_BUFFER_SIZE];
-        
-        // Wait for a message to be received. This code will block until we receive something.
-        ssize_t bytes_received = recv(newsock, incoming_data_buffer, INCOMING_BUFFER_SIZE-1, 0);
-        
-        // If the client has shut down, call the client disconnection cleanup function, and return.
-        if (bytes_received == 0) {
-            client_disconnected(newsock);
-            return NULL;
-        }
-        
-        // If we failed to receive properly, send an error to the error stream, and return.
-        if (bytes_received == -1) {
-            perror("handle()'s message reception failed");
-            client_disconnected(newsock);
-            return NULL;
-        }
-        
-        // Terminates the received character array properly. (May not be needed?).
-        if (bytes_received != INCOMING_BUFFER_SIZE)
-            incoming_data_buffer[bytes_received] = '\0';
-        
-        // Get a string representation of what we've just received from the socket.
-        std::string received_data(incoming_data_buffer);
-        
-        // Add what we've just received to the received_so_far string.
-        received_so_far += received_data;
-        
-        // While we have newline characters, strip the lines one by one and pass them to message_received().
-        while(received_so_far.find('\n') != std::string::npos)
+        size_t applied = apply_edits(socket_id, lines + i, count - i, scratch);
+        if (applied == 0)
         {
-            // This will hold the line at the front of received_so_far.
-            std::string current_line = received_so_far.substr(0, received_so_far.find('\n')+1);
-            
-            // Remove the line we just found from received_so_far.
-            received_so_far = received_so_far.substr(current_line.length(),received_so_far.length()-received_so_far.find('\n'));
-            
-            // Remove the newline character from the current_line
-            current_line = current_line.substr(0, current_line.length()-1);
-            
-            // call message_received() with the newly received line.
-            godlock.lock();
-            message_received(newsock, current_line);
-            godlock.unlock();
-        } // End newline detection loop
-    } // End infinite receive/newline detection loop
+            message_received(socket_id, lines[i], scratch);
+            applied = 1;
+        }
+        i += applied;
+    }
+}// End lines_received()
+
+
+// Called by a reactor when a client disconnects, before the socket is closed.
+// Removes them from any spreadsheets they were editing.
+void client_disconnected(int socket_id)
+{
+    std::string sheet = user_sheet_name(socket_id);
+    log_fields fields;
+    fields.socket = socket_id;
+    fields.sheet = sheet;
+    logger::log(LOG_INFO, fields, "client disconnected");
     
-    return NULL;
-} // End handle()
+    // Remove the user's spreadsheet associations.
+    remove_user(socket_id);
+}// End client_disconnected()
 
 /* Function: main
  * Params: number of arguments, string arguments
  * Return: int
  *
- * Description: Starts up the server. Pulls in all saved spreadsheets and users, then waits
- *              for connecting clients.
+ * Description: Starts up the server. Pulls in the names of all saved spreadsheets and all
+ *              users, starts loading the spreadsheets in the background, then waits for
+ *              connecting clients without waiting for the loading to finish.
  */
 int main(int argc, char* argv[])
 {
@@ -639,7 +1384,7 @@ int main(int argc, char* argv[])
         
         // Error if we could not parse the argument as an int.
         if( std::atoi(port.c_str()) == 0 ){
-            fprintf(stderr, "Invalid port specified\n");
+            logger::log(LOG_ERROR, log_fields(), "Invalid port specified");
             return 1; // Terminate here
         }
     }
@@ -679,17 +1424,8 @@ int main(int argc, char* argv[])
     }
     
     
-    //Start the save thread
-    //pthread_t save_thread;
-    //pthread_create(&save_thread, NULL, &save_open_spreadsheets, NULL);
-    
-    
-    
-    //pthread_t save_thread;
-    //pthread_create(&save_thread, NULL, &save_open_spreadsheets, NULL);
-    //pthread_join(save_thread, NULL);
-    
-    // Begin loading all spreadsheets from file:
+    // Begin reading the names of all spreadsheets from file. They are loaded
+    // on their first connect, not here, so startup doesn't grow with the catalog.
     // Check if file containing list of existing spreadsheets exists.
     FILE * sheet_list_file = fopen("spreadsheets.axis", "r");
     bool sheets_file_exists = (sheet_list_file == NULL) ? false : true;
@@ -707,41 +1443,14 @@ int main(int argc, char* argv[])
             {            
                 getline(file_stream, txt);
                 
-                // If there exists a file with this name...
-                FILE * sheet_file = fopen("spreadsheets.axis", "r");
-                bool file_exists = (sheet_file == NULL) ? false : true;
-                if (file_exists)
-                {
-                    fclose(sheet_file);
-                    
-		    spreadsheets[txt] = new spreadsheet(txt);
-
-                    // Open the file with this spreadsheet's name...
-                    std::ifstream current_file_stream((txt+".axissheet").c_str());
-                    std::string current_line;
-                    if (current_file_stream.is_open())
-                        // While new lines exist within this file...
-                        while (current_file_stream.good())
-                        {
-                            getline(current_file_stream, current_line);
-                            
-                            // Separare into cell_name and cell_contents by "=" symbol.
-                            std::string cell_name, cell_contents;
-                            int equals_index = current_line.find('=');
-                            cell_name = current_line.substr(0, equals_index);
-                            cell_contents = current_line.substr(equals_index+1, current_line.length()-(equals_index-1));
-                            
-                            if(cell_contents == "")
-                                continue;
-                  
-                            // Set the cell to what we just read from the file.
-                            spreadsheets[txt]->set_cell(cell_name,cell_contents);
-                        }
-                    current_file_stream.close();
-                }
+                // Skip the blank line left after the last name
+                if (txt == "")
+                    continue;
+                
+                spreadsheet_catalog.insert(txt);
             }
         file_stream.close();
-    } // End loading all spreadsheets from file.
+    } // End reading all spreadsheet names from file.
     
     
     /* Get the address info */
@@ -752,65 +1461,119 @@ int main(int argc, char* argv[])
     hints.ai_flags = AI_PASSIVE; // Marked for bind()ing
     // Localhost, port, addrinfo struct, list of structs
     if (getaddrinfo(NULL, port.c_str(), &hints, &res) != 0) {
-        perror("getaddrinfo"); // Error if getaddrinfo failed
+        logger::error("getaddrinfo"); // Error if getaddrinfo failed
         return 1;
     }
     
     /* Create the socket */
     int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
     if (sock == -1) {
-        perror("socket"); // Error if socket creation failed
+        logger::error("socket"); // Error if socket creation failed
         return 1;
     }
     
     /* Enable the socket to reuse the address */
     int reuseaddr = 1; /* True */
     if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuseaddr, sizeof(int)) == -1) {
-        perror("setsockopt"); // Error if socket option setting failed
+        logger::error("setsockopt"); // Error if socket option setting failed
         return 1;
     }
     
     /* Bind the socket to the address */
     if (bind(sock, res->ai_addr, res->ai_addrlen) == -1) {
-        perror("bind"); // Error if binding failed
+        logger::error("bind"); // Error if binding failed
         return 1;
     }
     
     /* Listen on the socket */
     if (listen(sock, BACKLOG) == -1) {
-        perror("listen"); // Error if listening failed
+        logger::error("listen"); // Error if listening failed
         return 1;
     }
     
     // Release the addrinfo struct's memory
     freeaddrinfo(res);
     
+    /* Send SIGTERM/SIGINT to main() only: blocked here, every thread started below inherits the mask */
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGTERM);
+    sigaddset(&shutdown_signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+    
+    //Start the log writer; until now records were written as they were logged
+    logger::start();
+    
+    //Start the save thread
+    persistence = new flusher(FLUSH_INTERVAL_MS);
+    persistence->set_maintenance(evict_idle_spreadsheets, EVICT_INTERVAL_MS);
+    persistence->start();
+    
+    //Serve the metrics on the local admin port and dump them periodically
+    metrics::start(METRICS_PORT, collect_metrics);
+    
+    /* Make the listening socket non-blocking so reactors can drain it */
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1) {
+        logger::error("fcntl"); // Error if the socket couldn't be made non-blocking
+        return 1;
+    }
+    
+    /* Load saved spreadsheets in the background while the reactors already serve clients */
+    recovery_names.assign(spreadsheet_catalog.begin(), spreadsheet_catalog.end());
+    std::vector<std::thread> recovery_threads;
+    for (int i = 0; i < RECOVERY_THREADS; i++)
+        recovery_threads.push_back(std::thread(recover_spreadsheets));
+    
     /* Main loop
-     *  Threaded server implementation adapted from Martin Broadhurst's
-     *  implementation:  http://martinbroadhurst.com/server-examples.html .
-     *  Pairs sockets, launches a new thread for each newly paired socket */
-    pthread_t thread;
-    while (1){
-        size_t size = sizeof(struct sockaddr_in);
-        
-        
-        // Create structures necessary for socket acceptance.
-        struct sockaddr_in their_addr;
-        int newsock = accept(sock, (struct sockaddr*)&their_addr, (socklen_t*)&size);
-        if (newsock == -1) {
-            perror("accept");
-        }
-        else {
-            printf("Got a connection from %s on port %d\n", inet_ntoa(their_addr.sin_addr), htons(their_addr.sin_port));
-            if (pthread_create(&thread, NULL, handle, &newsock) != 0) {
-                fprintf(stderr, "Failed to create thread\n");
-            }
-        }
+     *  One edge-triggered epoll reactor per core. Each one accepts from the shared
+     *  listening socket and services every connection it accepted. */
+    unsigned int reactor_count = std::thread::hardware_concurrency();
+    if (reactor_count == 0)
+        reactor_count = 1;
+    
+    std::vector<reactor*> reactors;
+    for (unsigned int i = 0; i < reactor_count; i++)
+    {
+        reactor * r = new reactor(sock, lines_received, client_disconnected);
+        r->start();
+        reactors.push_back(r);
+    }
+    
+    /* Wait for a shutdown signal, then stop taking edits and drain pending writes */
+    int signal_received;
+    sigwait(&shutdown_signals, &signal_received);
+    logger::log(LOG_INFO, log_fields(), "shutting down");
+    
+    recovery_next = recovery_names.size();
+    for (unsigned int i = 0; i < recovery_threads.size(); i++)
+        recovery_threads[i].join();
+    
+    for (unsigned int i = 0; i < reactors.size(); i++)
+        reactors[i]->stop();
+    for (unsigned int i = 0; i < reactors.size(); i++)
+    {
+        reactors[i]->join();
+        delete reactors[i];
     }
     
+    persistence->stop();
+    metrics::stop();
+    
+    flusher_stats stats;
+    persistence->get_stats(&stats);
+    logger::log(LOG_INFO, log_fields(), "flushed %lld edits in %lld flushes (max %lldus), %lld compactions",
+                stats.records_written, stats.flushes, stats.max_flush_us, stats.compactions);
+    delete persistence;
+    
+    std::map<std::string, sheet_log*>::iterator itLogs;
+    for (itLogs = sheet_logs.begin(); itLogs != sheet_logs.end(); itLogs++)
+        delete itLogs->second;
+    
     // Close the socket.
     close(sock);
     
+    logger::stop();
+    
     // No errors; return exit code 0.
     return 0;
 } // End main()
@@ -0,0 +1,40 @@
+/*
+ * Filename: text_view.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef TEXT_VIEW_H
+#define TEXT_VIEW_H
+
+#include <stddef.h>
+#include <string>
+
+/* Class: text_view
+ *
+ * Description: Pointer and length of text owned by someone else, which may hold
+ *              any bytes, '\0' included. Copying a view never copies the text;
+ *              it is only valid as long as the owner keeps the text in place.
+ *
+ * Public Functions:
+ *   constructor:  views nothing, some bytes, or a string
+ *   size:         number of bytes viewed
+ *   empty:        tells if no byte is viewed
+ *   str:          copies the text into a string
+ */
+class text_view
+{
+ public:
+  text_view() : data(NULL), length(0) {}
+  text_view(const char * data, size_t length) : data(data), length(length) {}
+  text_view(const std::string & text) : data(text.data()), length(text.size()) {}
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+  std::string str() const { return std::string(data, length); }
+
+  const char * data;
+  size_t length;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Filename: undo_journal.cpp
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#include "undo_journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h> // rename
+#include <string.h> // memrchr
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logger.h"
+#include "sheet_snapshot.h"
+
+#define JOURNAL_READ_SIZE 4096 // Bytes read at a time while looking for the start of the newest record
+
+/* Function: undo_journal constructor
+ * Params: spreadsheet name
+ * Return: void
+ *
+ * Description: Opens the spreadsheet's journal, creating it if needed. A record
+ *              torn by a crash at the end of the file is cut off.
+ */
+undo_journal::undo_journal(std::string sheet_name)
+{
+  file_name = sheet_name + ".axisundo";
+  length = 0;
+  journal_file = open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (journal_file == -1)
+  {
+    logger::error("undo_journal open");
+    return;
+  }
+
+  struct stat info;
+  if (fstat(journal_file, &info) == 0)
+    length = info.st_size;
+
+  // Cut back to the end of the last complete record
+  while (length > 0)
+  {
+    char last;
+    if (pread(journal_file, &last, 1, length - 1) != 1 || last == '\n')
+      break;
+    length--;
+  }
+  ftruncate(journal_file, length);
+}
+
+/* Function: undo_journal destructor
+ * Params: none
+ * Return: void
+ */
+undo_journal::~undo_journal()
+{
+  if (journal_file != -1)
+  {
+    fdatasync(journal_file);
+    close(journal_file);
+  }
+}
+
+/* Function: write_all
+ * Params: buffer and its length
+ * Return: 1 if the whole buffer was written at the end of the journal, 0 otherwise
+ */
+int undo_journal::write_all(const char * buffer, size_t count)
+{
+  long long offset = length;
+  while (count > 0)
+  {
+    ssize_t written = pwrite(journal_file, buffer, count, offset);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      logger::error("undo_journal write");
+      ftruncate(journal_file, length);
+      return 0;
+    }
+    buffer += written;
+    count -= written;
+    offset += written;
+  }
+  length = offset;
+  return 1;
+}
+
+/* Function: push
+ * Params: records (cell name, contents before the change), oldest first
+ * Return: 1 if the records were written, 0 otherwise
+ */
+int undo_journal::push(const std::vector<std::pair<std::string, std::string> > & records)
+{
+  if (journal_file == -1)
+    return 0;
+  if (records.empty())
+    return 1;
+
+  std::string batch;
+  std::vector<std::pair<std::string, std::string> >::const_iterator it;
+  for (it = records.begin(); it != records.end(); it++)
+  {
+    batch += it->first;
+    batch += '=';
+    batch += it->second;
+    batch += '\n';
+  }
+
+  if (!write_all(batch.data(), batch.size()))
+    return 0;
+  if (length > UNDO_JOURNAL_MAX_BYTES)
+    trim();
+  return 1;
+}
+
+/* Function: pop
+ * Params: where to store the cell name and contents of the newest record
+ * Return: 1 if a record was popped, 0 if the journal is empty
+ *
+ * Description: Reads backwards from the end for the start of the newest record,
+ *              then truncates the file there
+ */
+int undo_journal::pop(std::string * cell_name, std::string * contents)
+{
+  if (journal_file == -1 || length == 0)
+    return 0;
+
+  // The newest record starts after the last '\n' before its own
+  std::string record;
+  long long start = length - 1;
+  while (start > 0)
+  {
+    long long from = start > JOURNAL_READ_SIZE ? start - JOURNAL_READ_SIZE : 0;
+    std::string chunk(start - from, '\0');
+    if (pread(journal_file, &chunk[0], chunk.size(), from) != (ssize_t)chunk.size())
+      return 0;
+    const char * newline = (const char *)memrchr(chunk.data(), '\n', chunk.size());
+    if (newline != NULL)
+    {
+      record = chunk.substr(newline - chunk.data() + 1) + record;
+      start = from + (newline - chunk.data()) + 1;
+      break;
+    }
+    record = chunk + record;
+    start = from;
+  }
+
+  length = start;
+  ftruncate(journal_file, length);
+
+  size_t equals_index = record.find('=');
+  if (equals_index == std::string::npos)
+    return 0;
+  cell_name->assign(record, 0, equals_index);
+  contents->assign(record, equals_index + 1, std::string::npos);
+  return 1;
+}
+
+/* Function: size
+ * Params: none
+ * Return: bytes in the journal
+ */
+long long undo_journal::size()
+{
+  return length;
+}
+
+/* Function: trim
+ * Params: none
+ * Return: void
+ *
+ * Description: Rewrites the journal with only its newest half (starting at a record
+ *              boundary) through a temporary file, synced before it is renamed over
+ *              the journal and its directory synced after, so a crash keeps one or
+ *              the other
+ */
+void undo_journal::trim()
+{
+  long long from = length / 2;
+  std::string kept(length - from, '\0');
+  if (pread(journal_file, &kept[0], kept.size(), from) != (ssize_t)kept.size())
+    return;
+  size_t newline = kept.find('\n');
+  if (newline == std::string::npos)
+    return;
+  kept.erase(0, newline + 1);
+
+  std::string temp_name = file_name + ".tmp";
+  int temp_file = open(temp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (temp_file == -1)
+  {
+    logger::error("undo_journal trim");
+    return;
+  }
+  int old_file = journal_file;
+  long long old_length = length;
+  journal_file = temp_file;
+  length = 0;
+  if (!write_all(kept.data(), kept.size()) || fdatasync(temp_file) == -1 ||
+      rename(temp_name.c_str(), file_name.c_str()) == -1)
+  {
+    close(temp_file);
+    unlink(temp_name.c_str());
+    journal_file = old_file;
+    length = old_length;
+    return;
+  }
+  sheet_snapshot::sync_directory(file_name);
+  close(old_file);
+}
@@ -0,0 +1,58 @@
+/*
+ * Filename: undo_journal.h
+ * Authors: Riley Anderson, Brent Bagley, Ryan Farr, Nathan Rollins
+ * Last Modified: 10/17/2026
+ * Version 1.0
+ */
+
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+#include <string>
+#include <vector>
+
+#ifndef UNDO_JOURNAL_MAX_BYTES
+#define UNDO_JOURNAL_MAX_BYTES (64 << 20) // Journal size past which its oldest half is dropped
+#endif
+
+/* Class: undo_journal
+ *
+ * Description: Undo history of one spreadsheet that no longer fits in memory,
+ *              kept on disk as a stack of "name=contents" records in
+ *              <name>.axisundo, oldest first. The spreadsheet pushes the
+ *              records it evicts from its undo ring, and pops them back one at
+ *              a time once the ring has been undone down to empty. Popping
+ *              truncates the file, so it only ever holds history that can still
+ *              be undone. When it grows past UNDO_JOURNAL_MAX_BYTES the oldest
+ *              half is dropped. The journal isn't synced on every write: it is
+ *              history, not data, and losing its tail in a crash only shortens it.
+ *
+ * Public Functions:
+ *   constructor:  opens (or creates) the journal of the named spreadsheet
+ *   destructor:   syncs and closes the journal
+ *   push:         appends records, oldest first, in one write
+ *   pop:          removes the newest record and returns it
+ *   size:         returns the journal's size in bytes
+ *
+ * Private Functions:
+ *   write_all:    writes a whole buffer to the journal file
+ *   trim:         drops the oldest half of the records
+ */
+class undo_journal
+{
+ public:
+  undo_journal(std::string sheet_name);
+  ~undo_journal();
+  int push(const std::vector<std::pair<std::string, std::string> > & records);
+  int pop(std::string * cell_name, std::string * contents);
+  long long size();
+
+ private:
+  int write_all(const char * buffer, size_t length);
+  void trim();
+  std::string file_name;
+  int journal_file;   //Descriptor of <name>.axisundo
+  long long length;   //Bytes in the file; always ends after a complete record
+};
+
+#endif